@@ -0,0 +1,75 @@
+#ifndef BENCH_UTIL_HPP
+#define BENCH_UTIL_HPP
+
+// Helpers shared by the benchmarks in this directory. Options are given as
+// --name=value; lists are comma-separated.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+typedef std::chrono::steady_clock clock;
+
+inline double seconds_since(clock::time_point pStart) {
+  return std::chrono::duration<double>(clock::now() - pStart).count();
+}
+
+// the text behind --pName= on the command line, or nullptr
+inline const char *find_option(int pArgc, char **pArgv, const char *pName) {
+  std::size_t length = std::strlen(pName);
+  for (int i = 1; i < pArgc; i++) {
+    if (std::strncmp(pArgv[i], "--", 2) == 0 &&
+        std::strncmp(pArgv[i] + 2, pName, length) == 0 &&
+        pArgv[i][2 + length] == '=') {
+      return pArgv[i] + 3 + length;
+    }
+  }
+  return nullptr;
+}
+
+inline std::uint64_t get_option(int pArgc, char **pArgv, const char *pName,
+                                std::uint64_t pDefault) {
+  const char *value = find_option(pArgc, pArgv, pName);
+  return value ? std::strtoull(value, nullptr, 10) : pDefault;
+}
+
+inline double get_real_option(int pArgc, char **pArgv, const char *pName,
+                              double pDefault) {
+  const char *value = find_option(pArgc, pArgv, pName);
+  return value ? std::strtod(value, nullptr) : pDefault;
+}
+
+inline std::vector<std::uint64_t>
+get_list_option(int pArgc, char **pArgv, const char *pName,
+                const std::vector<std::uint64_t> &pDefault) {
+  const char *value = find_option(pArgc, pArgv, pName);
+  if (!value) {
+    return pDefault;
+  }
+  std::vector<std::uint64_t> items;
+  while (*value) {
+    char *end;
+    items.push_back(std::strtoull(value, &end, 10));
+    if (*end != ',') {
+      break;
+    }
+    value = end + 1;
+  }
+  return items;
+}
+
+// Keeps a result alive so that the work producing it is not optimized
+// away.
+template <typename T> void keep(const T &pValue) {
+  asm volatile("" : : "r,m"(pValue) : "memory");
+}
+
+} // namespace bench
+
+#endif
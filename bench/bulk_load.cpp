@@ -0,0 +1,76 @@
+// Builds trees from the same records by repeated insert(), in key order
+// and shuffled, and by bulk_load() at several fill factors, and reports
+// the build time and the node bytes per record.
+//
+//   bulk_load_bench [--sizes=1000000,10000000] [--fills=50,70,100]
+//                   [--seed=1]
+//
+// Keys are the int64 ordinals 0 to size - 1. In key order insert() only
+// appends at the right edge of the tree; shuffled, it splits leaves in
+// the middle and leaves them about 70% full.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+void report(const char *pMethod, std::size_t pSize, double pSeconds,
+            const tree_type &pTree) {
+  std::printf("%10zu  %-16s %8.3f s  %6.1f B/record  height %d\n", pSize,
+              pMethod, pSeconds, double(pTree.get_memory_usage()) / pSize,
+              pTree.get_stats().mHeight);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::uint64_t> sizes =
+      bench::get_list_option(argc, argv, "sizes", {1000000, 10000000});
+  std::vector<std::uint64_t> fills =
+      bench::get_list_option(argc, argv, "fills", {50, 70, 100});
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  for (std::uint64_t size : sizes) {
+    std::vector<tree_type::record_type> records;
+    records.reserve(size);
+    for (std::uint64_t i = 0; i < size; i++) {
+      records.emplace_back(std::int64_t(i), std::int64_t(i));
+    }
+    {
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      for (const tree_type::record_type &r : records) {
+        tree.insert(r);
+      }
+      report("insert sorted", size, bench::seconds_since(start), tree);
+    }
+    {
+      std::vector<tree_type::record_type> shuffled(records);
+      std::mt19937_64 rng(seed);
+      std::shuffle(shuffled.begin(), shuffled.end(), rng);
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      for (const tree_type::record_type &r : shuffled) {
+        tree.insert(r);
+      }
+      report("insert shuffled", size, bench::seconds_since(start), tree);
+    }
+    for (std::uint64_t fill : fills) {
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      tree.bulk_load(records.begin(), records.end(), fill / 100.0);
+      char method[32];
+      std::snprintf(method, sizeof(method), "bulk_load %3d%%", int(fill));
+      report(method, size, bench::seconds_since(start), tree);
+    }
+  }
+  return 0;
+}
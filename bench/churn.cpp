@@ -0,0 +1,114 @@
+// Insert/delete churn under each remove_policy. A tree of int64 records
+// first goes through a steady phase that removes a random record and
+// inserts a new one, alternately, so its size stays put, then through a
+// shrink phase that removes 90% of what is left in random order. Each
+// phase reports throughput, the latency percentiles of single operations
+// and the node bytes per remaining record; under REMOVE_LAZY the bytes
+// are reported once more after compact().
+//
+//   churn_bench [--records=1000000] [--ops=2000000] [--seed=1]
+//
+// New keys are a bijective mix of a counter, so they never collide and
+// land all over the tree. Every operation is timed on its own, so the
+// throughput includes two clock reads per operation.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+// splitmix64, a bijection on 64 bits
+std::int64_t make_key(std::uint64_t pCounter) {
+  std::uint64_t z = pCounter + 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return std::int64_t(z ^ (z >> 31));
+}
+
+void report(const char *pPolicy, const char *pPhase, double pSeconds,
+            std::vector<double> &pLatencies, const tree_type &pTree,
+            std::size_t pRecords) {
+  std::sort(pLatencies.begin(), pLatencies.end());
+  auto percentile = [&pLatencies](double pFraction) {
+    return pLatencies[std::size_t(pFraction * (pLatencies.size() - 1))];
+  };
+  std::printf("%-12s %-8s %8.2f %8.0f %8.0f %8.0f %9.0f %9.1f\n", pPolicy,
+              pPhase, pLatencies.size() / pSeconds / 1e6, percentile(0.5),
+              percentile(0.99), percentile(0.999), pLatencies.back(),
+              double(pTree.get_memory_usage()) / pRecords);
+}
+
+void run(const char *pName, bpt::remove_policy pPolicy, std::size_t pRecords,
+         std::size_t pOps, std::uint64_t pSeed) {
+  std::mt19937_64 rng(pSeed);
+  tree_type tree;
+  tree.set_remove_policy(pPolicy);
+  std::vector<std::int64_t> live;
+  live.reserve(pRecords);
+  std::uint64_t counter = 0;
+  for (; counter < pRecords; counter++) {
+    live.push_back(make_key(counter));
+    tree.insert(tree_type::record_type(live.back(), 0));
+  }
+
+  std::vector<double> latencies;
+  latencies.reserve(pOps);
+  bench::clock::time_point start = bench::clock::now();
+  for (std::size_t i = 0; i < pOps; i++) {
+    bench::clock::time_point opStart = bench::clock::now();
+    if (i % 2 == 0) {
+      std::size_t slot = rng() % live.size();
+      tree.remove(live[slot]);
+      live[slot] = live.back();
+      live.pop_back();
+    } else {
+      live.push_back(make_key(counter++));
+      tree.insert(tree_type::record_type(live.back(), std::int64_t(i)));
+    }
+    latencies.push_back(bench::seconds_since(opStart) * 1e9);
+  }
+  report(pName, "steady", bench::seconds_since(start), latencies, tree,
+         live.size());
+
+  std::shuffle(live.begin(), live.end(), rng);
+  std::size_t keep = live.size() / 10;
+  latencies.clear();
+  start = bench::clock::now();
+  for (std::size_t i = keep; i < live.size(); i++) {
+    bench::clock::time_point opStart = bench::clock::now();
+    tree.remove(live[i]);
+    latencies.push_back(bench::seconds_since(opStart) * 1e9);
+  }
+  report(pName, "shrink", bench::seconds_since(start), latencies, tree, keep);
+
+  if (pPolicy == bpt::REMOVE_LAZY) {
+    start = bench::clock::now();
+    tree.compact();
+    std::printf("%-12s %-8s %8.3f s %44.1f\n", pName, "compact",
+                bench::seconds_since(start),
+                double(tree.get_memory_usage()) / keep);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t records = bench::get_option(argc, argv, "records", 1000000);
+  std::size_t ops = bench::get_option(argc, argv, "ops", 2000000);
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  std::printf("%-12s %-8s %8s %8s %8s %8s %9s %9s\n", "policy", "phase",
+              "Mops/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "B/record");
+  run("merge", bpt::REMOVE_MERGE, records, ops, seed);
+  run("redistribute", bpt::REMOVE_REDISTRIBUTE, records, ops, seed);
+  run("lazy", bpt::REMOVE_LAZY, records, ops, seed);
+  return 0;
+}
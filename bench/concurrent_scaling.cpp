@@ -0,0 +1,115 @@
+// Mixed read/write throughput of concurrent_bplustree at 1 to N threads,
+// next to a bplustree behind a std::shared_mutex (searches shared,
+// changes exclusive) as the baseline.
+//
+//   concurrent_scaling_bench [--records=2000000] [--operations=4000000]
+//                            [--threads=1,2,4,8] [--reads=95,50] [--seed=1]
+//
+// The trees start with the even int64 keys below 2 * records. Each
+// operation picks a key below 2 * records; it is a search with the given
+// percentage, otherwise an insert or a remove with equal odds, so the size
+// stays about the same. The operations are split evenly between the
+// threads. Results are in million operations per second.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+#include "concurrent_bplustree.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef bpt::record<std::int64_t, std::int64_t> record_type;
+
+class locked_tree {
+public:
+  bool search(std::int64_t pKey, std::int64_t &pValue) const {
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    const std::int64_t *value = mTree.search(pKey);
+    if (value) {
+      pValue = *value;
+    }
+    return value != nullptr;
+  }
+  bool insert(const record_type &pRecord) {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    return mTree.insert(pRecord);
+  }
+  bool remove(std::int64_t pKey) {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    return mTree.remove(pKey);
+  }
+
+private:
+  mutable std::shared_mutex mMutex;
+  bpt::bplustree<std::int64_t, std::int64_t> mTree;
+};
+
+template <typename Tree>
+double run(std::size_t pRecords, std::size_t pOperations, int pThreads,
+           int pReads, std::uint64_t pSeed) {
+  Tree tree;
+  for (std::size_t i = 0; i < pRecords; i++) {
+    tree.insert(record_type(std::int64_t(2 * i), std::int64_t(i)));
+  }
+  std::size_t share = pOperations / pThreads;
+  std::vector<std::thread> workers;
+  bench::clock::time_point start = bench::clock::now();
+  for (int t = 0; t < pThreads; t++) {
+    workers.emplace_back([&tree, pRecords, share, pReads, pSeed, t] {
+      std::mt19937_64 rng(pSeed + t);
+      std::uniform_int_distribution<std::int64_t> pick(0, 2 * pRecords - 1);
+      long found = 0;
+      for (std::size_t i = 0; i < share; i++) {
+        std::int64_t key = pick(rng);
+        std::uint64_t dice = rng() % 200;
+        if (dice < std::uint64_t(2 * pReads)) {
+          std::int64_t value;
+          found += tree.search(key, value);
+        } else if (dice % 2) {
+          found += tree.insert(record_type(key, key));
+        } else {
+          found += tree.remove(key);
+        }
+      }
+      bench::keep(found);
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+  return share * pThreads / bench::seconds_since(start) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t records = bench::get_option(argc, argv, "records", 2000000);
+  std::size_t operations =
+      bench::get_option(argc, argv, "operations", 4000000);
+  std::vector<std::uint64_t> threads =
+      bench::get_list_option(argc, argv, "threads", {1, 2, 4, 8});
+  std::vector<std::uint64_t> reads =
+      bench::get_list_option(argc, argv, "reads", {95, 50});
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  std::printf("%6s %8s %12s %12s   Mops/s\n", "reads", "threads",
+              "concurrent", "shared_mutex");
+  for (std::uint64_t read : reads) {
+    for (std::uint64_t count : threads) {
+      double olc = run<bpt::concurrent_bplustree<std::int64_t, std::int64_t>>(
+          records, operations, int(count), int(read), seed);
+      double locked =
+          run<locked_tree>(records, operations, int(count), int(read), seed);
+      std::printf("%5d%% %8d %12.2f %12.2f\n", int(read), int(count), olc,
+                  locked);
+    }
+  }
+  return 0;
+}
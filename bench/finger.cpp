@@ -0,0 +1,120 @@
+// Lookups and inserts with a finger against the same calls walking down
+// from the root, on key traces of three shapes: in key order, clustered in
+// runs of --run neighbouring keys that start at random places, and
+// uniformly random.
+//
+//   finger_bench [--sizes=100000,4000000] [--operations=2000000]
+//                [--run=64] [--seed=1]
+//
+// The trees are bulk-loaded with the even keys 0, 2, ... up to twice the
+// size. Lookups hit those; inserts add the odd keys between them, each
+// once, to a fresh tree for each of the two ways. Results are in million
+// operations per second.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+// pCount odd keys below 2 * pSize, in runs of pRun that ascend from
+// random starts; a run of 1 is a random trace and one of pSize a sorted
+// one
+std::vector<std::int64_t> make_trace(std::uint64_t pSize, std::uint64_t pRun,
+                                     std::size_t pCount,
+                                     std::mt19937_64 &pRng) {
+  std::vector<std::uint64_t> runs((pSize + pRun - 1) / pRun);
+  for (std::size_t i = 0; i < runs.size(); i++) {
+    runs[i] = i * pRun;
+  }
+  if (pRun < pSize) {
+    std::shuffle(runs.begin(), runs.end(), pRng);
+  }
+  std::vector<std::int64_t> keys;
+  keys.reserve(pCount);
+  for (std::uint64_t first : runs) {
+    for (std::uint64_t i = first;
+         i < std::min(first + pRun, pSize) && keys.size() < pCount; i++) {
+      keys.push_back(std::int64_t(2 * i + 1));
+    }
+  }
+  return keys;
+}
+
+void load(tree_type &pTree, std::uint64_t pSize) {
+  std::vector<tree_type::record_type> records;
+  records.reserve(pSize);
+  for (std::uint64_t i = 0; i < pSize; i++) {
+    records.emplace_back(std::int64_t(2 * i), std::int64_t(i));
+  }
+  pTree.bulk_load(records.begin(), records.end(), 0.7);
+}
+
+double run_search(const tree_type &pTree,
+                  const std::vector<std::int64_t> &pKeys, bool pFinger) {
+  tree_type::const_iterator finger;
+  bench::clock::time_point start = bench::clock::now();
+  long found = 0;
+  for (std::int64_t key : pKeys) {
+    found += (pFinger ? pTree.search(key - 1, finger)
+                      : pTree.search(key - 1)) != nullptr;
+  }
+  bench::keep(found);
+  return pKeys.size() / bench::seconds_since(start) / 1e6;
+}
+
+double run_insert(std::uint64_t pSize, const std::vector<std::int64_t> &pKeys,
+                  bool pFinger) {
+  tree_type tree;
+  load(tree, pSize);
+  tree_type::const_iterator finger;
+  bench::clock::time_point start = bench::clock::now();
+  long added = 0;
+  for (std::int64_t key : pKeys) {
+    tree_type::record_type record(key, key);
+    added += pFinger ? tree.insert(record, finger) : tree.insert(record);
+  }
+  bench::keep(added);
+  return pKeys.size() / bench::seconds_since(start) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::uint64_t> sizes =
+      bench::get_list_option(argc, argv, "sizes", {100000, 4000000});
+  std::size_t operations =
+      bench::get_option(argc, argv, "operations", 2000000);
+  std::uint64_t run = bench::get_option(argc, argv, "run", 64);
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  std::printf("%10s %-10s %10s %10s %10s %10s   Mops/s\n", "records",
+              "trace", "search", "finger", "insert", "finger");
+  for (std::uint64_t size : sizes) {
+    tree_type tree;
+    load(tree, size);
+    const struct {
+      const char *mName;
+      std::uint64_t mRun;
+    } traces[] = {{"sorted", size}, {"clustered", run}, {"random", 1}};
+    for (const auto &trace : traces) {
+      std::mt19937_64 rng(seed);
+      // inserts take each odd key once, so at most size of them
+      std::vector<std::int64_t> keys = make_trace(
+          size, trace.mRun, std::min<std::size_t>(operations, size), rng);
+      std::printf("%10llu %-10s %10.2f %10.2f %10.2f %10.2f\n",
+                  (unsigned long long)size, trace.mName,
+                  run_search(tree, keys, false), run_search(tree, keys, true),
+                  run_insert(size, keys, false),
+                  run_insert(size, keys, true));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Commit throughput and latency of durable_bplustree against the group
+// commit window, for several numbers of writer threads.
+//
+//   group_commit_bench [--threads=1,8,32] [--windows=0,50,200]
+//                      [--commits=20000] [--path=group_commit]
+//
+// Every thread inserts its own int64 keys, one durable insert at a time,
+// until the threads have made the given number of commits between them.
+// Checkpoints are off, so every commit costs one append and a share of
+// an fdatasync. The files are removed at the end.
+
+#include "bench_util.hpp"
+#include "durable_bplustree.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+typedef bpt::durable_bplustree<std::int64_t, std::int64_t> tree_type;
+
+void remove_files(const std::string &pPath) {
+  ::unlink((pPath + ".snapshot").c_str());
+  ::unlink((pPath + ".wal").c_str());
+}
+
+void run(const std::string &pPath, int pThreads, std::uint64_t pWindow,
+         std::size_t pCommits) {
+  remove_files(pPath);
+  tree_type tree;
+  if (!tree.open(pPath)) {
+    std::printf("cannot open %s\n", pPath.c_str());
+    return;
+  }
+  tree.set_checkpoint_threshold(0);
+  tree.set_commit_window(std::chrono::microseconds(pWindow));
+  std::size_t share = pCommits / pThreads;
+  std::vector<double> latency(pThreads);
+  std::vector<std::thread> writers;
+  bench::clock::time_point start = bench::clock::now();
+  for (int t = 0; t < pThreads; t++) {
+    writers.emplace_back([&tree, &latency, share, pThreads, t] {
+      double total = 0;
+      for (std::size_t i = 0; i < share; i++) {
+        std::int64_t key = std::int64_t(i) * pThreads + t;
+        bench::clock::time_point begin = bench::clock::now();
+        tree.insert(tree_type::record_type(key, key));
+        total += bench::seconds_since(begin);
+      }
+      latency[t] = total;
+    });
+  }
+  for (std::thread &w : writers) {
+    w.join();
+  }
+  double seconds = bench::seconds_since(start);
+  double total = 0;
+  for (double l : latency) {
+    total += l;
+  }
+  std::printf("%7d %6d us %12.1f %12.0f us\n", pThreads, int(pWindow),
+              share * pThreads / seconds / 1e3,
+              total * 1e6 / (share * pThreads));
+  tree.close();
+  remove_files(pPath);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::uint64_t> threads =
+      bench::get_list_option(argc, argv, "threads", {1, 8, 32});
+  std::vector<std::uint64_t> windows =
+      bench::get_list_option(argc, argv, "windows", {0, 50, 200});
+  std::size_t commits = bench::get_option(argc, argv, "commits", 20000);
+  const char *path = bench::find_option(argc, argv, "path");
+  std::string base = path ? path : "group_commit";
+
+  std::printf("%7s %9s %12s %15s\n", "threads", "window", "kcommits/s",
+              "mean latency");
+  for (std::uint64_t count : threads) {
+    for (std::uint64_t window : windows) {
+      run(base, int(count), window, commits);
+    }
+  }
+  return 0;
+}
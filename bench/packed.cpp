@@ -0,0 +1,159 @@
+// Compares packed_bplustree with the plain bplustree on the same int64
+// records for several key distributions: bytes of nodes per record,
+// random lookups and range scans.
+//
+//   packed_bench [--records=2000000] [--lookups=2000000] [--scans=20000]
+//                [--scan-length=1000] [--seed=1]
+//
+// The distributions:
+//
+//   dense      ids 0, 1, 2, ..., the case the packed leaves are made for
+//   gaps       ascending ids with random gaps of 1 to 64
+//   clustered  runs of 1000 dense ids scattered over the int64 range
+//   uniform    random keys over the whole int64 range
+//
+// Both trees are filled by insert() in the same shuffled order, so their
+// leaves are split alike. Lookups pick present keys at random; scans visit
+// scan-length records from a random present key. Times are in ns per
+// lookup and ns per scanned record.
+
+#include "bench_util.hpp"
+#include "packed_bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> plain_type;
+typedef bpt::packed_bplustree<std::int64_t, std::int64_t> packed_type;
+
+std::vector<std::int64_t> make_keys(const char *pName, std::size_t pCount,
+                                    std::mt19937_64 &pRng) {
+  std::vector<std::int64_t> keys;
+  keys.reserve(pCount);
+  std::string name(pName);
+  if (name == "dense") {
+    for (std::size_t i = 0; i < pCount; i++) {
+      keys.push_back(std::int64_t(i));
+    }
+  } else if (name == "gaps") {
+    std::int64_t key = 0;
+    for (std::size_t i = 0; i < pCount; i++) {
+      key += 1 + std::int64_t(pRng() % 64);
+      keys.push_back(key);
+    }
+  } else if (name == "clustered") {
+    while (keys.size() < pCount) {
+      std::int64_t start = std::int64_t(pRng() >> 1);
+      for (int i = 0; i < 1000 && keys.size() < pCount; i++) {
+        keys.push_back(start + i);
+      }
+    }
+  } else {
+    while (keys.size() < pCount) {
+      keys.push_back(std::int64_t(pRng()));
+    }
+  }
+  // clusters or random keys may collide
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+template <typename Tree>
+double time_lookups(const Tree &pTree, const std::vector<std::int64_t> &pKeys) {
+  bench::clock::time_point start = bench::clock::now();
+  long found = 0;
+  for (std::int64_t key : pKeys) {
+    found += pTree.search(key) != nullptr;
+  }
+  bench::keep(found);
+  return bench::seconds_since(start) * 1e9 / pKeys.size();
+}
+
+double time_scans(const plain_type &pTree,
+                  const std::vector<std::int64_t> &pStarts,
+                  std::size_t pLength) {
+  bench::clock::time_point start = bench::clock::now();
+  std::int64_t sum = 0;
+  std::size_t visited = 0;
+  for (std::int64_t key : pStarts) {
+    plain_type::const_iterator it = pTree.lower_bound(key);
+    for (std::size_t i = 0; i < pLength && it != pTree.end(); i++, ++it) {
+      sum += it.get_value();
+      visited++;
+    }
+  }
+  bench::keep(sum);
+  return bench::seconds_since(start) * 1e9 / visited;
+}
+
+// packed trees scan by key range, so each range ends at the key pLength
+// records on
+double time_scans(const packed_type &pTree,
+                  const std::vector<std::int64_t> &pStarts,
+                  const std::vector<std::int64_t> &pEnds) {
+  bench::clock::time_point start = bench::clock::now();
+  std::int64_t sum = 0;
+  std::size_t visited = 0;
+  for (std::size_t i = 0; i < pStarts.size(); i++) {
+    pTree.scan(pStarts[i], pEnds[i],
+               [&sum, &visited](std::int64_t, std::int64_t pValue) {
+                 sum += pValue;
+                 visited++;
+               });
+  }
+  bench::keep(sum);
+  return bench::seconds_since(start) * 1e9 / visited;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t records = bench::get_option(argc, argv, "records", 2000000);
+  std::size_t lookups = bench::get_option(argc, argv, "lookups", 2000000);
+  std::size_t scans = bench::get_option(argc, argv, "scans", 20000);
+  std::size_t length = bench::get_option(argc, argv, "scan-length", 1000);
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  std::printf("%-10s %10s  %-6s %9s %12s %12s\n", "keys", "records", "tree",
+              "B/record", "lookup ns", "scan ns/rec");
+  for (const char *name : {"dense", "gaps", "clustered", "uniform"}) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::int64_t> keys = make_keys(name, records, rng);
+    std::vector<std::int64_t> order(keys);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<std::int64_t> probes(lookups);
+    std::uniform_int_distribution<std::size_t> pick(0, keys.size() - 1);
+    for (std::int64_t &key : probes) {
+      key = keys[pick(rng)];
+    }
+    std::vector<std::int64_t> starts(scans), ends(scans);
+    for (std::size_t i = 0; i < scans; i++) {
+      std::size_t first = pick(rng);
+      std::size_t last = std::min(first + length, keys.size() - 1);
+      starts[i] = keys[first];
+      ends[i] = keys[last];
+    }
+
+    plain_type plain;
+    packed_type packed;
+    for (std::int64_t key : order) {
+      plain.insert(plain_type::record_type(key, key));
+      packed.insert(packed_type::record_type(key, key));
+    }
+    std::printf("%-10s %10zu  %-6s %9.1f %12.1f %12.2f\n", name, keys.size(),
+                "plain", double(plain.get_memory_usage()) / keys.size(),
+                time_lookups(plain, probes), time_scans(plain, starts, length));
+    std::printf("%-10s %10zu  %-6s %9.1f %12.1f %12.2f\n", name, keys.size(),
+                "packed", double(packed.get_memory_usage()) / keys.size(),
+                time_lookups(packed, probes), time_scans(packed, starts, ends));
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Build time against thread count: a tree is built from shuffled records
+// by serial insert(), by std::sort followed by bulk_load(), and by
+// parallel_bulk_load() at each thread count; insert_batch() then adds the
+// second half of the records to a tree holding the first half.
+//
+//   parallel_build_bench [--sizes=10000000] [--threads=1,2,4,8]
+//                        [--seed=1]
+//
+// Keys are the shuffled int64 ordinals 0 to size - 1. Every method gets a
+// fresh shuffled copy, and the time includes sorting where the method
+// sorts. Times are wall clock in seconds.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+bool by_key(const tree_type::record_type &pLeft,
+            const tree_type::record_type &pRight) {
+  return pLeft.get_key() < pRight.get_key();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::uint64_t> sizes =
+      bench::get_list_option(argc, argv, "sizes", {10000000});
+  std::vector<std::uint64_t> threads =
+      bench::get_list_option(argc, argv, "threads", {1, 2, 4, 8});
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  for (std::uint64_t size : sizes) {
+    std::vector<tree_type::record_type> shuffled;
+    shuffled.reserve(size);
+    for (std::uint64_t i = 0; i < size; i++) {
+      shuffled.emplace_back(std::int64_t(i), std::int64_t(i));
+    }
+    std::mt19937_64 rng(seed);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    std::printf("%llu records\n", (unsigned long long)size);
+    {
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      for (const tree_type::record_type &r : shuffled) {
+        tree.insert(r);
+      }
+      std::printf("  %-28s %8.3f s\n", "serial insert",
+                  bench::seconds_since(start));
+    }
+    {
+      std::vector<tree_type::record_type> records(shuffled);
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      std::sort(records.begin(), records.end(), by_key);
+      tree.bulk_load(records.begin(), records.end());
+      std::printf("  %-28s %8.3f s\n", "sort + bulk_load",
+                  bench::seconds_since(start));
+    }
+    for (std::uint64_t count : threads) {
+      std::vector<tree_type::record_type> records(shuffled);
+      tree_type tree;
+      bench::clock::time_point start = bench::clock::now();
+      tree.parallel_bulk_load(records.begin(), records.end(),
+                              unsigned(count));
+      char method[40];
+      std::snprintf(method, sizeof(method), "parallel_bulk_load %d thr",
+                    int(count));
+      std::printf("  %-28s %8.3f s\n", method, bench::seconds_since(start));
+    }
+    std::size_t half = size / 2;
+    for (std::uint64_t count : threads) {
+      std::vector<tree_type::record_type> first(shuffled.begin(),
+                                                shuffled.begin() + half);
+      tree_type tree;
+      tree.parallel_bulk_load(first.begin(), first.end(), unsigned(count));
+      bench::clock::time_point start = bench::clock::now();
+      tree.insert_batch(shuffled.data() + half, size - half, unsigned(count));
+      char method[40];
+      std::snprintf(method, sizeof(method), "insert_batch %d thr",
+                    int(count));
+      std::printf("  %-28s %8.3f s\n", method, bench::seconds_since(start));
+    }
+  }
+  return 0;
+}
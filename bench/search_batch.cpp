@@ -0,0 +1,91 @@
+// Throughput of uniform random lookups through search() one at a time and
+// through search_batch() at several batch sizes, on bulk-loaded int64
+// trees that fit into the cache and trees that do not.
+//
+//   search_batch_bench [--sizes=100000,4000000,32000000]
+//                      [--batches=8,32,128,512] [--lookups=2000000]
+//                      [--seed=1]
+//
+// Results are in million lookups per second.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+double run_single(const tree_type &pTree,
+                  const std::vector<std::int64_t> &pKeys) {
+  bench::clock::time_point start = bench::clock::now();
+  long found = 0;
+  for (std::int64_t key : pKeys) {
+    found += pTree.search(key) != nullptr;
+  }
+  bench::keep(found);
+  return pKeys.size() / bench::seconds_since(start) / 1e6;
+}
+
+double run_batch(const tree_type &pTree,
+                 const std::vector<std::int64_t> &pKeys,
+                 std::size_t pBatch) {
+  std::vector<const std::int64_t *> values(pBatch);
+  bench::clock::time_point start = bench::clock::now();
+  long found = 0;
+  for (std::size_t first = 0; first < pKeys.size(); first += pBatch) {
+    std::size_t count = std::min(pBatch, pKeys.size() - first);
+    pTree.search_batch(pKeys.data() + first, count, values.data());
+    for (std::size_t i = 0; i < count; i++) {
+      found += values[i] != nullptr;
+    }
+  }
+  bench::keep(found);
+  return pKeys.size() / bench::seconds_since(start) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::uint64_t> sizes = bench::get_list_option(
+      argc, argv, "sizes", {100000, 4000000, 32000000});
+  std::vector<std::uint64_t> batches =
+      bench::get_list_option(argc, argv, "batches", {8, 32, 128, 512});
+  std::size_t lookups = bench::get_option(argc, argv, "lookups", 2000000);
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  std::printf("%10s %8s", "records", "single");
+  for (std::uint64_t batch : batches) {
+    std::printf("  batch %-4d", int(batch));
+  }
+  std::printf("   Mops/s\n");
+  for (std::uint64_t size : sizes) {
+    std::vector<tree_type::record_type> records;
+    records.reserve(size);
+    for (std::uint64_t i = 0; i < size; i++) {
+      records.emplace_back(std::int64_t(i), std::int64_t(i));
+    }
+    tree_type tree;
+    tree.bulk_load(records.begin(), records.end(), 0.7);
+    records = std::vector<tree_type::record_type>();
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<std::int64_t> pick(0, size - 1);
+    std::vector<std::int64_t> keys(lookups);
+    for (std::int64_t &key : keys) {
+      key = pick(rng);
+    }
+    std::printf("%10llu %8.2f", (unsigned long long)size,
+                run_single(tree, keys));
+    for (std::uint64_t batch : batches) {
+      std::printf("  %10.2f", run_batch(tree, keys, batch));
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
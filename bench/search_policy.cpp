@@ -0,0 +1,116 @@
+// Compares binary_search_policy with simd_search_policy, first on a single
+// node that stays in the cache, then on random lookups in whole trees,
+// where cache misses dominate.
+//
+//   search_policy_bench [--probes=4000000] [--records=2000000]
+//                       [--lookups=2000000] [--seed=1]
+//
+// The node part times upper_bound over 8 to 256 keys in ns per call; the
+// tree part times search() in ns per lookup for fanouts 16, 30 and 64.
+
+#include "bench_util.hpp"
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int NODE_SIZES[] = {8, 16, 30, 64, 128, 256};
+
+template <typename Key, typename Policy>
+double time_node(const Key *pKeys, int pSize, const std::vector<Key> &pProbes) {
+  bench::clock::time_point start = bench::clock::now();
+  long sum = 0;
+  for (const Key &probe : pProbes) {
+    sum += Policy::upper_bound(pKeys, pSize, probe, std::less<Key>());
+  }
+  bench::keep(sum);
+  return bench::seconds_since(start) * 1e9 / pProbes.size();
+}
+
+template <typename Key>
+void run_node(std::size_t pProbes, std::uint64_t pSeed) {
+  // padded to whole cache lines, as in a node
+  alignas(64) Key keys[256 + 64 / sizeof(Key)] = {};
+  for (int i = 0; i < 256; i++) {
+    keys[i] = Key(2 * i);
+  }
+  for (int size : NODE_SIZES) {
+    std::mt19937_64 rng(pSeed);
+    std::uniform_int_distribution<int> pick(-1, 2 * size);
+    std::vector<Key> probes(pProbes);
+    for (Key &probe : probes) {
+      probe = Key(pick(rng));
+    }
+    double binary =
+        time_node<Key, bpt::binary_search_policy>(keys, size, probes);
+    double simd = time_node<Key, bpt::simd_search_policy>(keys, size, probes);
+    std::printf("node   int%-2d %5d keys  binary %6.1f  simd %6.1f ns/op\n",
+                int(8 * sizeof(Key)), size, binary, simd);
+  }
+}
+
+template <typename Key, int Fanout, typename Policy>
+double time_tree(const std::vector<bpt::record<Key, Key>> &pRecords,
+                 const std::vector<Key> &pLookups) {
+  bpt::bplustree<Key, Key, std::less<Key>, Fanout, Policy> tree;
+  tree.bulk_load(pRecords.begin(), pRecords.end(), 0.7);
+  bench::clock::time_point start = bench::clock::now();
+  long found = 0;
+  for (const Key &key : pLookups) {
+    found += tree.search(key) != nullptr;
+  }
+  bench::keep(found);
+  return bench::seconds_since(start) * 1e9 / pLookups.size();
+}
+
+template <typename Key, int Fanout>
+void run_tree(const std::vector<bpt::record<Key, Key>> &pRecords,
+              const std::vector<Key> &pLookups) {
+  double binary =
+      time_tree<Key, Fanout, bpt::binary_search_policy>(pRecords, pLookups);
+  double simd =
+      time_tree<Key, Fanout, bpt::simd_search_policy>(pRecords, pLookups);
+  std::printf("tree   int%-2d fanout %3d  binary %6.1f  simd %6.1f ns/op\n",
+              int(8 * sizeof(Key)), Fanout, binary, simd);
+}
+
+template <typename Key>
+void run_trees(std::size_t pRecords, std::size_t pLookups,
+               std::uint64_t pSeed) {
+  // odd keys are present, even ones are misses
+  std::vector<bpt::record<Key, Key>> records;
+  records.reserve(pRecords);
+  for (std::size_t i = 0; i < pRecords; i++) {
+    records.emplace_back(Key(2 * i + 1), Key(i));
+  }
+  std::mt19937_64 rng(pSeed);
+  std::uniform_int_distribution<std::uint64_t> pick(0, 2 * pRecords);
+  std::vector<Key> lookups(pLookups);
+  for (Key &key : lookups) {
+    key = Key(pick(rng));
+  }
+  run_tree<Key, 16>(records, lookups);
+  run_tree<Key, 30>(records, lookups);
+  run_tree<Key, 64>(records, lookups);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t probes = bench::get_option(argc, argv, "probes", 4000000);
+  std::size_t records = bench::get_option(argc, argv, "records", 2000000);
+  std::size_t lookups = bench::get_option(argc, argv, "lookups", 2000000);
+  std::uint64_t seed = bench::get_option(argc, argv, "seed", 1);
+
+  run_node<std::int32_t>(probes, seed);
+  run_node<std::int64_t>(probes, seed);
+  run_trees<std::int32_t>(records, lookups, seed);
+  run_trees<std::int64_t>(records, lookups, seed);
+  return 0;
+}
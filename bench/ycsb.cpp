@@ -0,0 +1,559 @@
+// YCSB-style benchmark of bplustree against std::map and a sorted vector.
+//
+// Every run loads a structure with pSize records whose keys are the
+// ordinals 0 to size - 1, then replays one pre-generated operation stream
+// against it, timing each operation. The same stream is replayed against
+// every structure. Results go to stdout (or --out) as JSON, one entry per
+// structure, workload, distribution and size; a table goes to stderr.
+//
+//   ycsb_bench [--sizes=1000,100000] [--ops=1000000] [--workloads=ABCDEF]
+//              [--distributions=sequential,uniform,zipfian]
+//              [--structures=bplustree,map,vector] [--seed=1] [--out=FILE]
+//
+// Workloads follow the YCSB core mixes with 8-byte keys and values:
+//   A  50% read, 50% update
+//   B  95% read, 5% update
+//   C  100% read
+//   D  95% read, 5% insert; reads favour the newest keys
+//   E  95% scan of 1 to 100 records, 5% insert
+//   F  50% read, 50% read-modify-write
+// Inserts append new ordinals past the largest key. Under the zipfian
+// distribution, popular ordinals are scattered over the key space by a
+// hash, as in YCSB's scrambled zipfian, except in workload D, where the
+// newest keys are the popular ones.
+
+#include "bplustree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::uint64_t key_type;
+typedef std::uint64_t value_type;
+
+// operations /////////////////////////////////////////////////////////////////
+enum op_kind { OP_READ, OP_UPDATE, OP_INSERT, OP_SCAN, OP_RMW };
+
+struct operation {
+  op_kind mKind;
+  // records a scan visits
+  int mLength;
+  key_type mKey;
+};
+
+struct workload {
+  char mName;
+  // shares of reads, updates, inserts, scans and read-modify-writes
+  double mMix[5];
+  // reads pick the newest keys under the zipfian distribution
+  bool mLatest;
+};
+
+const workload WORKLOADS[] = {
+    {'A', {0.5, 0.5, 0, 0, 0}, false},  {'B', {0.95, 0.05, 0, 0, 0}, false},
+    {'C', {1, 0, 0, 0, 0}, false},      {'D', {0.95, 0, 0.05, 0, 0}, true},
+    {'E', {0, 0, 0.05, 0.95, 0}, false}, {'F', {0.5, 0, 0, 0, 0.5}, false}};
+
+enum distribution { DIST_SEQUENTIAL, DIST_UNIFORM, DIST_ZIPFIAN };
+
+const char *const DISTRIBUTION_NAMES[] = {"sequential", "uniform", "zipfian"};
+
+// zipfian_generator class ////////////////////////////////////////////////////
+// Draws ranks 0 to pItems - 1 with P(rank i) proportional to 1 / (i + 1)^
+// pTheta, by the method of Gray et al., "Quickly Generating Billion-Record
+// Synthetic Databases", as YCSB does.
+class zipfian_generator {
+public:
+  zipfian_generator(std::uint64_t pItems, double pTheta)
+      : mItems(pItems), mTheta(pTheta), mAlpha(1 / (1 - pTheta)),
+        mZetaN(get_zeta(pItems, pTheta)),
+        mEta((1 - std::pow(2.0 / pItems, 1 - pTheta)) /
+             (1 - get_zeta(2, pTheta) / mZetaN)) {}
+
+  template <typename Rng> std::uint64_t next(Rng &pRng) {
+    double u = std::uniform_real_distribution<double>(0, 1)(pRng);
+    double uz = u * mZetaN;
+    if (uz < 1) {
+      return 0;
+    }
+    if (uz < 1 + std::pow(0.5, mTheta)) {
+      return 1;
+    }
+    std::uint64_t rank =
+        std::uint64_t(mItems * std::pow(mEta * u - mEta + 1, mAlpha));
+    return std::min(rank, mItems - 1);
+  }
+
+private:
+  static double get_zeta(std::uint64_t pItems, double pTheta) {
+    double sum = 0;
+    for (std::uint64_t i = 1; i <= pItems; i++) {
+      sum += 1 / std::pow(double(i), pTheta);
+    }
+    return sum;
+  }
+
+  std::uint64_t mItems;
+  double mTheta, mAlpha, mZetaN, mEta;
+};
+
+std::uint64_t fnv_hash(std::uint64_t pValue) {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (int i = 0; i < 8; i++) {
+    hash = (hash ^ (pValue & 0xff)) * 0x100000001b3ull;
+    pValue >>= 8;
+  }
+  return hash;
+}
+
+std::vector<operation> generate(const workload &pWorkload,
+                                distribution pDistribution,
+                                std::uint64_t pSize, std::size_t pCount,
+                                std::uint64_t pSeed) {
+  std::mt19937_64 rng(pSeed);
+  std::discrete_distribution<int> kinds(pWorkload.mMix, pWorkload.mMix + 5);
+  std::uniform_int_distribution<int> lengths(1, 100);
+  zipfian_generator zipf(pDistribution == DIST_ZIPFIAN ? pSize : 2, 0.99);
+  std::uint64_t records = pSize, cursor = 0;
+  std::vector<operation> ops(pCount);
+  for (operation &op : ops) {
+    op.mKind = op_kind(kinds(rng));
+    op.mLength = op.mKind == OP_SCAN ? lengths(rng) : 0;
+    if (op.mKind == OP_INSERT) {
+      op.mKey = records++;
+    } else if (pDistribution == DIST_SEQUENTIAL) {
+      op.mKey = cursor++ % records;
+    } else if (pDistribution == DIST_UNIFORM) {
+      std::uniform_int_distribution<std::uint64_t> keys(0, records - 1);
+      op.mKey = keys(rng);
+    } else if (pWorkload.mLatest) {
+      // the popular ranks count back from the newest record
+      op.mKey = records - 1 - std::min(zipf.next(rng), records - 1);
+    } else {
+      op.mKey = fnv_hash(zipf.next(rng)) % records;
+    }
+  }
+  return ops;
+}
+
+// latency_histogram class ////////////////////////////////////////////////////
+// Log-linear histogram of nanoseconds: exact below 64, then 32 buckets per
+// power of two, so a percentile is within about 3% of the true value.
+class latency_histogram {
+public:
+  latency_histogram() : mCounts(64 + 58 * 32), mTotal(0), mMax(0) {}
+
+  void add(std::uint64_t pNanos) {
+    mCounts[get_bucket(pNanos)]++;
+    mTotal++;
+    mMax = std::max(mMax, pNanos);
+  }
+
+  // smallest latency of the bucket holding the pFraction quantile
+  std::uint64_t get_percentile(double pFraction) const {
+    std::uint64_t rank = std::uint64_t(std::ceil(pFraction * mTotal));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < mCounts.size(); i++) {
+      seen += mCounts[i];
+      if (seen >= rank && seen > 0) {
+        return get_lowest(i);
+      }
+    }
+    return mMax;
+  }
+
+  std::uint64_t get_max() const { return mMax; }
+
+private:
+  static std::size_t get_bucket(std::uint64_t pNanos) {
+    if (pNanos < 64) {
+      return pNanos;
+    }
+    int exponent = 63 - __builtin_clzll(pNanos);
+    return 64 + (exponent - 6) * 32 + ((pNanos >> (exponent - 5)) & 31);
+  }
+
+  static std::uint64_t get_lowest(std::size_t pBucket) {
+    if (pBucket < 64) {
+      return pBucket;
+    }
+    int exponent = int(pBucket - 64) / 32 + 6;
+    return (std::uint64_t(32 + (pBucket - 64) % 32)) << (exponent - 5);
+  }
+
+  std::vector<std::uint64_t> mCounts;
+  std::uint64_t mTotal, mMax;
+};
+
+// structures /////////////////////////////////////////////////////////////////
+// Adapters give the structures one interface. Every one of them is loaded
+// with sorted, unique keys.
+
+class tree_adapter {
+public:
+  static const char *get_name() { return "bplustree"; }
+
+  void load(const std::vector<std::pair<key_type, value_type>> &pRecords) {
+    std::vector<bpt::record<key_type, value_type>> records;
+    records.reserve(pRecords.size());
+    for (const auto &r : pRecords) {
+      records.emplace_back(r.first, r.second);
+    }
+    // leave the leaves room for inserts, as a tree grown by them would
+    mTree.bulk_load(records.begin(), records.end(), 0.7);
+  }
+
+  value_type read(key_type pKey) const {
+    const value_type *value = mTree.search(pKey);
+    return value ? *value : 0;
+  }
+
+  void update(key_type pKey, value_type pValue) {
+    mTree.insert_or_assign(pKey, pValue);
+  }
+
+  void insert(key_type pKey, value_type pValue) {
+    mTree.insert(bpt::record<key_type, value_type>(pKey, pValue));
+  }
+
+  value_type scan(key_type pKey, int pLength) const {
+    value_type sum = 0;
+    auto it = mTree.lower_bound(pKey);
+    for (int i = 0; i < pLength && it != mTree.end(); i++, ++it) {
+      sum += it.get_value();
+    }
+    return sum;
+  }
+
+  void read_modify_write(key_type pKey) {
+    mTree.update(pKey, [](value_type &pValue) { pValue++; });
+  }
+
+private:
+  bpt::bplustree<key_type, value_type> mTree;
+};
+
+class map_adapter {
+public:
+  static const char *get_name() { return "std::map"; }
+
+  void load(const std::vector<std::pair<key_type, value_type>> &pRecords) {
+    for (const auto &r : pRecords) {
+      mMap.emplace_hint(mMap.end(), r.first, r.second);
+    }
+  }
+
+  value_type read(key_type pKey) const {
+    auto it = mMap.find(pKey);
+    return it != mMap.end() ? it->second : 0;
+  }
+
+  void update(key_type pKey, value_type pValue) { mMap[pKey] = pValue; }
+
+  void insert(key_type pKey, value_type pValue) { mMap.emplace(pKey, pValue); }
+
+  value_type scan(key_type pKey, int pLength) const {
+    value_type sum = 0;
+    auto it = mMap.lower_bound(pKey);
+    for (int i = 0; i < pLength && it != mMap.end(); i++, ++it) {
+      sum += it->second;
+    }
+    return sum;
+  }
+
+  void read_modify_write(key_type pKey) { mMap[pKey]++; }
+
+private:
+  std::map<key_type, value_type> mMap;
+};
+
+// std::vector of records kept sorted: binary search to find, memmove to
+// insert
+class vector_adapter {
+public:
+  static const char *get_name() { return "sorted_vector"; }
+
+  void load(const std::vector<std::pair<key_type, value_type>> &pRecords) {
+    mRecords = pRecords;
+  }
+
+  value_type read(key_type pKey) const {
+    auto it = find(pKey);
+    return it != mRecords.end() && it->first == pKey ? it->second : 0;
+  }
+
+  void update(key_type pKey, value_type pValue) {
+    auto it = find(pKey);
+    if (it != mRecords.end() && it->first == pKey) {
+      it->second = pValue;
+    } else {
+      mRecords.emplace(it, pKey, pValue);
+    }
+  }
+
+  void insert(key_type pKey, value_type pValue) { update(pKey, pValue); }
+
+  value_type scan(key_type pKey, int pLength) const {
+    value_type sum = 0;
+    auto it = find(pKey);
+    for (int i = 0; i < pLength && it != mRecords.end(); i++, ++it) {
+      sum += it->second;
+    }
+    return sum;
+  }
+
+  void read_modify_write(key_type pKey) {
+    auto it = find(pKey);
+    if (it != mRecords.end() && it->first == pKey) {
+      it->second++;
+    } else {
+      mRecords.emplace(it, pKey, 1);
+    }
+  }
+
+private:
+  typedef std::vector<std::pair<key_type, value_type>> records_type;
+
+  records_type::const_iterator find(key_type pKey) const {
+    return std::lower_bound(
+        mRecords.begin(), mRecords.end(), pKey,
+        [](const std::pair<key_type, value_type> &pLeft, key_type pRight) {
+          return pLeft.first < pRight;
+        });
+  }
+
+  records_type::iterator find(key_type pKey) {
+    auto it = static_cast<const vector_adapter *>(this)->find(pKey);
+    return mRecords.begin() + (it - mRecords.cbegin());
+  }
+
+  records_type mRecords;
+};
+
+// runs ///////////////////////////////////////////////////////////////////////
+struct result {
+  std::string mStructure;
+  char mWorkload;
+  distribution mDistribution;
+  std::uint64_t mSize;
+  std::size_t mOperations;
+  double mSeconds;
+  latency_histogram mLatency;
+};
+
+// keeps the reads from being optimized away
+volatile value_type gSink;
+
+template <typename Adapter>
+result run(const std::vector<std::pair<key_type, value_type>> &pRecords,
+           const std::vector<operation> &pOps) {
+  typedef std::chrono::steady_clock clock;
+  Adapter adapter;
+  adapter.load(pRecords);
+  result res;
+  res.mStructure = Adapter::get_name();
+  res.mOperations = pOps.size();
+  value_type sink = 0;
+  clock::time_point start = clock::now(), before = start;
+  for (const operation &op : pOps) {
+    switch (op.mKind) {
+    case OP_READ:
+      sink += adapter.read(op.mKey);
+      break;
+    case OP_UPDATE:
+      adapter.update(op.mKey, op.mKey + 1);
+      break;
+    case OP_INSERT:
+      adapter.insert(op.mKey, op.mKey);
+      break;
+    case OP_SCAN:
+      sink += adapter.scan(op.mKey, op.mLength);
+      break;
+    case OP_RMW:
+      adapter.read_modify_write(op.mKey);
+      break;
+    }
+    clock::time_point after = clock::now();
+    res.mLatency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         after - before)
+                         .count());
+    before = after;
+  }
+  res.mSeconds = std::chrono::duration<double>(before - start).count();
+  gSink = sink;
+  return res;
+}
+
+// command line ///////////////////////////////////////////////////////////////
+struct options {
+  std::vector<std::uint64_t> mSizes{1000, 100000};
+  std::size_t mOps = 1000000;
+  std::string mWorkloads = "ABCDEF";
+  std::vector<std::string> mDistributions{"sequential", "uniform", "zipfian"};
+  std::vector<std::string> mStructures{"bplustree", "map", "vector"};
+  std::uint64_t mSeed = 1;
+  std::string mOut;
+};
+
+std::vector<std::string> split_list(const std::string &pList) {
+  std::vector<std::string> items;
+  std::size_t first = 0;
+  while (first <= pList.size()) {
+    std::size_t comma = std::min(pList.find(',', first), pList.size());
+    if (comma > first) {
+      items.push_back(pList.substr(first, comma - first));
+    }
+    first = comma + 1;
+  }
+  return items;
+}
+
+// false on an unknown argument
+bool parse(int pArgc, char **pArgv, options &pOptions) {
+  for (int i = 1; i < pArgc; i++) {
+    std::string arg = pArgv[i];
+    std::size_t equals = arg.find('=');
+    if (equals == std::string::npos) {
+      return false;
+    }
+    std::string name = arg.substr(0, equals), value = arg.substr(equals + 1);
+    if (name == "--sizes") {
+      pOptions.mSizes.clear();
+      for (const std::string &size : split_list(value)) {
+        pOptions.mSizes.push_back(std::strtoull(size.c_str(), nullptr, 10));
+      }
+    } else if (name == "--ops") {
+      pOptions.mOps = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--workloads") {
+      pOptions.mWorkloads = value;
+    } else if (name == "--distributions") {
+      pOptions.mDistributions = split_list(value);
+    } else if (name == "--structures") {
+      pOptions.mStructures = split_list(value);
+    } else if (name == "--seed") {
+      pOptions.mSeed = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--out") {
+      pOptions.mOut = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void write_json(std::FILE *pOut, const options &pOptions,
+                const std::vector<result> &pResults) {
+  std::fprintf(pOut, "{\n  \"benchmark\": \"ycsb\",\n  \"seed\": %llu,\n"
+                     "  \"results\": [",
+               (unsigned long long)pOptions.mSeed);
+  for (std::size_t i = 0; i < pResults.size(); i++) {
+    const result &r = pResults[i];
+    std::fprintf(
+        pOut,
+        "%s\n    {\"structure\": \"%s\", \"workload\": \"%c\", "
+        "\"distribution\": \"%s\", \"size\": %llu, \"operations\": %zu, "
+        "\"seconds\": %.6f, \"ops_per_second\": %.0f, \"latency_ns\": "
+        "{\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}}",
+        i ? "," : "", r.mStructure.c_str(), r.mWorkload,
+        DISTRIBUTION_NAMES[r.mDistribution], (unsigned long long)r.mSize,
+        r.mOperations, r.mSeconds, r.mOperations / r.mSeconds,
+        (unsigned long long)r.mLatency.get_percentile(0.5),
+        (unsigned long long)r.mLatency.get_percentile(0.99),
+        (unsigned long long)r.mLatency.get_percentile(0.999),
+        (unsigned long long)r.mLatency.get_max());
+  }
+  std::fprintf(pOut, "\n  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  options opts;
+  if (!parse(argc, argv, opts)) {
+    std::fprintf(stderr,
+                 "usage: %s [--sizes=N,...] [--ops=N] [--workloads=ABCDEF] "
+                 "[--distributions=sequential,uniform,zipfian] "
+                 "[--structures=bplustree,map,vector] [--seed=N] "
+                 "[--out=FILE]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::vector<result> results;
+  std::fprintf(stderr, "%-14s %s %-10s %10s %12s %8s %8s %8s\n", "structure",
+               "w", "dist", "size", "ops/s", "p50", "p99", "p999");
+  for (std::uint64_t size : opts.mSizes) {
+    std::vector<std::pair<key_type, value_type>> records(size);
+    for (std::uint64_t i = 0; i < size; i++) {
+      records[i] = std::make_pair(i, i);
+    }
+    for (char name : opts.mWorkloads) {
+      const workload *w = nullptr;
+      for (const workload &candidate : WORKLOADS) {
+        if (candidate.mName == name) {
+          w = &candidate;
+        }
+      }
+      for (const std::string &distName : opts.mDistributions) {
+        int dist = 0;
+        while (dist < 3 && distName != DISTRIBUTION_NAMES[dist]) {
+          dist++;
+        }
+        if (!w || dist == 3) {
+          std::fprintf(stderr, "unknown workload %c or distribution %s\n",
+                       name, distName.c_str());
+          return 2;
+        }
+        std::vector<operation> ops = generate(*w, distribution(dist), size,
+                                              opts.mOps, opts.mSeed);
+        for (const std::string &structure : opts.mStructures) {
+          result r;
+          if (structure == "bplustree") {
+            r = run<tree_adapter>(records, ops);
+          } else if (structure == "map") {
+            r = run<map_adapter>(records, ops);
+          } else if (structure == "vector") {
+            r = run<vector_adapter>(records, ops);
+          } else {
+            std::fprintf(stderr, "unknown structure %s\n", structure.c_str());
+            return 2;
+          }
+          r.mWorkload = name;
+          r.mDistribution = distribution(dist);
+          r.mSize = size;
+          std::fprintf(stderr, "%-14s %c %-10s %10llu %12.0f %8llu %8llu "
+                               "%8llu\n",
+                       r.mStructure.c_str(), name, distName.c_str(),
+                       (unsigned long long)size, r.mOperations / r.mSeconds,
+                       (unsigned long long)r.mLatency.get_percentile(0.5),
+                       (unsigned long long)r.mLatency.get_percentile(0.99),
+                       (unsigned long long)r.mLatency.get_percentile(0.999));
+          results.push_back(r);
+        }
+      }
+    }
+  }
+
+  std::FILE *out = opts.mOut.empty() ? stdout : std::fopen(opts.mOut.c_str(),
+                                                            "w");
+  if (!out) {
+    std::fprintf(stderr, "cannot write %s\n", opts.mOut.c_str());
+    return 1;
+  }
+  write_json(out, opts, results);
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return 0;
+}
@@ -1,117 +1,511 @@
-#include <memory>
+#ifndef BPLUSTREE_HPP
+#define BPLUSTREE_HPP
+
+#include "key_search.hpp"
+#include "node_pool.hpp"
+#include "parallel.hpp"
+#include "tree_dump.hpp"
+#include "tree_stats.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <string>
 #include <vector>
 
-static const int MAX_THRESHOLD = 30;
-static const int MIN_THRESHOLD = 5;
+namespace bpt {
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+class bplustree;
+
+// compile-time parameters shared by every class of one tree instantiation
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted = false>
+struct bplustree_traits {
+  static_assert(Fanout >= 3, "fanout must be at least 3");
+
+  typedef Key key_type;
+  typedef Value value_type;
+  typedef Compare key_compare;
+  typedef Search search_policy;
+  typedef bplustree<Key, Value, Compare, Fanout, Search, Counted> tree_type;
+
+  static constexpr int MAX_THRESHOLD = Fanout;
+  static constexpr int MIN_THRESHOLD = Fanout / 6 > 0 ? Fanout / 6 : 1;
+  static constexpr int CACHE_LINE = 64;
+  // inner nodes keep the number of records below each child
+  static constexpr bool COUNTED = Counted;
+
+  static bool less(const Key &pLeft, const Key &pRight) {
+    return Compare()(pLeft, pRight);
+  }
+};
+
+// Key that a leaf split posts to the parent, given the last key pLeft of
+// the left half and the first key pRight of the right half. Any key greater
+// than pLeft and not greater than pRight routes lookups correctly, so key
+// types that can be shortened specialise this to keep inner nodes small
+// (see string_key.hpp).
+template <typename Key, typename Compare> struct key_separator {
+  static Key make(const Key &, const Key &pRight) { return pRight; }
+};
 
-class node;
+// What remove() does with a node that falls below MIN_THRESHOLD.
+enum remove_policy {
+  // merge it into a sibling if the two fit into one node, else leave it
+  REMOVE_MERGE,
+  // merge it if the two fit, else move entries over from the fuller
+  // sibling until both hold the same number
+  REMOVE_REDISTRIBUTE,
+  // Leave it underfull, even empty. A compaction pass trailing the
+  // removes merges and evens out the leaves later, one leaf every few
+  // removes.
+  REMOVE_LAZY
+};
 
-class record {
-  friend bool operator<(const record &pLeft, const record &pRight);
+// pull every cache line of *pObject towards the core without waiting
+template <typename T> inline void prefetch_lines(const T *pObject) {
+#ifdef __GNUC__
+  const char *bytes = reinterpret_cast<const char *>(pObject);
+  for (std::size_t i = 0; i < sizeof(T); i += 64) {
+    __builtin_prefetch(bytes + i);
+  }
+#endif
+}
 
+template <typename Key, typename Value> class record {
 public:
-  record(int pKey);
-  record(int pKey, int pValue);
+  record(const Key &pKey, const Value &pValue);
   record(const record &pRecord);
   record &operator=(const record &pRecord);
-  int get_key() const;
-  int get_value() const;
+  const Key &get_key() const;
+  const Value &get_value() const;
 
 private:
-  int mKey;
-  int mValue;
+  Key mKey;
+  Value mValue;
 };
 
-class link {
-  friend class inner_node;
-  friend class bplustree;
+template <typename Traits> class node;
+template <typename Traits> class inner_node;
+template <typename Traits> class leaf_node;
+
+template <typename Traits> class link {
+  friend class inner_node<Traits>;
+  friend typename Traits::tree_type;
 
 public:
-  friend bool operator<(const link &pLeft, const link &pRight);
-  link(int pKey);
-  link(int pKey, bool pIsLeaf);
+  typedef typename Traits::key_type key_type;
+
+  link(const key_type &pKey);
+  link(const key_type &pKey, node<Traits> *pNode);
   link(const link &pLink);
   link &operator=(const link &pLink);
-  void set_key(int pKey);
-  int get_key() const;
-  node *get_node() const;
+  void set_key(const key_type &pKey);
+  const key_type &get_key() const;
+  node<Traits> *get_node() const;
 
 private:
-  int mKey;
-  std::shared_ptr<node> mID;
+  key_type mKey;
+  node<Traits> *mID;
 };
 
-class inner_node;
+// Nodes are fixed-size and carry their entries inline: the keys of a node
+// sit in one cache-line aligned array shared by both node kinds, and the
+// values (leaf) or children (inner) live in a parallel array behind it. One
+// spare slot lets a node overflow by one entry before it is split. There are
+// no virtual functions; code that needs the concrete type checks is_leaf()
+// and uses static_cast. Nodes do not know their parent: changes that reach
+// upwards follow the path recorded on the way down.
+template <typename Traits> class node {
+  friend typename Traits::tree_type;
 
-class node {
 public:
-  node(bool pIsLeaf);
-  virtual ~node();
-  virtual node *join_sibling_node() = 0;
-  virtual int get_size() const = 0;
-  virtual bool is_too_big() const = 0;
-  virtual bool is_too_small() const = 0;
-  virtual int get_key(int pIndex) const = 0;
+  typedef typename Traits::key_type key_type;
+
+  static constexpr int CAPACITY = Traits::MAX_THRESHOLD + 1;
+  // CAPACITY rounded up to whole cache lines, so that search policies can
+  // compare the keys a full vector at a time
+  static constexpr int KEY_SLOTS =
+      (CAPACITY * sizeof(key_type) + Traits::CACHE_LINE - 1) /
+      Traits::CACHE_LINE * Traits::CACHE_LINE / sizeof(key_type);
+
   bool is_leaf() const;
-  void set_parent(inner_node *);
-  inner_node *get_parent() const;
+  int get_size() const;
+  bool is_too_big() const;
+  bool is_too_small() const;
+  const key_type &get_key(int pIndex) const;
+  int lower_bound(const key_type &pKey) const;
+  int upper_bound(const key_type &pKey) const;
   void set_prev(node *);
   node *get_prev() const;
   void set_next(node *);
   node *get_next() const;
 
-private:
+protected:
+  node(bool pIsLeaf);
+  ~node() = default;
+
   bool mIsLeaf;
-  inner_node *mParent;
+  int mSize;
   node *mPrev, *mNext;
+  alignas(Traits::CACHE_LINE) key_type mKeys[KEY_SLOTS];
 };
 
-class leaf_node : public node {
-  friend class bplustree;
+template <typename Traits> class leaf_node : public node<Traits> {
+  friend typename Traits::tree_type;
 
 public:
+  typedef typename Traits::key_type key_type;
+  typedef typename Traits::value_type value_type;
+  typedef record<key_type, value_type> record_type;
+
   leaf_node();
-  int get_size() const override;
-  bool is_too_big() const override;
-  bool is_too_small() const override;
-  int get_key(int pIndex) const override;
-  node *join_sibling_node() override;
-  void add_record(const record &pRecord);
-  void remove_record(int pKey);
-  const record *search(int pKey) const;
+  const value_type &get_value(int pIndex) const;
+  void add_record(const record_type &pRecord);
+  void remove_record(const key_type &pKey);
+  const value_type *search(const key_type &pKey) const;
+  // index of the first key not less than pKey; pFound tells if it equals
+  // pKey
+  int find(const key_type &pKey, bool &pFound) const;
 
 private:
-  std::vector<record> mRecords;
+  void insert_at(int pIndex, const key_type &pKey, value_type &&pValue);
+  void split_into(leaf_node *pNew, int pFrom);
+  void merge_from(leaf_node *pRight);
+  void redistribute(leaf_node *pRight);
+
+  value_type mValues[node<Traits>::CAPACITY];
+};
+
+// A child of an inner node. Counted trees keep the number of records below
+// the child next to it, so the count moves along with the child whenever
+// links are shifted. For other trees the count reads zero and setting it
+// compiles to nothing.
+template <typename Traits, bool = Traits::COUNTED> struct child_slot {
+  child_slot() = default;
+  child_slot(node<Traits> *pNode) : mNode(pNode) {}
+  std::size_t get_count() const { return 0; }
+  void set_count(std::size_t) {}
+  void add_count(std::ptrdiff_t) {}
+
+  node<Traits> *mNode;
+};
+
+template <typename Traits> struct child_slot<Traits, true> {
+  child_slot() = default;
+  child_slot(node<Traits> *pNode) : mNode(pNode), mCount(0) {}
+  std::size_t get_count() const { return mCount; }
+  void set_count(std::size_t pCount) { mCount = pCount; }
+  void add_count(std::ptrdiff_t pDelta) { mCount += pDelta; }
+
+  node<Traits> *mNode;
+  std::size_t mCount;
 };
 
-class inner_node : public node {
-  friend class bplustree;
+// Child i sits to the right of key i - 1; child 0 is the heir, which holds
+// every key smaller than key 0.
+template <typename Traits> class inner_node : public node<Traits> {
+  friend typename Traits::tree_type;
 
 public:
+  typedef typename Traits::key_type key_type;
+
   inner_node();
-  inner_node(const std::shared_ptr<node> &pHeir);
-  int get_size() const override;
-  bool is_too_big() const override;
-  bool is_too_small() const override;
-  int get_key(int pIndex) const override;
-  node *join_sibling_node() override;
-  void add_link(const link &pLink);
-  void remove_link(int pKey);
-  node *search(int pKey) const;
+  inner_node(node<Traits> *pHeir);
+  node<Traits> *get_heir() const;
+  node<Traits> *get_child(int pIndex) const;
+  void add_link(const link<Traits> &pLink);
+  void remove_link(const key_type &pKey);
+  node<Traits> *search(const key_type &pKey) const;
+
+private:
+  void insert_at(int pIndex, const link<Traits> &pLink);
+  void erase(int pIndex);
+  void split_into(inner_node *pNew, int pFrom);
+  void merge_from(inner_node *pRight, const key_type &pSeparator);
+  key_type redistribute(inner_node *pRight, const key_type &pSeparator);
+
+  child_slot<Traits> mChildren[node<Traits>::CAPACITY + 1];
+};
+
+// Bidirectional cursor over the records in key order, walking the leaf
+// chain. Entering a leaf prefetches the next one, so a long scan overlaps
+// that miss with the work on the current leaf. Dereferencing yields a copy
+// of the record; get_key and get_value read it in place. Any insert or
+// remove invalidates every iterator of the tree.
+template <typename Traits> class tree_iterator {
+  friend typename Traits::tree_type;
+
+public:
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef record<typename Traits::key_type, typename Traits::value_type>
+      value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef void pointer;
+  typedef value_type reference;
+
+  tree_iterator();
+  const typename Traits::key_type &get_key() const;
+  const typename Traits::value_type &get_value() const;
+  reference operator*() const;
+  tree_iterator &operator++();
+  tree_iterator operator++(int);
+  tree_iterator &operator--();
+  tree_iterator operator--(int);
+  bool operator==(const tree_iterator &pOther) const;
+  bool operator!=(const tree_iterator &pOther) const;
 
 private:
-  std::shared_ptr<node> mHeir;
-  std::vector<link> mLinks;
+  tree_iterator(const leaf_node<Traits> *pLeaf, int pIndex);
+  void enter(const leaf_node<Traits> *pLeaf, int pIndex);
+  void skip_forward();
+
+  // either mIndex < mLeaf->get_size(), or mLeaf is the last leaf and
+  // mIndex == mLeaf->get_size() (the end position)
+  const leaf_node<Traits> *mLeaf;
+  int mIndex;
 };
 
+// a [begin, end) pair of iterators usable in range-based for
+template <typename Iterator> class iterator_range {
+public:
+  iterator_range(Iterator pBegin, Iterator pEnd);
+  Iterator begin() const;
+  Iterator end() const;
+  bool empty() const;
+
+private:
+  Iterator mBegin, mEnd;
+};
+
+// With Counted, every inner node also keeps the number of records below
+// each of its children, which rank(), select() and count() add up on one
+// walk down. Inserts and removes then update the counts on their path, and
+// inserts always walk down from the root, skipping the shortcuts for
+// appends and finger inserts.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          int Fanout = 30, typename Search = simd_search_policy,
+          bool Counted = false>
 class bplustree {
 public:
+  typedef bplustree_traits<Key, Value, Compare, Fanout, Search, Counted>
+      traits;
+  typedef record<Key, Value> record_type;
+  typedef tree_iterator<traits> const_iterator;
+  typedef iterator_range<const_iterator> const_range;
+
   bplustree();
-  const record *search(int pKey) const;
-  bool insert(const record &pRecord);
-  bool remove(int pKey);
+  bplustree(const bplustree &) = delete;
+  bplustree &operator=(const bplustree &) = delete;
+  ~bplustree();
+  const Value *search(const Key &pKey) const;
+  // the value of pKey, which may be changed in place, or nullptr
+  Value *search(const Key &pKey);
+  // Looks up pCount keys at once and stores the value of pKeys[i], or
+  // nullptr if it is absent, in pOut[i]. The lookups advance through the
+  // tree a group at a time, one level per step, prefetching every child
+  // before any of them is searched, so the cache misses of a group overlap.
+  void search_batch(const Key *pKeys, std::size_t pCount,
+                    const Value **pOut) const;
+  bool insert(const record_type &pRecord);
+  // Lookups and inserts for clustered keys, which start at the leaf of
+  // pFinger, an iterator left there by the previous call, and step over
+  // at most FINGER_STEPS neighbouring leaves before they fall back to a
+  // walk down from the root. search moves pFinger to the first record not
+  // less than pKey; insert leaves it on the inserted record, which goes
+  // after any records with an equal key. A default-constructed finger
+  // always walks down, and any change made without the finger invalidates
+  // it, as it does every iterator.
+  const Value *search(const Key &pKey, const_iterator &pFinger) const;
+  bool insert(const record_type &pRecord, const_iterator &pFinger);
+  // Upserts that walk down to the leaf once, unlike search followed by
+  // remove and insert. Each returns true if pKey was already present; with
+  // duplicate keys it acts on the first record of pKey in the leaf it walks
+  // down to, which is the last leaf holding pKey if they span several.
+  //
+  // insert_or_assign sets the value of pKey to pValue, adding the key if it
+  // is absent.
+  template <typename V> bool insert_or_assign(const Key &pKey, V &&pValue);
+  // adds pKey with a value built from pArgs, unless pKey is present, in
+  // which case nothing is built
+  template <typename... Args>
+  bool try_emplace(const Key &pKey, Args &&...pArgs);
+  // Calls pFn(Value &) on the value of pKey in place, adding the key with
+  // a value-initialized Value first if it is absent, e.g.
+  // update(k, [](int &c) { c++; }) counts occurrences of k.
+  template <typename Fn> bool update(const Key &pKey, Fn pFn);
+  bool remove(const Key &pKey);
   void show_all() const;
+  // bytes of the nodes in use
+  std::size_t get_memory_usage() const;
+  // the structural changes counted so far; all zero unless the tree is
+  // built with BPLUSTREE_STATS
+  const tree_events &get_events() const;
+  // walks every node to measure the shape of the tree
+  tree_stats get_stats() const;
+
+  // REMOVE_MERGE unless set otherwise
+  remove_policy get_remove_policy() const;
+  void set_remove_policy(remove_policy pPolicy);
+  // Runs the compaction pass of REMOVE_LAZY over every leaf at once, e.g.
+  // when the tree is idle or before switching to another policy.
+  void compact();
+
+  const_iterator begin() const;
+  const_iterator end() const;
+  // first record whose key is not less than pKey
+  const_iterator lower_bound(const Key &pKey) const;
+  // first record whose key is greater than pKey
+  const_iterator upper_bound(const Key &pKey) const;
+  // records with pLow <= key < pHigh
+  const_range range(const Key &pLow, const Key &pHigh) const;
+
+  // Order statistics, for Counted trees only, each in one walk down.
+  //
+  // records whose key is less than pKey
+  std::size_t rank(const Key &pKey) const;
+  // the record at index pIndex in key order, or end() if there are not
+  // that many
+  const_iterator select(std::size_t pIndex) const;
+  // records with pLow <= key < pHigh, the bounds range() takes
+  std::size_t count(const Key &pLow, const Key &pHigh) const;
+
+  // Replaces the contents of the tree with the records in [pBegin, pEnd),
+  // which must be sorted by strictly increasing key. Nodes are packed to
+  // pFillFactor of MAX_THRESHOLD (clamped to [0.5, 1]) and built bottom-up
+  // in one pass. Returns false and leaves the tree untouched if the input
+  // is unsorted or holds duplicate keys.
+  template <typename ForwardIt>
+  bool bulk_load(ForwardIt pBegin, ForwardIt pEnd, double pFillFactor = 1.0);
+  // bulk_load for unsorted input on pThreads threads (0: one per hardware
+  // thread). [pBegin, pEnd) is sorted in place, then each thread fills a
+  // run of leaves from its own node pools and the runs are chained
+  // together. Returns false and leaves the tree untouched if two records
+  // share a key.
+  template <typename RandomIt>
+  bool parallel_bulk_load(RandomIt pBegin, RandomIt pEnd, unsigned pThreads,
+                          double pFillFactor = 1.0);
+  // Inserts pCount records in any order on pThreads threads (0: one per
+  // hardware thread). The records are partitioned by the separators of one
+  // tree level into disjoint subtrees, every thread inserts into its own
+  // subtrees and the splits that reach above them are applied afterwards.
+  void insert_batch(const record_type *pRecords, std::size_t pCount,
+                    unsigned pThreads);
+
+  // Streams every record into pPath in the compact block format of
+  // tree_dump.hpp. The dump is written to pPath + ".tmp" and renamed over
+  // pPath once complete. False if the file cannot be written, which leaves
+  // an earlier dump at pPath intact.
+  bool save(const std::string &pPath) const;
+  // Replaces the contents of the tree with those of a file written by
+  // save(), decoding it straight into a bottom-up build. Unlike bulk_load
+  // it takes equal keys, in the order they were saved in. Returns false
+  // and leaves the tree untouched if the file is missing, damaged or was
+  // written for other key or value types.
+  bool load(const std::string &pPath);
 
 private:
-  std::shared_ptr<node> mRoot;
+  typedef node<traits> node_type;
+  typedef leaf_node<traits> leaf_type;
+  typedef inner_node<traits> inner_type;
+  typedef link<traits> link_type;
+
+  // splits, append splits included, leave two children or more in both
+  // halves of an inner node, so each level takes twice the splits of the
+  // one below it to grow and 64 levels more records than can be counted
+  static constexpr int MAX_HEIGHT = 64;
+  // lookups that search_batch keeps in flight together
+  static constexpr std::size_t BATCH_GROUP = 16;
+  // leaves a finger steps over before walking down from the root
+  static constexpr int FINGER_STEPS = 1;
+  // under REMOVE_LAZY the compaction pass looks at one more leaf every
+  // COMPACT_INTERVAL removes
+  static constexpr std::size_t COMPACT_INTERVAL = 4;
+
+  static int get_fill_count(double pFillFactor);
+  // the key_separator between pLeaf and the leaf before it, if any
+  static Key get_separator(const leaf_type *pLeaf);
+  template <typename InputIt>
+  node_type *build(InputIt pFirst, std::size_t pCount, double pFillFactor,
+                   bool pDuplicates);
+  node_type *build_inner_levels(std::vector<link_type> &pLevel,
+                                int pFillCount);
+  link_type split_node(node_type *pNode, bool pAppend,
+                       node_pool<leaf_type> &pLeaves,
+                       node_pool<inner_type> &pInners, tree_events &pEvents);
+  void split_upwards(inner_type **pPath, const int *pSlots, int pLevel,
+                     node_type *pNode, bool pAppend);
+  void merge_upwards(inner_type **pPath, const int *pSlots,
+                     remove_policy pPolicy);
+  // merges child pSlot of pParent into a sibling, or evens the two out;
+  // true if it was merged
+  bool rebalance(inner_type *pParent, int pSlot, remove_policy pPolicy);
+  void merge(inner_type *pParent, int pLeftSlot);
+  void redistribute(inner_type *pParent, int pLeftSlot);
+  // advances the compaction pass by pCount leaves
+  void compact_leaves(std::size_t pCount);
+  void destroy_node(node_type *pNode);
+  void destroy_tree(node_type *pRoot);
+  // makes pRoot the root, finds the height and last leaf below it and, if
+  // Counted, counts the records below every child
+  void set_root(node_type *pRoot);
+  static int get_height(const node_type *pRoot);
+  // records below pNode, from the counts of its children
+  static std::size_t get_count(const node_type *pNode);
+  // sets the count of every child below pNode and returns its records
+  static std::size_t recount(node_type *pNode);
+  // adds pDelta to the count of every child on the path to a leaf
+  void add_count(inner_type **pPath, const int *pSlots, std::ptrdiff_t pDelta);
+  void collect_stats(const node_type *pNode, int pLevel,
+                     tree_stats &pStats) const;
+  // Adds pKey with pValue at index pIndex of pLeaf, the leaf that pPath
+  // and pSlots lead to, and splits what overflows.
+  void insert_at(leaf_type *pLeaf, int pIndex, inner_type **pPath,
+                 const int *pSlots, const Key &pKey, Value &&pValue);
+  // true if pKey is greater than every key of mLastLeaf, which has room
+  // for one more record
+  bool is_append(const Key &pKey) const;
+  leaf_type *find_leaf(const Key &pKey) const;
+  // The leaf of the lower_bound of pKey, as find_lower_leaf finds it, from
+  // pLeaf if it is near enough, else by walking down.
+  const leaf_type *find_leaf_near(const Key &pKey,
+                                  const leaf_type *pLeaf) const;
+  // the leaf of the first record equal to pKey, stepping back from pLeaf,
+  // which holds pKey, over the leaves before it
+  const leaf_type *find_first_of_equal(const Key &pKey,
+                                       const leaf_type *pLeaf) const;
+  // The leaf of the lower_bound of pKey, or the one before it if the
+  // lower_bound starts the next leaf. Unlike find_leaf it keeps left of
+  // separators equal to pKey.
+  const leaf_type *find_lower_leaf(const Key &pKey) const;
+  // true if pKey goes into pLeaf, which must not be empty
+  bool covers(const leaf_type *pLeaf, const Key &pKey) const;
+  // Walks down to the leaf of pKey, storing the inner nodes on the way and
+  // the child slots taken in them from the root down.
+  leaf_type *find_leaf(const Key &pKey, inner_type **pPath,
+                       int *pSlots) const;
+
+  node_type *mRoot;
+  // inner levels above the leaves
+  int mHeight;
+  // the rightmost leaf, where appends go
+  leaf_type *mLastLeaf;
+  remove_policy mRemovePolicy;
+  // the compaction pass goes on at the leaf of mCompactKey, or at the
+  // first leaf if mCompactHasKey is false
+  Key mCompactKey;
+  bool mCompactHasKey;
+  // removes done under REMOVE_LAZY
+  std::size_t mLazyRemoves;
+  tree_events mEvents;
+  node_pool<leaf_type> mLeaves;
+  node_pool<inner_type> mInners;
 };
+
+} // namespace bpt
+
+#include "bplustree_impl.hpp"
+
+#endif
@@ -0,0 +1,1847 @@
+#ifndef BPLUSTREE_IMPL_HPP
+#define BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+namespace bpt {
+
+// record class ///////////////////////////////////////////////////////////////
+
+template <typename Key, typename Value>
+record<Key, Value>::record(const Key &pKey, const Value &pValue)
+    : mKey(pKey), mValue(pValue) {}
+
+template <typename Key, typename Value>
+record<Key, Value>::record(const record &pRecord)
+    : mKey(pRecord.mKey), mValue(pRecord.mValue) {}
+
+template <typename Key, typename Value>
+record<Key, Value> &record<Key, Value>::operator=(const record &pRecord) {
+  if (&pRecord != this) {
+    mKey = pRecord.mKey;
+    mValue = pRecord.mValue;
+  }
+  return *this;
+}
+
+template <typename Key, typename Value>
+const Key &record<Key, Value>::get_key() const {
+  return mKey;
+}
+
+template <typename Key, typename Value>
+const Value &record<Key, Value>::get_value() const {
+  return mValue;
+}
+
+// link class /////////////////////////////////////////////////////////////////
+
+template <typename Traits>
+link<Traits>::link(const key_type &pKey) : mKey(pKey), mID(nullptr) {}
+
+template <typename Traits>
+link<Traits>::link(const key_type &pKey, node<Traits> *pNode)
+    : mKey(pKey), mID(pNode) {}
+
+template <typename Traits>
+link<Traits>::link(const link &pLink) : mKey(pLink.mKey), mID(pLink.mID) {}
+
+template <typename Traits>
+link<Traits> &link<Traits>::operator=(const link &pLink) {
+  if (&pLink != this) {
+    mKey = pLink.mKey;
+    mID = pLink.mID;
+  }
+  return *this;
+}
+
+template <typename Traits> void link<Traits>::set_key(const key_type &pKey) {
+  mKey = pKey;
+}
+
+template <typename Traits>
+const typename link<Traits>::key_type &link<Traits>::get_key() const {
+  return mKey;
+}
+
+template <typename Traits> node<Traits> *link<Traits>::get_node() const {
+  return mID;
+}
+
+// node class /////////////////////////////////////////////////////////////////
+template <typename Traits>
+node<Traits>::node(bool pIsLeaf)
+    : mIsLeaf(pIsLeaf), mSize(0), mPrev(nullptr), mNext(nullptr), mKeys() {}
+
+template <typename Traits> bool node<Traits>::is_leaf() const {
+  return mIsLeaf;
+}
+
+template <typename Traits> int node<Traits>::get_size() const { return mSize; }
+
+template <typename Traits> bool node<Traits>::is_too_big() const {
+  return mSize > Traits::MAX_THRESHOLD;
+}
+
+template <typename Traits> bool node<Traits>::is_too_small() const {
+  return mSize < Traits::MIN_THRESHOLD;
+}
+
+template <typename Traits>
+const typename node<Traits>::key_type &node<Traits>::get_key(int pIndex) const {
+  return mKeys[pIndex];
+}
+
+// index of the first key not less than pKey
+template <typename Traits>
+int node<Traits>::lower_bound(const key_type &pKey) const {
+  return Traits::search_policy::lower_bound(mKeys, mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+// index of the first key greater than pKey
+template <typename Traits>
+int node<Traits>::upper_bound(const key_type &pKey) const {
+  return Traits::search_policy::upper_bound(mKeys, mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+template <typename Traits> void node<Traits>::set_prev(node *pPrev) {
+  mPrev = pPrev;
+}
+
+template <typename Traits> node<Traits> *node<Traits>::get_prev() const {
+  return mPrev;
+}
+
+template <typename Traits> void node<Traits>::set_next(node *pNext) {
+  mNext = pNext;
+}
+
+template <typename Traits> node<Traits> *node<Traits>::get_next() const {
+  return mNext;
+}
+
+// leaf_node class ////////////////////////////////////////////////////////////
+template <typename Traits>
+leaf_node<Traits>::leaf_node() : node<Traits>(true) {}
+
+template <typename Traits>
+const typename leaf_node<Traits>::value_type &
+leaf_node<Traits>::get_value(int pIndex) const {
+  return mValues[pIndex];
+}
+
+template <typename Traits>
+void leaf_node<Traits>::add_record(const record_type &pRecord) {
+  insert_at(this->upper_bound(pRecord.get_key()), pRecord.get_key(),
+            value_type(pRecord.get_value()));
+}
+
+template <typename Traits>
+void leaf_node<Traits>::remove_record(const key_type &pKey) {
+  int first = this->lower_bound(pKey);
+  int last = this->upper_bound(pKey);
+  std::move(this->mKeys + last, this->mKeys + this->mSize, this->mKeys + first);
+  std::move(mValues + last, mValues + this->mSize, mValues + first);
+  this->mSize -= last - first;
+}
+
+template <typename Traits>
+const typename leaf_node<Traits>::value_type *
+leaf_node<Traits>::search(const key_type &pKey) const {
+  int pos = this->lower_bound(pKey);
+  if (pos == this->mSize || Traits::less(pKey, this->mKeys[pos])) {
+    return nullptr;
+  } else {
+    return &mValues[pos];
+  }
+}
+
+template <typename Traits>
+int leaf_node<Traits>::find(const key_type &pKey, bool &pFound) const {
+  int pos = this->lower_bound(pKey);
+  pFound = pos < this->mSize && !Traits::less(pKey, this->mKeys[pos]);
+  return pos;
+}
+
+template <typename Traits>
+void leaf_node<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                  value_type &&pValue) {
+  std::move_backward(this->mKeys + pIndex, this->mKeys + this->mSize,
+                     this->mKeys + this->mSize + 1);
+  std::move_backward(mValues + pIndex, mValues + this->mSize,
+                     mValues + this->mSize + 1);
+  this->mKeys[pIndex] = pKey;
+  mValues[pIndex] = std::move(pValue);
+  this->mSize++;
+}
+
+// move the records from pFrom onwards into the empty node pNew
+template <typename Traits>
+void leaf_node<Traits>::split_into(leaf_node *pNew, int pFrom) {
+  std::move(this->mKeys + pFrom, this->mKeys + this->mSize, pNew->mKeys);
+  std::move(mValues + pFrom, mValues + this->mSize, pNew->mValues);
+  pNew->mSize = this->mSize - pFrom;
+  this->mSize = pFrom;
+}
+
+// append the records of the right sibling pRight
+template <typename Traits>
+void leaf_node<Traits>::merge_from(leaf_node *pRight) {
+  std::move(pRight->mKeys, pRight->mKeys + pRight->mSize,
+            this->mKeys + this->mSize);
+  std::move(pRight->mValues, pRight->mValues + pRight->mSize,
+            mValues + this->mSize);
+  this->mSize += pRight->mSize;
+  pRight->mSize = 0;
+}
+
+// move records across until this node and its right sibling pRight hold
+// the same number
+template <typename Traits>
+void leaf_node<Traits>::redistribute(leaf_node *pRight) {
+  int size = this->mSize, rsize = pRight->mSize;
+  int target = (size + rsize) / 2;
+  if (size < target) {
+    // pull the first records of pRight over
+    int count = target - size;
+    std::move(pRight->mKeys, pRight->mKeys + count, this->mKeys + size);
+    std::move(pRight->mValues, pRight->mValues + count, mValues + size);
+    std::move(pRight->mKeys + count, pRight->mKeys + rsize, pRight->mKeys);
+    std::move(pRight->mValues + count, pRight->mValues + rsize,
+              pRight->mValues);
+    pRight->mSize = rsize - count;
+  } else if (size > target) {
+    // push our last records in front of those of pRight
+    int count = size - target;
+    std::move_backward(pRight->mKeys, pRight->mKeys + rsize,
+                       pRight->mKeys + rsize + count);
+    std::move_backward(pRight->mValues, pRight->mValues + rsize,
+                       pRight->mValues + rsize + count);
+    std::move(this->mKeys + target, this->mKeys + size, pRight->mKeys);
+    std::move(mValues + target, mValues + size, pRight->mValues);
+    pRight->mSize = rsize + count;
+  }
+  this->mSize = target;
+}
+
+// inner_node class ///////////////////////////////////////////////////////////
+template <typename Traits>
+inner_node<Traits>::inner_node() : node<Traits>(false) {
+  mChildren[0] = nullptr;
+}
+
+template <typename Traits>
+inner_node<Traits>::inner_node(node<Traits> *pHeir) : node<Traits>(false) {
+  mChildren[0] = pHeir;
+}
+
+template <typename Traits> node<Traits> *inner_node<Traits>::get_heir() const {
+  return mChildren[0].mNode;
+}
+
+template <typename Traits>
+node<Traits> *inner_node<Traits>::get_child(int pIndex) const {
+  return mChildren[pIndex].mNode;
+}
+
+template <typename Traits>
+void inner_node<Traits>::add_link(const link<Traits> &pLink) {
+  insert_at(this->upper_bound(pLink.get_key()), pLink);
+}
+
+template <typename Traits>
+void inner_node<Traits>::remove_link(const key_type &pKey) {
+  int first = this->lower_bound(pKey);
+  int last = this->upper_bound(pKey);
+  std::move(this->mKeys + last, this->mKeys + this->mSize, this->mKeys + first);
+  std::copy(mChildren + last + 1, mChildren + this->mSize + 1,
+            mChildren + first + 1);
+  this->mSize -= last - first;
+}
+
+// put the key of pLink at pIndex and its node to the right of it
+template <typename Traits>
+void inner_node<Traits>::insert_at(int pIndex, const link<Traits> &pLink) {
+  std::move_backward(this->mKeys + pIndex, this->mKeys + this->mSize,
+                     this->mKeys + this->mSize + 1);
+  std::copy_backward(mChildren + pIndex + 1, mChildren + this->mSize + 1,
+                     mChildren + this->mSize + 2);
+  this->mKeys[pIndex] = pLink.get_key();
+  mChildren[pIndex + 1] = pLink.get_node();
+  this->mSize++;
+}
+
+// drop key pIndex together with the child to its right
+template <typename Traits> void inner_node<Traits>::erase(int pIndex) {
+  std::move(this->mKeys + pIndex + 1, this->mKeys + this->mSize,
+            this->mKeys + pIndex);
+  std::copy(mChildren + pIndex + 2, mChildren + this->mSize + 1,
+            mChildren + pIndex + 1);
+  this->mSize--;
+}
+
+// move the links from pFrom onwards into the empty node pNew; the child of
+// link pFrom becomes the heir of pNew and its key is pushed up to the parent
+template <typename Traits>
+void inner_node<Traits>::split_into(inner_node *pNew, int pFrom) {
+  std::move(this->mKeys + pFrom + 1, this->mKeys + this->mSize, pNew->mKeys);
+  std::copy(mChildren + pFrom + 1, mChildren + this->mSize + 1,
+            pNew->mChildren);
+  pNew->mSize = this->mSize - pFrom - 1;
+  this->mSize = pFrom;
+}
+
+// Appends the links of the right sibling pRight. The heir of pRight turns
+// into one more link under pSeparator, the key that separated the two in
+// the parent.
+template <typename Traits>
+void inner_node<Traits>::merge_from(inner_node *pRight,
+                                    const key_type &pSeparator) {
+  int size = this->mSize;
+  this->mKeys[size] = pSeparator;
+  std::move(pRight->mKeys, pRight->mKeys + pRight->mSize,
+            this->mKeys + size + 1);
+  std::copy(pRight->mChildren, pRight->mChildren + pRight->mSize + 1,
+            mChildren + size + 1);
+  this->mSize += pRight->mSize + 1;
+  pRight->mSize = 0;
+}
+
+// Evens out the links of this node and its right sibling pRight, which
+// pSeparator separates in the parent. The separator comes down between the
+// two key runs and the key that ends up in the middle is returned to take
+// its place.
+template <typename Traits>
+typename inner_node<Traits>::key_type
+inner_node<Traits>::redistribute(inner_node *pRight,
+                                 const key_type &pSeparator) {
+  int size = this->mSize, rsize = pRight->mSize;
+  int target = (size + 1 + rsize) / 2;
+  key_type separator = pSeparator;
+  if (size < target) {
+    int count = target - size;
+    this->mKeys[size] = pSeparator;
+    std::move(pRight->mKeys, pRight->mKeys + count - 1,
+              this->mKeys + size + 1);
+    std::copy(pRight->mChildren, pRight->mChildren + count,
+              mChildren + size + 1);
+    separator = std::move(pRight->mKeys[count - 1]);
+    std::move(pRight->mKeys + count, pRight->mKeys + rsize, pRight->mKeys);
+    std::copy(pRight->mChildren + count, pRight->mChildren + rsize + 1,
+              pRight->mChildren);
+    pRight->mSize = rsize - count;
+  } else if (size > target) {
+    int count = size - target;
+    std::move_backward(pRight->mKeys, pRight->mKeys + rsize,
+                       pRight->mKeys + rsize + count);
+    std::copy_backward(pRight->mChildren, pRight->mChildren + rsize + 1,
+                       pRight->mChildren + rsize + 1 + count);
+    std::move(this->mKeys + target + 1, this->mKeys + size, pRight->mKeys);
+    pRight->mKeys[count - 1] = pSeparator;
+    std::copy(mChildren + target + 1, mChildren + size + 1,
+              pRight->mChildren);
+    separator = std::move(this->mKeys[target]);
+    pRight->mSize = rsize + count;
+  }
+  this->mSize = target;
+  return separator;
+}
+
+template <typename Traits>
+node<Traits> *inner_node<Traits>::search(const key_type &pKey) const {
+  return mChildren[this->upper_bound(pKey)].mNode;
+}
+
+// tree_iterator class ////////////////////////////////////////////////////////
+template <typename Traits>
+tree_iterator<Traits>::tree_iterator() : mLeaf(nullptr), mIndex(0) {}
+
+template <typename Traits>
+tree_iterator<Traits>::tree_iterator(const leaf_node<Traits> *pLeaf,
+                                     int pIndex) {
+  enter(pLeaf, pIndex);
+  skip_forward();
+}
+
+template <typename Traits>
+const typename Traits::key_type &tree_iterator<Traits>::get_key() const {
+  return mLeaf->get_key(mIndex);
+}
+
+template <typename Traits>
+const typename Traits::value_type &tree_iterator<Traits>::get_value() const {
+  return mLeaf->get_value(mIndex);
+}
+
+template <typename Traits>
+typename tree_iterator<Traits>::reference
+tree_iterator<Traits>::operator*() const {
+  return value_type(get_key(), get_value());
+}
+
+template <typename Traits>
+tree_iterator<Traits> &tree_iterator<Traits>::operator++() {
+  mIndex++;
+  skip_forward();
+  return *this;
+}
+
+template <typename Traits>
+tree_iterator<Traits> tree_iterator<Traits>::operator++(int) {
+  tree_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+template <typename Traits>
+tree_iterator<Traits> &tree_iterator<Traits>::operator--() {
+  // step back over leaves that a remove left empty
+  while (mIndex == 0) {
+    const leaf_node<Traits> *prev =
+        static_cast<const leaf_node<Traits> *>(mLeaf->get_prev());
+    mLeaf = prev;
+    mIndex = prev->get_size();
+  }
+  mIndex--;
+  return *this;
+}
+
+template <typename Traits>
+tree_iterator<Traits> tree_iterator<Traits>::operator--(int) {
+  tree_iterator old = *this;
+  --*this;
+  return old;
+}
+
+template <typename Traits>
+bool tree_iterator<Traits>::operator==(const tree_iterator &pOther) const {
+  return mLeaf == pOther.mLeaf && mIndex == pOther.mIndex;
+}
+
+template <typename Traits>
+bool tree_iterator<Traits>::operator!=(const tree_iterator &pOther) const {
+  return !(*this == pOther);
+}
+
+template <typename Traits>
+void tree_iterator<Traits>::enter(const leaf_node<Traits> *pLeaf,
+                                  int pIndex) {
+  mLeaf = pLeaf;
+  mIndex = pIndex;
+  if (mLeaf->get_next()) {
+    prefetch_lines(static_cast<const leaf_node<Traits> *>(mLeaf->get_next()));
+  }
+}
+
+// move past the end of a leaf onto the first record of the next non-empty
+// leaf, or stop at the end position of the last leaf
+template <typename Traits> void tree_iterator<Traits>::skip_forward() {
+  while (mIndex == mLeaf->get_size() && mLeaf->get_next()) {
+    enter(static_cast<const leaf_node<Traits> *>(mLeaf->get_next()), 0);
+  }
+}
+
+// iterator_range class ///////////////////////////////////////////////////////
+template <typename Iterator>
+iterator_range<Iterator>::iterator_range(Iterator pBegin, Iterator pEnd)
+    : mBegin(pBegin), mEnd(pEnd) {}
+
+template <typename Iterator> Iterator iterator_range<Iterator>::begin() const {
+  return mBegin;
+}
+
+template <typename Iterator> Iterator iterator_range<Iterator>::end() const {
+  return mEnd;
+}
+
+template <typename Iterator> bool iterator_range<Iterator>::empty() const {
+  return mBegin == mEnd;
+}
+
+// bplustree class ////////////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::bplustree()
+    : mHeight(0), mRemovePolicy(REMOVE_MERGE), mCompactKey(),
+      mCompactHasKey(false), mLazyRemoves(0) {
+  set_root(mLeaves.create());
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::~bplustree() {
+  destroy_tree(mRoot);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::destroy_tree(
+    node_type *pRoot) {
+  // release every node level by level, walking each level through the
+  // sibling chain starting from its leftmost node
+  node_type *level = pRoot;
+  while (level) {
+    node_type *below = nullptr;
+    if (!level->is_leaf()) {
+      below = static_cast<inner_type *>(level)->get_heir();
+    }
+    while (level) {
+      node_type *next = level->get_next();
+      destroy_node(level);
+      level = next;
+    }
+    level = below;
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::destroy_node(
+    node_type *pNode) {
+  if (pNode->is_leaf()) {
+    mLeaves.destroy(static_cast<leaf_type *>(pNode));
+  } else {
+    mInners.destroy(static_cast<inner_type *>(pNode));
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const Value *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::search(
+    const Key &pKey) const {
+  return find_leaf(pKey)->search(pKey);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+Value *bplustree<Key, Value, Compare, Fanout, Search, Counted>::search(
+    const Key &pKey) {
+  return const_cast<Value *>(find_leaf(pKey)->search(pKey));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::search_batch(
+    const Key *pKeys, std::size_t pCount, const Value **pOut) const {
+  const node_type *cursors[BATCH_GROUP];
+  for (std::size_t first = 0; first < pCount; first += BATCH_GROUP) {
+    std::size_t group = std::min(BATCH_GROUP, pCount - first);
+    const Key *keys = pKeys + first;
+    for (std::size_t i = 0; i < group; i++) {
+      cursors[i] = mRoot;
+    }
+    // every leaf is at the same depth, so the group reaches them together
+    while (!cursors[0]->is_leaf()) {
+      for (std::size_t i = 0; i < group; i++) {
+        cursors[i] =
+            static_cast<const inner_type *>(cursors[i])->search(keys[i]);
+        prefetch_lines(cursors[i]);
+      }
+    }
+    for (std::size_t i = 0; i < group; i++) {
+      pOut[first + i] =
+          static_cast<const leaf_type *>(cursors[i])->search(keys[i]);
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::insert(
+    const record_type &pRecord) {
+  const Key &key = pRecord.get_key();
+  if (is_append(key)) {
+    mLastLeaf->insert_at(mLastLeaf->get_size(), key,
+                         Value(pRecord.get_value()));
+    return true;
+  }
+  // add record into the leaf, behind any records with the same key
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *ltemp = find_leaf(key, path, slots);
+  insert_at(ltemp, ltemp->upper_bound(key), path, slots, key,
+            Value(pRecord.get_value()));
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename V>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::insert_or_assign(
+    const Key &pKey, V &&pValue) {
+  if (is_append(pKey)) {
+    mLastLeaf->insert_at(mLastLeaf->get_size(), pKey,
+                         Value(std::forward<V>(pValue)));
+    return false;
+  }
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *ltemp = find_leaf(pKey, path, slots);
+  bool found;
+  int pos = ltemp->find(pKey, found);
+  if (found) {
+    ltemp->mValues[pos] = std::forward<V>(pValue);
+  } else {
+    insert_at(ltemp, pos, path, slots, pKey, Value(std::forward<V>(pValue)));
+  }
+  return found;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename... Args>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::try_emplace(
+    const Key &pKey, Args &&...pArgs) {
+  if (is_append(pKey)) {
+    mLastLeaf->insert_at(mLastLeaf->get_size(), pKey,
+                         Value(std::forward<Args>(pArgs)...));
+    return false;
+  }
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *ltemp = find_leaf(pKey, path, slots);
+  bool found;
+  int pos = ltemp->find(pKey, found);
+  if (!found) {
+    insert_at(ltemp, pos, path, slots, pKey,
+              Value(std::forward<Args>(pArgs)...));
+  }
+  return found;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename Fn>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::update(
+    const Key &pKey, Fn pFn) {
+  bool append = is_append(pKey);
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *ltemp = append ? mLastLeaf : find_leaf(pKey, path, slots);
+  bool found = false;
+  int pos = append ? ltemp->get_size() : ltemp->find(pKey, found);
+  if (found) {
+    pFn(ltemp->mValues[pos]);
+  } else {
+    // a split may move the new record, so it is updated before it goes in
+    Value value = Value();
+    pFn(value);
+    if (append) {
+      ltemp->insert_at(pos, pKey, std::move(value));
+    } else {
+      insert_at(ltemp, pos, path, slots, pKey, std::move(value));
+    }
+  }
+  return found;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::insert_at(
+    leaf_type *pLeaf, int pIndex, inner_type **pPath, const int *pSlots,
+    const Key &pKey, Value &&pValue) {
+  pLeaf->insert_at(pIndex, pKey, std::move(pValue));
+  add_count(pPath, pSlots, 1);
+  // a record added behind the last one of the last leaf is taken for an
+  // append
+  bool append = pLeaf == mLastLeaf && pIndex == pLeaf->get_size() - 1;
+  split_upwards(pPath, pSlots, mHeight - 1, pLeaf, append);
+}
+
+// Appends reach the last leaf without a walk down, as long as it has room,
+// except in Counted trees, whose counts on the path change as well.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::is_append(
+    const Key &pKey) const {
+  int size = mLastLeaf->get_size();
+  return !Counted && size > 0 && size < traits::MAX_THRESHOLD &&
+         traits::less(mLastLeaf->get_key(size - 1), pKey);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const Value *bplustree<Key, Value, Compare, Fanout, Search, Counted>::search(
+    const Key &pKey, const_iterator &pFinger) const {
+  const leaf_type *ltemp = find_leaf_near(pKey, pFinger.mLeaf);
+  // unlike const_iterator(ltemp, pos), no prefetch of the next leaf
+  pFinger.mLeaf = ltemp;
+  pFinger.mIndex = ltemp->lower_bound(pKey);
+  // the lower_bound may be the start of a later leaf
+  pFinger.skip_forward();
+  ltemp = pFinger.mLeaf;
+  int pos = pFinger.mIndex;
+  if (pos == ltemp->get_size() || traits::less(pKey, ltemp->get_key(pos))) {
+    return nullptr;
+  }
+  return &ltemp->get_value(pos);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::insert(
+    const record_type &pRecord, const_iterator &pFinger) {
+  const Key &key = pRecord.get_key();
+  leaf_type *ltemp = const_cast<leaf_type *>(pFinger.mLeaf);
+  // Counted trees need the path, so they always walk down
+  if (!Counted && ltemp && ltemp->get_size() > 0 &&
+      ltemp->get_size() < traits::MAX_THRESHOLD && covers(ltemp, key)) {
+    int pos = ltemp->upper_bound(key);
+    ltemp->insert_at(pos, key, Value(pRecord.get_value()));
+    pFinger = const_iterator(ltemp, pos);
+    return true;
+  }
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  ltemp = find_leaf(key, path, slots);
+  int pos = ltemp->upper_bound(key);
+  insert_at(ltemp, pos, path, slots, key, Value(pRecord.get_value()));
+  // a split leaves the first records in ltemp and moves the rest behind
+  if (pos >= ltemp->get_size()) {
+    pos -= ltemp->get_size();
+    ltemp = static_cast<leaf_type *>(ltemp->get_next());
+  }
+  pFinger = const_iterator(ltemp, pos);
+  return true;
+}
+
+// Splits pNode and then each ancestor that overflows in turn, growing a
+// new root if the old one splits. pPath and pSlots lead from the root down
+// to pNode, whose parent is pPath[pLevel]. With pAppend, pNode is the last
+// node of its level and overflowed by its last entry, and so are the
+// ancestors it splits in turn.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::split_upwards(
+    inner_type **pPath, const int *pSlots, int pLevel, node_type *pNode,
+    bool pAppend) {
+  node_type *temp = pNode;
+  for (int level = pLevel; temp->is_too_big(); level--) {
+    link_type l = split_node(temp, pAppend, mLeaves, mInners, mEvents);
+    if (temp == mLastLeaf) {
+      mLastLeaf = static_cast<leaf_type *>(l.get_node());
+    }
+    if (level >= 0) {
+      // if not root, the new node goes right behind the one split
+      pPath[level]->insert_at(pSlots[level], l);
+      if (Counted) {
+        pPath[level]->mChildren[pSlots[level]].set_count(get_count(temp));
+        pPath[level]->mChildren[pSlots[level] + 1].set_count(
+            get_count(l.get_node()));
+      }
+      // loop
+      temp = pPath[level];
+    } else {
+      // if root, grow a new root above the two halves
+      inner_type *iRoot = mInners.create(mRoot);
+      iRoot->insert_at(0, l);
+      if (Counted) {
+        iRoot->mChildren[0].set_count(get_count(mRoot));
+        iRoot->mChildren[1].set_count(get_count(l.get_node()));
+      }
+      mRoot = iRoot;
+      mHeight++;
+      mEvents.add(tree_events::ROOT_GROWTH);
+      // end loop
+      break;
+    }
+  }
+}
+
+// Moves the second half of an overfull node into a new right sibling taken
+// from the given pools and returns the link the parent needs for it. The
+// parent itself is left alone. An append split moves only the last record
+// of a leaf, or the last key and the two children around it of an inner
+// node, instead: keys that keep arriving in ascending order then leave
+// every node behind them full rather than half full.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::link_type
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::split_node(
+    node_type *pNode, bool pAppend, node_pool<leaf_type> &pLeaves,
+    node_pool<inner_type> &pInners, tree_events &pEvents) {
+  // 1. get size of the original node and where to cut it
+  // 2. get the separator of the two halves to create a link; a leaf may
+  //    post a shortened one, an inner node pushes the key at the cut up
+  int size = pNode->get_size();
+  // the key at the cut of an inner node goes up, so an inner append split
+  // cuts one key earlier to leave the new node a key of its own
+  int from = !pAppend ? size / 2 : pNode->is_leaf() ? size - 1 : size - 2;
+  Key linkKey = pNode->get_key(from);
+  if (pNode->is_leaf()) {
+    linkKey =
+        key_separator<Key, Compare>::make(pNode->get_key(from - 1), linkKey);
+  }
+
+  // 3. move the second half into a new node
+  node_type *n;
+  if (pNode->is_leaf()) {
+    leaf_type *lNew = pLeaves.create();
+    static_cast<leaf_type *>(pNode)->split_into(lNew, from);
+    n = lNew;
+    pEvents.add(tree_events::LEAF_SPLIT);
+  } else {
+    inner_type *iNew = pInners.create();
+    static_cast<inner_type *>(pNode)->split_into(iNew, from);
+    n = iNew;
+    pEvents.add(tree_events::INNER_SPLIT);
+  }
+  n->set_prev(pNode);
+  n->set_next(pNode->get_next());
+  if (pNode->get_next()) {
+    pNode->get_next()->set_prev(n);
+  }
+  pNode->set_next(n);
+  return link_type(linkKey, n);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::remove(
+    const Key &pKey) {
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+
+  // if key found in leaf, remove the record
+  leaf_type *ltemp = find_leaf(pKey, path, slots);
+  if (!ltemp->search(pKey)) {
+    // key not found in leaf
+    return false;
+  }
+  int size = ltemp->get_size();
+  ltemp->remove_record(pKey);
+  add_count(path, slots, ltemp->get_size() - size);
+
+  // An emptied leaf keeps its separator. Raising it to the first key of the
+  // next leaf could carry it past the separators of empty leaves that
+  // REMOVE_LAZY leaves in between.
+  if (ltemp->get_size() > 0 && traits::less(pKey, ltemp->get_key(0))) {
+    // the separator for this leaf sits in the lowest ancestor that does
+    // not reach it through its heir
+    for (int level = mHeight - 1; level >= 0; level--) {
+      if (slots[level] > 0) {
+        path[level]->mKeys[slots[level] - 1] = ltemp->get_key(0);
+        break;
+      }
+    }
+  }
+
+  if (mRemovePolicy == REMOVE_LAZY) {
+    if (++mLazyRemoves % COMPACT_INTERVAL == 0) {
+      compact_leaves(1);
+    }
+  } else {
+    merge_upwards(path, slots, mRemovePolicy);
+  }
+  return true;
+}
+
+// Rebalances the leaf at the end of pPath if it is too small and then each
+// ancestor that becomes too small in turn, dropping an inner root that is
+// left without links.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::merge_upwards(
+    inner_type **pPath, const int *pSlots, remove_policy pPolicy) {
+  for (int level = mHeight - 1; level >= 0; level--) {
+    inner_type *iParent = pPath[level];
+    if (!iParent->get_child(pSlots[level])->is_too_small() ||
+        !rebalance(iParent, pSlots[level], pPolicy)) {
+      break;
+    }
+  }
+  // if root is an inner node without links, make heir as root
+  if (!mRoot->is_leaf() && mRoot->get_size() == 0) {
+    inner_type *oldRoot = static_cast<inner_type *>(mRoot);
+    mRoot = oldRoot->get_heir();
+    mHeight--;
+    mInners.destroy(oldRoot);
+    mEvents.add(tree_events::ROOT_SHRINK);
+  }
+}
+
+// A node is merged with its left sibling if the two fit into one node, else
+// with its right one. If neither fits, REMOVE_REDISTRIBUTE evens it out with
+// the fuller sibling and the other policies leave it as it is.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::rebalance(
+    inner_type *pParent, int pSlot, remove_policy pPolicy) {
+  node_type *temp = pParent->get_child(pSlot);
+  // merging inner nodes brings the separator down as one more link
+  int size = temp->get_size() + (temp->is_leaf() ? 0 : 1);
+  int prevSize = pSlot > 0 ? pParent->get_child(pSlot - 1)->get_size() : -1;
+  int nextSize = pSlot < pParent->get_size()
+                     ? pParent->get_child(pSlot + 1)->get_size()
+                     : -1;
+  if (prevSize >= 0 && prevSize + size <= traits::MAX_THRESHOLD) {
+    merge(pParent, pSlot - 1);
+    return true;
+  }
+  if (nextSize >= 0 && nextSize + size <= traits::MAX_THRESHOLD) {
+    merge(pParent, pSlot);
+    return true;
+  }
+  if (pPolicy == REMOVE_REDISTRIBUTE && (prevSize >= 0 || nextSize >= 0)) {
+    redistribute(pParent, prevSize > nextSize ? pSlot - 1 : pSlot);
+  } else {
+    mEvents.add(tree_events::FAILED_REBALANCE);
+  }
+  return false;
+}
+
+// merges child pLeftSlot + 1 of pParent into child pLeftSlot, which keeps
+// its separator
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::merge(
+    inner_type *pParent, int pLeftSlot) {
+  node_type *left = pParent->get_child(pLeftSlot);
+  node_type *right = pParent->get_child(pLeftSlot + 1);
+  if (left->is_leaf()) {
+    static_cast<leaf_type *>(left)->merge_from(
+        static_cast<leaf_type *>(right));
+    mEvents.add(tree_events::LEAF_MERGE);
+  } else {
+    static_cast<inner_type *>(left)->merge_from(
+        static_cast<inner_type *>(right), pParent->get_key(pLeftSlot));
+    mEvents.add(tree_events::INNER_MERGE);
+  }
+  left->set_next(right->get_next());
+  if (right->get_next()) {
+    right->get_next()->set_prev(left);
+  }
+  pParent->mChildren[pLeftSlot].add_count(
+      pParent->mChildren[pLeftSlot + 1].get_count());
+  pParent->erase(pLeftSlot);
+  if (right == mLastLeaf) {
+    mLastLeaf = static_cast<leaf_type *>(left);
+  }
+  // the merged node has been unlinked, recycle it
+  destroy_node(right);
+}
+
+// evens out children pLeftSlot and pLeftSlot + 1 of pParent and updates
+// the separator between them
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::redistribute(
+    inner_type *pParent, int pLeftSlot) {
+  node_type *left = pParent->get_child(pLeftSlot);
+  node_type *right = pParent->get_child(pLeftSlot + 1);
+  mEvents.add(tree_events::REDISTRIBUTION);
+  if (left->is_leaf()) {
+    static_cast<leaf_type *>(left)->redistribute(
+        static_cast<leaf_type *>(right));
+    pParent->mKeys[pLeftSlot] = key_separator<Key, Compare>::make(
+        left->get_key(left->get_size() - 1), right->get_key(0));
+  } else {
+    pParent->mKeys[pLeftSlot] = static_cast<inner_type *>(left)->redistribute(
+        static_cast<inner_type *>(right), pParent->get_key(pLeftSlot));
+  }
+  if (Counted) {
+    pParent->mChildren[pLeftSlot].set_count(get_count(left));
+    pParent->mChildren[pLeftSlot + 1].set_count(get_count(right));
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+remove_policy
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_remove_policy()
+    const {
+  return mRemovePolicy;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::set_remove_policy(
+    remove_policy pPolicy) {
+  mRemovePolicy = pPolicy;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::compact() {
+  mCompactHasKey = false;
+  do {
+    compact_leaves(1);
+  } while (mCompactHasKey);
+}
+
+// The pass visits the leaves from left to right and round again,
+// rebalancing each leaf it finds too small the way REMOVE_REDISTRIBUTE
+// would have on its last remove. It keeps its place as a key rather than a
+// leaf, which a merge may free: the separator behind the leaf just visited
+// leads to the next one, and so does any key behind it in that leaf's range
+// once the separators have moved.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::compact_leaves(
+    std::size_t pCount) {
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  for (; pCount > 0; pCount--) {
+    node_type *temp = mRoot;
+    for (int level = 0; level < mHeight; level++) {
+      inner_type *inner = static_cast<inner_type *>(temp);
+      path[level] = inner;
+      slots[level] = mCompactHasKey ? inner->upper_bound(mCompactKey) : 0;
+      temp = inner->get_child(slots[level]);
+    }
+    // the separator behind this leaf sits in the lowest ancestor that does
+    // not reach it through its last child; past the last leaf start over
+    mCompactHasKey = false;
+    for (int level = mHeight - 1; level >= 0; level--) {
+      if (slots[level] < path[level]->get_size()) {
+        mCompactKey = path[level]->get_key(slots[level]);
+        mCompactHasKey = true;
+        break;
+      }
+    }
+    merge_upwards(path, slots, REMOVE_REDISTRIBUTE);
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::show_all() const {
+  node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    temp = static_cast<inner_type *>(temp)->get_heir();
+  }
+  leaf_type *ltemp = static_cast<leaf_type *>(temp);
+  while (true) {
+    for (int i = 0; i < ltemp->get_size(); i++) {
+      std::cout << "[key: " << ltemp->get_key(i)
+                << ", value: " << ltemp->get_value(i) << "]";
+    }
+    std::cout << std::endl;
+    if (ltemp->get_next()) {
+      ltemp = static_cast<leaf_type *>(ltemp->get_next());
+    } else {
+      break;
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+std::size_t
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_memory_usage()
+    const {
+  return mLeaves.get_live_count() * sizeof(leaf_type) +
+         mInners.get_live_count() * sizeof(inner_type);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const tree_events &
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_events() const {
+  return mEvents;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+tree_stats
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_stats() const {
+  tree_stats stats = tree_stats();
+  stats.mHeight = mHeight;
+  stats.mLevelNodes.assign(mHeight + 1, 0);
+  stats.mLeafOccupancy.assign(node_type::CAPACITY + 1, 0);
+  stats.mInnerOccupancy.assign(node_type::CAPACITY + 1, 0);
+  collect_stats(mRoot, 0, stats);
+  std::size_t leaves = stats.mLevelNodes[mHeight];
+  stats.mLeafFill = double(stats.mRecords) / (leaves * traits::MAX_THRESHOLD);
+  stats.mNodeBytes = get_memory_usage();
+  stats.mReservedBytes =
+      mLeaves.get_reserved_bytes() + mInners.get_reserved_bytes();
+  stats.mEvents = mEvents;
+  return stats;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::collect_stats(
+    const node_type *pNode, int pLevel, tree_stats &pStats) const {
+  pStats.mLevelNodes[pLevel]++;
+  if (pNode->is_leaf()) {
+    pStats.mLeafOccupancy[pNode->get_size()]++;
+    pStats.mRecords += pNode->get_size();
+    return;
+  }
+  pStats.mInnerOccupancy[pNode->get_size()]++;
+  const inner_type *inner = static_cast<const inner_type *>(pNode);
+  for (int i = 0; i <= inner->get_size(); i++) {
+    collect_stats(inner->get_child(i), pLevel + 1, pStats);
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::leaf_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::find_leaf(
+    const Key &pKey) const {
+  node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    temp = static_cast<inner_type *>(temp)->search(pKey);
+  }
+  return static_cast<leaf_type *>(temp);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::leaf_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::find_leaf(
+    const Key &pKey, inner_type **pPath, int *pSlots) const {
+  node_type *temp = mRoot;
+  for (int level = 0; level < mHeight; level++) {
+    inner_type *inner = static_cast<inner_type *>(temp);
+    pPath[level] = inner;
+    pSlots[level] = inner->upper_bound(pKey);
+    temp = inner->get_child(pSlots[level]);
+  }
+  return static_cast<leaf_type *>(temp);
+}
+
+// Leaves hold their keys in ascending order along the chain, so pKey
+// falls into a leaf whose keys reach around it, or into the gap between
+// two neighbours, where the lower_bound is the end of the left one. A
+// neighbour is only looked at while steps are left, as reading it likely
+// costs a cache miss.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const typename bplustree<Key, Value, Compare, Fanout, Search,
+                         Counted>::leaf_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::find_leaf_near(
+    const Key &pKey, const leaf_type *pLeaf) const {
+  const leaf_type *ltemp = pLeaf;
+  for (int step = 0; ltemp && ltemp->get_size() > 0; step++) {
+    // REMOVE_LAZY leaves empty leaves behind, which bound nothing
+    int size = ltemp->get_size();
+    bool before = traits::less(pKey, ltemp->get_key(0));
+    if (!before && !traits::less(ltemp->get_key(size - 1), pKey)) {
+      return find_first_of_equal(pKey, ltemp);
+    }
+    const leaf_type *next = static_cast<const leaf_type *>(
+        before ? ltemp->get_prev() : ltemp->get_next());
+    if (!next) {
+      // nothing lies beyond the first or the last leaf
+      return ltemp;
+    }
+    if (step == FINGER_STEPS || next->get_size() == 0) {
+      break;
+    }
+    // in the gap between the two, the lower_bound is the start of the
+    // right one
+    if (before && traits::less(next->get_key(next->get_size() - 1), pKey)) {
+      return ltemp;
+    }
+    if (!before && traits::less(pKey, next->get_key(0))) {
+      return next;
+    }
+    ltemp = next;
+  }
+  return find_lower_leaf(pKey);
+}
+
+// Records equal to pKey may run back over several leaves, all of which are
+// walked, as an iterator from the lower_bound would walk them anyway.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const typename bplustree<Key, Value, Compare, Fanout, Search,
+                         Counted>::leaf_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::find_first_of_equal(
+    const Key &pKey, const leaf_type *pLeaf) const {
+  const leaf_type *ltemp = pLeaf;
+  while (!traits::less(ltemp->get_key(0), pKey)) {
+    const leaf_type *prev = static_cast<const leaf_type *>(ltemp->get_prev());
+    if (!prev || (prev->get_size() > 0 &&
+                  traits::less(prev->get_key(prev->get_size() - 1), pKey))) {
+      return ltemp;
+    }
+    if (prev->get_size() == 0) {
+      // an empty leaf of REMOVE_LAZY hides what lies before it
+      return find_lower_leaf(pKey);
+    }
+    ltemp = prev;
+  }
+  return ltemp;
+}
+
+// Records equal to pKey may also sit left of a separator equal to it, so
+// the walk down keeps left of the first separator not less than pKey, as
+// in rank().
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+const typename bplustree<Key, Value, Compare, Fanout, Search,
+                         Counted>::leaf_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::find_lower_leaf(
+    const Key &pKey) const {
+  const node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    const inner_type *inner = static_cast<const inner_type *>(temp);
+    temp = inner->get_child(inner->lower_bound(pKey));
+  }
+  return static_cast<const leaf_type *>(temp);
+}
+
+// A key between the first and the last key of a leaf goes into it, and so
+// does any key before the first leaf or behind the last one. Keys in a gap
+// between two leaves go to one side of the separator between them, which
+// only the parent knows. A key equal to the last one goes behind every
+// equal key, so it only stays if the next leaf starts with a greater one.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::covers(
+    const leaf_type *pLeaf, const Key &pKey) const {
+  if (pLeaf->get_prev() && traits::less(pKey, pLeaf->get_key(0))) {
+    return false;
+  }
+  const Key &last = pLeaf->get_key(pLeaf->get_size() - 1);
+  const leaf_type *next = static_cast<const leaf_type *>(pLeaf->get_next());
+  if (!next || traits::less(pKey, last)) {
+    return true;
+  }
+  return !traits::less(last, pKey) && next->get_size() > 0 &&
+         traits::less(pKey, next->get_key(0));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::set_root(
+    node_type *pRoot) {
+  mRoot = pRoot;
+  mHeight = 0;
+  node_type *temp = pRoot;
+  while (!temp->is_leaf()) {
+    inner_type *inner = static_cast<inner_type *>(temp);
+    temp = inner->get_child(inner->get_size());
+    mHeight++;
+  }
+  mLastLeaf = static_cast<leaf_type *>(temp);
+  if (Counted) {
+    recount(pRoot);
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+int bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_height(
+    const node_type *pRoot) {
+  int height = 0;
+  for (const node_type *n = pRoot; !n->is_leaf();
+       n = static_cast<const inner_type *>(n)->get_heir()) {
+    height++;
+  }
+  return height;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+std::size_t
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_count(
+    const node_type *pNode) {
+  if (pNode->is_leaf()) {
+    return pNode->get_size();
+  }
+  const inner_type *inner = static_cast<const inner_type *>(pNode);
+  std::size_t count = 0;
+  for (int i = 0; i <= inner->get_size(); i++) {
+    count += inner->mChildren[i].get_count();
+  }
+  return count;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+std::size_t
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::recount(
+    node_type *pNode) {
+  if (pNode->is_leaf()) {
+    return pNode->get_size();
+  }
+  inner_type *inner = static_cast<inner_type *>(pNode);
+  std::size_t count = 0;
+  for (int i = 0; i <= inner->get_size(); i++) {
+    inner->mChildren[i].set_count(recount(inner->get_child(i)));
+    count += inner->mChildren[i].get_count();
+  }
+  return count;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::add_count(
+    inner_type **pPath, const int *pSlots, std::ptrdiff_t pDelta) {
+  if (Counted) {
+    for (int level = 0; level < mHeight; level++) {
+      pPath[level]->mChildren[pSlots[level]].add_count(pDelta);
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_iterator
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::begin() const {
+  node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    temp = static_cast<inner_type *>(temp)->get_heir();
+  }
+  return const_iterator(static_cast<leaf_type *>(temp), 0);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_iterator
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::end() const {
+  node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    temp = static_cast<inner_type *>(temp)->get_child(temp->get_size());
+  }
+  return const_iterator(static_cast<leaf_type *>(temp), temp->get_size());
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_iterator
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::lower_bound(
+    const Key &pKey) const {
+  // the iterator steps on if the leaf holds nothing from pKey
+  const leaf_type *ltemp = find_lower_leaf(pKey);
+  return const_iterator(ltemp, ltemp->lower_bound(pKey));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_iterator
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::upper_bound(
+    const Key &pKey) const {
+  leaf_type *ltemp = find_leaf(pKey);
+  return const_iterator(ltemp, ltemp->upper_bound(pKey));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_range
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::range(
+    const Key &pLow, const Key &pHigh) const {
+  const_iterator first = lower_bound(pLow);
+  if (!traits::less(pLow, pHigh)) {
+    return const_range(first, first);
+  }
+  return const_range(first, lower_bound(pHigh));
+}
+
+// Keys equal to a separator may sit on either side of it, but every key
+// left of the first separator not less than pKey is less than pKey and no
+// key right of it is.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+std::size_t bplustree<Key, Value, Compare, Fanout, Search, Counted>::rank(
+    const Key &pKey) const {
+  static_assert(Counted, "rank() needs a Counted tree");
+  std::size_t less = 0;
+  const node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    const inner_type *inner = static_cast<const inner_type *>(temp);
+    int slot = inner->lower_bound(pKey);
+    for (int i = 0; i < slot; i++) {
+      less += inner->mChildren[i].get_count();
+    }
+    temp = inner->get_child(slot);
+  }
+  return less + temp->lower_bound(pKey);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::const_iterator
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::select(
+    std::size_t pIndex) const {
+  static_assert(Counted, "select() needs a Counted tree");
+  const node_type *temp = mRoot;
+  while (!temp->is_leaf()) {
+    const inner_type *inner = static_cast<const inner_type *>(temp);
+    // an index past the last record ends up past the last leaf
+    int slot = 0;
+    while (slot < inner->get_size() &&
+           pIndex >= inner->mChildren[slot].get_count()) {
+      pIndex -= inner->mChildren[slot].get_count();
+      slot++;
+    }
+    temp = inner->get_child(slot);
+  }
+  if (pIndex >= std::size_t(temp->get_size())) {
+    return end();
+  }
+  return const_iterator(static_cast<const leaf_type *>(temp), int(pIndex));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+std::size_t bplustree<Key, Value, Compare, Fanout, Search, Counted>::count(
+    const Key &pLow, const Key &pHigh) const {
+  static_assert(Counted, "count() needs a Counted tree");
+  if (!traits::less(pLow, pHigh)) {
+    return 0;
+  }
+  return rank(pHigh) - rank(pLow);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename ForwardIt>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::bulk_load(
+    ForwardIt pBegin, ForwardIt pEnd, double pFillFactor) {
+  std::size_t count = std::distance(pBegin, pEnd);
+  node_type *root = build(pBegin, count, pFillFactor, false);
+  if (!root) {
+    return false;
+  }
+  destroy_tree(mRoot);
+  set_root(root);
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename RandomIt>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::
+    parallel_bulk_load(RandomIt pBegin, RandomIt pEnd, unsigned pThreads,
+                       double pFillFactor) {
+  unsigned threads = detail::get_thread_count(pThreads);
+  std::size_t count = pEnd - pBegin;
+  auto recordLess = [](const record_type &pLeft, const record_type &pRight) {
+    return traits::less(pLeft.get_key(), pRight.get_key());
+  };
+  detail::parallel_sort(pBegin, pEnd, threads, recordLess);
+
+  std::vector<char> duplicate(threads, false);
+  auto findDuplicate = [&](unsigned pChunk, std::size_t pFirst,
+                           std::size_t pLast) {
+    for (std::size_t i = std::max<std::size_t>(pFirst, 1); i < pLast; i++) {
+      if (!recordLess(pBegin[i - 1], pBegin[i])) {
+        duplicate[pChunk] = true;
+        return;
+      }
+    }
+  };
+  detail::parallel_for(count, threads, findDuplicate);
+  if (std::find(duplicate.begin(), duplicate.end(), true) != duplicate.end()) {
+    return false;
+  }
+
+  int fill = get_fill_count(pFillFactor);
+  std::size_t leafCount = (count + fill - 1) / fill;
+  if (leafCount == 0) {
+    destroy_tree(mRoot);
+    set_root(mLeaves.create());
+    return true;
+  }
+
+  // every run of leaves comes from its own pools, the layout is the one
+  // build() produces
+  std::size_t base = count / leafCount;
+  std::size_t extra = count % leafCount;
+  unsigned runs = std::min<std::size_t>(threads, leafCount);
+  std::vector<node_pool<leaf_type>> pools(runs);
+  std::vector<leaf_type *> leaves(leafCount);
+  auto fillRun = [&](unsigned pRun, std::size_t pFirst, std::size_t pLast) {
+    leaf_type *prev = nullptr;
+    for (std::size_t i = pFirst; i < pLast; i++) {
+      leaf_type *lNew = pools[pRun].create();
+      lNew->set_prev(prev);
+      if (prev) {
+        prev->set_next(lNew);
+      }
+      prev = lNew;
+
+      RandomIt r = pBegin + (i * base + std::min(i, extra));
+      int size = base + (i < extra ? 1 : 0);
+      for (int j = 0; j < size; j++, ++r) {
+        const record_type &rec = *r;
+        lNew->mKeys[j] = rec.get_key();
+        lNew->mValues[j] = rec.get_value();
+      }
+      lNew->mSize = size;
+      leaves[i] = lNew;
+    }
+  };
+  detail::parallel_for(leafCount, runs, fillRun);
+
+  // stitch the runs together
+  for (unsigned t = 1; t < runs; t++) {
+    std::size_t first = detail::chunk_begin(leafCount, runs, t);
+    leaves[first - 1]->set_next(leaves[first]);
+    leaves[first]->set_prev(leaves[first - 1]);
+  }
+  for (node_pool<leaf_type> &p : pools) {
+    mLeaves.absorb(p);
+  }
+
+  std::vector<link_type> level;
+  level.reserve(leafCount);
+  for (leaf_type *l : leaves) {
+    level.push_back(link_type(get_separator(l), l));
+  }
+  node_type *root = build_inner_levels(level, fill);
+  destroy_tree(mRoot);
+  set_root(root);
+  return true;
+}
+
+// Threads never touch a node above their own subtrees: a split that would
+// add a link there is held back and applied once all threads are done.
+// Splits at the edge of a subtree do write the mPrev of the first node of
+// the neighbouring subtree, a field its owner never reads or writes.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+void bplustree<Key, Value, Compare, Fanout, Search, Counted>::insert_batch(
+    const record_type *pRecords, std::size_t pCount, unsigned pThreads) {
+  unsigned threads = detail::get_thread_count(pThreads);
+
+  // go down until a level has enough subtrees to share out; the key of
+  // each link is the separator in front of its subtree, the first is unused
+  std::vector<link_type> parts(1, link_type(Key(), mRoot));
+  while (parts.size() < 4 * std::size_t(threads) &&
+         !parts.front().get_node()->is_leaf()) {
+    std::vector<link_type> lower;
+    for (const link_type &p : parts) {
+      inner_type *iNode = static_cast<inner_type *>(p.get_node());
+      lower.push_back(link_type(p.get_key(), iNode->get_heir()));
+      for (int i = 0; i < iNode->get_size(); i++) {
+        lower.push_back(link_type(iNode->get_key(i), iNode->get_child(i + 1)));
+      }
+    }
+    parts.swap(lower);
+  }
+  std::size_t partCount = parts.size();
+  threads = std::min<std::size_t>(threads, partCount);
+  auto recordLess = [](const record_type *pLeft, const record_type *pRight) {
+    return traits::less(pLeft->get_key(), pRight->get_key());
+  };
+  if (threads <= 1) {
+    // in key order consecutive records mostly land in the same leaf
+    std::vector<const record_type *> sorted(pCount);
+    for (std::size_t i = 0; i < pCount; i++) {
+      sorted[i] = pRecords + i;
+    }
+    std::sort(sorted.begin(), sorted.end(), recordLess);
+    for (const record_type *r : sorted) {
+      insert(*r);
+    }
+    return;
+  }
+  int levelsBelow = get_height(parts.front().get_node());
+
+  // thread t owns the subtrees of chunk t
+  auto keyLess = [](const Key &pKey, const link_type &pLink) {
+    return traits::less(pKey, pLink.get_key());
+  };
+  std::vector<unsigned> partOwner(partCount);
+  for (unsigned t = 0; t < threads; t++) {
+    std::size_t first = detail::chunk_begin(partCount, threads, t);
+    std::size_t last = detail::chunk_begin(partCount, threads, t + 1);
+    std::fill(partOwner.begin() + first, partOwner.begin() + last, t);
+  }
+  std::vector<unsigned> owner(pCount);
+  auto findOwner = [&](unsigned, std::size_t pFirst, std::size_t pLast) {
+    for (std::size_t i = pFirst; i < pLast; i++) {
+      std::size_t p = std::upper_bound(parts.begin() + 1, parts.end(),
+                                       pRecords[i].get_key(), keyLess) -
+                      parts.begin() - 1;
+      owner[i] = partOwner[p];
+    }
+  };
+  detail::parallel_for(pCount, threads, findOwner);
+
+  std::vector<node_pool<leaf_type>> leafPools(threads);
+  std::vector<node_pool<inner_type>> innerPools(threads);
+  // each thread counts its splits apart and the counts are summed up after
+  std::vector<tree_events> events(threads);
+  std::vector<std::vector<link_type>> deferred(threads);
+  auto insertOwn = [&](unsigned pThread, std::size_t pFirst,
+                       std::size_t pLast) {
+    std::vector<link_type> local(parts.begin() + pFirst, parts.begin() + pLast);
+    std::vector<const record_type *> mine;
+    for (std::size_t i = 0; i < pCount; i++) {
+      if (owner[i] == pThread) {
+        mine.push_back(pRecords + i);
+      }
+    }
+    std::sort(mine.begin(), mine.end(), recordLess);
+    for (const record_type *r : mine) {
+      std::size_t idx = std::upper_bound(local.begin() + 1, local.end(),
+                                         r->get_key(), keyLess) -
+                        local.begin() - 1;
+      // the path within the subtree
+      inner_type *path[MAX_HEIGHT];
+      int slots[MAX_HEIGHT];
+      node_type *temp = local[idx].get_node();
+      for (int level = 0; level < levelsBelow; level++) {
+        path[level] = static_cast<inner_type *>(temp);
+        slots[level] = path[level]->upper_bound(r->get_key());
+        temp = path[level]->get_child(slots[level]);
+      }
+      static_cast<leaf_type *>(temp)->add_record(*r);
+      for (int level = levelsBelow - 1; temp->is_too_big(); level--) {
+        link_type l = split_node(temp, false, leafPools[pThread],
+                                 innerPools[pThread], events[pThread]);
+        if (level < 0) {
+          // the subtree itself split, keep the new one for ourselves
+          local.insert(local.begin() + idx + 1, l);
+          deferred[pThread].push_back(l);
+          break;
+        }
+        path[level]->insert_at(slots[level], l);
+        temp = path[level];
+      }
+    }
+  };
+  detail::parallel_for(partCount, threads, insertOwn);
+
+  for (unsigned t = 0; t < threads; t++) {
+    mLeaves.absorb(leafPools[t]);
+    mInners.absorb(innerPools[t]);
+    mEvents.absorb(events[t]);
+  }
+  // earlier links may have split the level above or grown the tree, so
+  // walk down to the parent by key each time
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  for (const std::vector<link_type> &links : deferred) {
+    for (const link_type &l : links) {
+      int level = mHeight - levelsBelow - 1;
+      node_type *temp = mRoot;
+      for (int i = 0; i < level; i++) {
+        path[i] = static_cast<inner_type *>(temp);
+        slots[i] = path[i]->upper_bound(l.get_key());
+        temp = path[i]->get_child(slots[i]);
+      }
+      inner_type *iParent = static_cast<inner_type *>(temp);
+      iParent->add_link(l);
+      split_upwards(path, slots, level - 1, iParent, false);
+    }
+  }
+  // the threads may have split the last leaf
+  set_root(mRoot);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::save(
+    const std::string &pPath) const {
+  // written aside and renamed over pPath, so that a failed save keeps the
+  // old dump
+  std::string temporary = pPath + ".tmp";
+  bool ok;
+  {
+    detail::dump_file file(temporary, "wb");
+    if (!file.get()) {
+      return false;
+    }
+    dump_header header = dump_header();
+    header.mMagic = DUMP_MAGIC;
+    header.mVersion = DUMP_VERSION;
+    header.mKeySize = sizeof(Key);
+    header.mValueSize = sizeof(Value);
+    header.mFlags = detail::get_dump_flags<Key, Value>();
+    header.mBlockRecords = DUMP_BLOCK_RECORDS;
+    // the header is written again once the count and checksum are known
+    ok = std::fwrite(&header, sizeof(header), 1, file.get()) == 1;
+
+    detail::dump_writer<Key, Value> writer(file.get());
+    node_type *temp = mRoot;
+    while (!temp->is_leaf()) {
+      temp = static_cast<inner_type *>(temp)->get_heir();
+    }
+    // straight down the leaf chain
+    for (; temp; temp = temp->get_next()) {
+      const leaf_type *leaf = static_cast<const leaf_type *>(temp);
+      for (int i = 0; i < leaf->get_size(); i++) {
+        writer.add(leaf->mKeys[i], leaf->mValues[i]);
+      }
+    }
+    ok = writer.finish() && ok;
+    header.mCount = writer.get_count();
+    header.mChecksum = writer.get_checksum();
+    ok = ok && std::fseek(file.get(), 0, SEEK_SET) == 0 &&
+         std::fwrite(&header, sizeof(header), 1, file.get()) == 1;
+    ok = file.sync_and_close() && ok;
+  }
+  if (!ok || std::rename(temporary.c_str(), pPath.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+bool bplustree<Key, Value, Compare, Fanout, Search, Counted>::load(
+    const std::string &pPath) {
+  detail::dump_file file(pPath, "rb");
+  if (!file.get()) {
+    return false;
+  }
+  dump_header header;
+  std::uint64_t bytes;
+  if (std::fread(&header, sizeof(header), 1, file.get()) != 1 ||
+      header.mMagic != DUMP_MAGIC || header.mVersion != DUMP_VERSION ||
+      header.mKeySize != sizeof(Key) || header.mValueSize != sizeof(Value) ||
+      header.mFlags != detail::get_dump_flags<Key, Value>() ||
+      !file.get_remaining(bytes)) {
+    return false;
+  }
+  // the count sizes the build, so it must fit the file before it is used
+  const std::size_t minRecord = detail::dump_codec<Key>::MIN_SIZE +
+                                detail::dump_codec<Value>::MIN_SIZE;
+  if (header.mCount > bytes / minRecord) {
+    return false;
+  }
+  detail::dump_reader<Key, Value> reader(file.get(), header.mCount);
+  // by reference, so that the reader can be checked after the build; the
+  // dump holds every record of the tree, equal keys included
+  node_type *root = build<detail::dump_reader<Key, Value> &>(
+      reader, header.mCount, 1.0, true);
+  bool ok = root && reader.is_complete() &&
+            reader.get_checksum() == header.mChecksum &&
+            std::fgetc(file.get()) == EOF;
+  if (!ok) {
+    if (root) {
+      destroy_tree(root);
+    }
+    return false;
+  }
+  destroy_tree(mRoot);
+  set_root(root);
+  return true;
+}
+
+// entries per node for a fill factor; never below half full so that the
+// evenly spread nodes stay clear of MIN_THRESHOLD
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+int bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_fill_count(
+    double pFillFactor) {
+  int count = static_cast<int>(pFillFactor * traits::MAX_THRESHOLD);
+  return std::max(std::min(count, traits::MAX_THRESHOLD),
+                  (traits::MAX_THRESHOLD + 1) / 2);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+Key bplustree<Key, Value, Compare, Fanout, Search, Counted>::get_separator(
+    const leaf_type *pLeaf) {
+  const node_type *prev = pLeaf->get_prev();
+  if (!prev) {
+    return pLeaf->get_key(0);
+  }
+  return key_separator<Key, Compare>::make(prev->get_key(prev->get_size() - 1),
+                                           pLeaf->get_key(0));
+}
+
+// Builds a detached tree from pCount sorted records. The leaves are filled
+// straight from the input and the inner levels are stacked on top of them,
+// so every record is touched once. Returns nullptr, with every new node
+// released again, if a key is less than the one before it, or equal to it
+// unless pDuplicates.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+template <typename InputIt>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::node_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::build(
+    InputIt pFirst, std::size_t pCount, double pFillFactor,
+    bool pDuplicates) {
+  int fill = get_fill_count(pFillFactor);
+  std::size_t leafCount = (pCount + fill - 1) / fill;
+  if (leafCount == 0) {
+    return mLeaves.create();
+  }
+
+  // spread the records evenly, the first leaves take one extra record
+  std::size_t base = pCount / leafCount;
+  std::size_t extra = pCount % leafCount;
+  // not reserved from pCount, which load() takes from the file
+  std::vector<link_type> level;
+  leaf_type *prev = nullptr;
+  const Key *last = nullptr;
+  for (std::size_t i = 0; i < leafCount; i++) {
+    leaf_type *lNew = mLeaves.create();
+    lNew->set_prev(prev);
+    if (prev) {
+      prev->set_next(lNew);
+    }
+    prev = lNew;
+
+    int size = base + (i < extra ? 1 : 0);
+    for (int j = 0; j < size; j++, ++pFirst) {
+      const record_type &r = *pFirst;
+      if (last && (pDuplicates ? traits::less(r.get_key(), *last)
+                               : !traits::less(*last, r.get_key()))) {
+        destroy_tree(level.empty() ? lNew : level.front().get_node());
+        return nullptr;
+      }
+      lNew->mKeys[j] = r.get_key();
+      lNew->mValues[j] = r.get_value();
+      lNew->mSize++;
+      last = &lNew->mKeys[j];
+    }
+    level.push_back(link_type(get_separator(lNew), lNew));
+  }
+  return build_inner_levels(level, fill);
+}
+
+// Stacks inner levels on top of a chained level of nodes until a single
+// root remains. pLevel holds each node with the smallest key below it and
+// is consumed.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search, bool Counted>
+typename bplustree<Key, Value, Compare, Fanout, Search, Counted>::node_type *
+bplustree<Key, Value, Compare, Fanout, Search, Counted>::build_inner_levels(
+    std::vector<link_type> &pLevel, int pFillCount) {
+  while (pLevel.size() > 1) {
+    // each inner node takes pFillCount links plus its heir
+    std::size_t childCount = pLevel.size();
+    std::size_t nodeCount = (childCount + pFillCount) / (pFillCount + 1);
+    std::size_t base = childCount / nodeCount;
+    std::size_t extra = childCount % nodeCount;
+    std::vector<link_type> upper;
+    upper.reserve(nodeCount);
+    inner_type *prev = nullptr;
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < nodeCount; i++) {
+      inner_type *iNew = mInners.create(pLevel[c].get_node());
+      iNew->set_prev(prev);
+      if (prev) {
+        prev->set_next(iNew);
+      }
+      prev = iNew;
+      upper.push_back(link_type(pLevel[c].get_key(), iNew));
+
+      std::size_t size = base + (i < extra ? 1 : 0);
+      for (std::size_t j = 1; j < size; j++) {
+        const link_type &l = pLevel[c + j];
+        iNew->mKeys[iNew->mSize] = l.get_key();
+        iNew->mChildren[iNew->mSize + 1] = l.get_node();
+        iNew->mSize++;
+      }
+      c += size;
+    }
+    pLevel.swap(upper);
+  }
+  return pLevel.front().get_node();
+}
+
+} // namespace bpt
+
+#endif
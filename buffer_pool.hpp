@@ -0,0 +1,284 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include "page_store.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bpt {
+
+struct buffer_pool_stats {
+  // pins served from a frame / read from the file
+  std::uint64_t mHits;
+  std::uint64_t mMisses;
+  // frames taken over from another page
+  std::uint64_t mEvictions;
+  // pages written to the file, on eviction or flush
+  std::uint64_t mWritebacks;
+};
+
+// Page store for files larger than memory. Pages are read into a fixed
+// number of frames on their first pin and stay there while pinned; when a
+// page that is not resident gets pinned, a CLOCK hand sweeps the frames
+// and takes the first unpinned one that has not been used since the last
+// sweep, writing it back with pwrite if it is dirty. flush() writes back
+// every dirty frame in page order and syncs the file.
+//
+// No more than get_frame_count() pages may be pinned at once; a tree
+// operation pins a handful. pin() returns nullptr if the page cannot be
+// read in full or every frame is pinned, and the failure is also reported
+// by the next flush() or close().
+class buffer_pool_page_store {
+public:
+  static constexpr std::size_t PAGE_SIZE = 4096;
+  static constexpr std::size_t DEFAULT_FRAMES = 1024;
+  static constexpr std::size_t MIN_FRAMES = 16;
+
+  buffer_pool_page_store();
+  buffer_pool_page_store(const buffer_pool_page_store &) = delete;
+  buffer_pool_page_store &operator=(const buffer_pool_page_store &) = delete;
+  ~buffer_pool_page_store();
+
+  // takes effect at the next open(); at least MIN_FRAMES
+  void set_frame_count(std::size_t pFrames);
+  std::size_t get_frame_count() const;
+
+  bool open(const std::string &pPath);
+  // flushes, then closes the file; false if the flush failed
+  bool close();
+  bool is_open() const;
+  std::size_t get_page_count() const;
+  bool resize(std::size_t pPages);
+  char *pin(page_id pId);
+  void unpin(page_id pId, bool pDirty);
+  // asks the kernel to start reading pId, which is about to be pinned
+  void prefetch(page_id pId);
+  // false if any read or write back failed since the last flush
+  bool flush();
+
+  const buffer_pool_stats &get_stats() const;
+  void reset_stats();
+
+private:
+  static constexpr std::size_t NO_FRAME = ~std::size_t(0);
+
+  struct frame {
+    page_id mPage;
+    std::uint32_t mPins;
+    bool mUsed;
+    bool mDirty;
+    bool mReferenced;
+  };
+
+  // a frame to load a page into, or NO_FRAME if every frame is pinned
+  std::size_t find_victim();
+  void write_back(std::size_t pFrame);
+  char *get_frame_data(std::size_t pFrame) const;
+
+  int mFd;
+  std::size_t mPageCount;
+  std::size_t mFrameCount;
+  char *mData;
+  std::vector<frame> mFrames;
+  std::unordered_map<page_id, std::uint32_t> mTable;
+  std::size_t mHand;
+  bool mFailed;
+  buffer_pool_stats mStats;
+};
+
+inline buffer_pool_page_store::buffer_pool_page_store()
+    : mFd(-1), mPageCount(0), mFrameCount(DEFAULT_FRAMES), mData(nullptr),
+      mHand(0), mFailed(false), mStats() {}
+
+inline buffer_pool_page_store::~buffer_pool_page_store() { close(); }
+
+inline void buffer_pool_page_store::set_frame_count(std::size_t pFrames) {
+  mFrameCount = std::max(pFrames, MIN_FRAMES);
+}
+
+inline std::size_t buffer_pool_page_store::get_frame_count() const {
+  return mFrameCount;
+}
+
+inline bool buffer_pool_page_store::open(const std::string &pPath) {
+  close();
+  mFd = ::open(pPath.c_str(), O_RDWR | O_CREAT, 0644);
+  if (mFd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(mFd, &st) != 0 || st.st_size % PAGE_SIZE != 0 ||
+      !(mData = static_cast<char *>(
+            std::aligned_alloc(PAGE_SIZE, mFrameCount * PAGE_SIZE)))) {
+    close();
+    return false;
+  }
+  mPageCount = st.st_size / PAGE_SIZE;
+  mFrames.assign(mFrameCount, frame());
+  mTable.reserve(mFrameCount);
+  mHand = 0;
+  mFailed = false;
+  return true;
+}
+
+inline bool buffer_pool_page_store::close() {
+  bool ok = true;
+  if (mFd >= 0) {
+    ok = flush();
+    ok = ::close(mFd) == 0 && ok;
+    mFd = -1;
+  }
+  std::free(mData);
+  mData = nullptr;
+  mFrames.clear();
+  mTable.clear();
+  mPageCount = 0;
+  return ok;
+}
+
+inline bool buffer_pool_page_store::is_open() const { return mFd >= 0; }
+
+inline std::size_t buffer_pool_page_store::get_page_count() const {
+  return mPageCount;
+}
+
+inline bool buffer_pool_page_store::resize(std::size_t pPages) {
+  if (pPages <= mPageCount) {
+    return true;
+  }
+  if (ftruncate(mFd, pPages * PAGE_SIZE) != 0) {
+    return false;
+  }
+  mPageCount = pPages;
+  return true;
+}
+
+inline char *buffer_pool_page_store::pin(page_id pId) {
+  auto found = mTable.find(pId);
+  if (found != mTable.end()) {
+    frame &f = mFrames[found->second];
+    f.mPins++;
+    f.mReferenced = true;
+    mStats.mHits++;
+    return get_frame_data(found->second);
+  }
+  mStats.mMisses++;
+  std::size_t victim = find_victim();
+  if (victim == NO_FRAME) {
+    mFailed = true;
+    return nullptr;
+  }
+  frame &f = mFrames[victim];
+  if (f.mUsed) {
+    mStats.mEvictions++;
+    if (f.mDirty) {
+      write_back(victim);
+    }
+    mTable.erase(f.mPage);
+    f.mUsed = false;
+  }
+  char *data = get_frame_data(victim);
+  if (pread(mFd, data, PAGE_SIZE, off_t(pId) * PAGE_SIZE) !=
+      ssize_t(PAGE_SIZE)) {
+    // the frame stays free
+    mFailed = true;
+    return nullptr;
+  }
+  f.mPage = pId;
+  f.mPins = 1;
+  f.mUsed = true;
+  f.mDirty = false;
+  f.mReferenced = true;
+  mTable.emplace(pId, std::uint32_t(victim));
+  return data;
+}
+
+inline void buffer_pool_page_store::unpin(page_id pId, bool pDirty) {
+  frame &f = mFrames[mTable.find(pId)->second];
+  f.mPins--;
+  f.mDirty |= pDirty;
+}
+
+inline void buffer_pool_page_store::prefetch(page_id pId) {
+  if (mTable.find(pId) == mTable.end()) {
+    posix_fadvise(mFd, off_t(pId) * PAGE_SIZE, PAGE_SIZE,
+                  POSIX_FADV_WILLNEED);
+  }
+}
+
+inline bool buffer_pool_page_store::flush() {
+  std::vector<std::uint32_t> dirty;
+  for (std::size_t i = 0; i < mFrames.size(); i++) {
+    if (mFrames[i].mUsed && mFrames[i].mDirty) {
+      dirty.push_back(std::uint32_t(i));
+    }
+  }
+  // in file order, so neighbouring pages go out as one sequential run
+  std::sort(dirty.begin(), dirty.end(),
+            [this](std::uint32_t pLeft, std::uint32_t pRight) {
+              return mFrames[pLeft].mPage < mFrames[pRight].mPage;
+            });
+  for (std::uint32_t i : dirty) {
+    write_back(i);
+  }
+  bool ok = !mFailed && (mFd < 0 || fdatasync(mFd) == 0);
+  mFailed = false;
+  return ok;
+}
+
+inline const buffer_pool_stats &buffer_pool_page_store::get_stats() const {
+  return mStats;
+}
+
+inline void buffer_pool_page_store::reset_stats() {
+  mStats = buffer_pool_stats();
+}
+
+// Sweeps the hand over the frames, clearing reference bits, until it finds
+// a free frame or an unpinned one that was not referenced since the hand
+// last passed it. Two full turns without one mean every frame is pinned.
+inline std::size_t buffer_pool_page_store::find_victim() {
+  for (std::size_t step = 0; step < 2 * mFrames.size(); step++) {
+    std::size_t i = mHand;
+    mHand = (mHand + 1) % mFrames.size();
+    frame &f = mFrames[i];
+    if (!f.mUsed) {
+      return i;
+    }
+    if (f.mPins > 0) {
+      continue;
+    }
+    if (!f.mReferenced) {
+      return i;
+    }
+    f.mReferenced = false;
+  }
+  return NO_FRAME;
+}
+
+inline void buffer_pool_page_store::write_back(std::size_t pFrame) {
+  frame &f = mFrames[pFrame];
+  if (pwrite(mFd, get_frame_data(pFrame), PAGE_SIZE,
+             off_t(f.mPage) * PAGE_SIZE) != ssize_t(PAGE_SIZE)) {
+    mFailed = true;
+  }
+  f.mDirty = false;
+  mStats.mWritebacks++;
+}
+
+inline char *buffer_pool_page_store::get_frame_data(std::size_t pFrame) const {
+  return mData + pFrame * PAGE_SIZE;
+}
+
+} // namespace bpt
+
+#endif
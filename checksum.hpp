@@ -0,0 +1,65 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace bpt {
+
+namespace detail {
+
+// Slicing-by-8 tables: mEntries[0] is the classic byte table, and
+// mEntries[k] advances a byte through k more zero bytes, so that eight
+// bytes are folded in with eight independent lookups.
+struct crc32_table {
+  crc32_table() {
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+      }
+      mEntries[0][i] = crc;
+    }
+    for (std::uint32_t i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++) {
+        std::uint32_t previous = mEntries[k - 1][i];
+        mEntries[k][i] = (previous >> 8) ^ mEntries[0][previous & 0xFF];
+      }
+    }
+  }
+
+  std::uint32_t mEntries[8][256];
+};
+
+} // namespace detail
+
+// CRC-32 (IEEE) of pSize bytes. Pass the result of the previous call as
+// pCrc to checksum data that comes in several pieces.
+inline std::uint32_t crc32(const void *pData, std::size_t pSize,
+                           std::uint32_t pCrc = 0) {
+  static const detail::crc32_table table;
+  const std::uint32_t(*t)[256] = table.mEntries;
+  const unsigned char *bytes = static_cast<const unsigned char *>(pData);
+  std::uint32_t crc = ~pCrc;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; pSize >= 8; pSize -= 8, bytes += 8) {
+    std::uint32_t low, high;
+    std::memcpy(&low, bytes, 4);
+    std::memcpy(&high, bytes + 4, 4);
+    low ^= crc;
+    crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+          t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^ t[3][high & 0xFF] ^
+          t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^
+          t[0][high >> 24];
+  }
+#endif
+  for (; pSize > 0; pSize--) {
+    crc = t[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+} // namespace bpt
+
+#endif
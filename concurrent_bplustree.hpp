@@ -0,0 +1,196 @@
+#ifndef CONCURRENT_BPLUSTREE_HPP
+#define CONCURRENT_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+#include "epoch_manager.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace bpt {
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+class concurrent_bplustree;
+
+// Version lock of one node. Bit 1 is set while a writer holds the node and
+// bit 0 once the node has been unlinked from the tree; each write unlock
+// advances the counter in the upper bits. A reader that sees the same
+// unlocked version before and after reading a node knows that no writer
+// touched it in between. None of the calls block: when the node is locked
+// or changed they set pRestart and the operation starts over from the root.
+class optimistic_lock {
+public:
+  optimistic_lock();
+  std::uint64_t read_lock(bool &pRestart) const;
+  void validate(std::uint64_t pVersion, bool &pRestart) const;
+  void upgrade(std::uint64_t pVersion, bool &pRestart);
+  void write_unlock();
+  void write_unlock_obsolete();
+
+private:
+  std::atomic<std::uint64_t> mVersion;
+};
+
+// Nodes of the concurrent tree. Readers copy fields out of them while a
+// writer may be changing them and only trust what they copied once the
+// version check passes, so keys and values have to be trivially copyable.
+// There are no parent or sibling links: a writer locks the parent it came
+// through, never a node it did not reach from the root.
+template <typename Traits> class olc_node {
+  template <typename, typename, typename, int, typename>
+  friend class concurrent_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+
+  // nodes are split before they overflow, so no spare slot is needed
+  static constexpr int CAPACITY = Traits::MAX_THRESHOLD;
+  static constexpr int KEY_SLOTS =
+      (CAPACITY * sizeof(key_type) + Traits::CACHE_LINE - 1) /
+      Traits::CACHE_LINE * Traits::CACHE_LINE / sizeof(key_type);
+
+  bool is_leaf() const;
+  int get_size() const;
+  bool is_full() const;
+  const key_type &get_key(int pIndex) const;
+  int lower_bound(const key_type &pKey) const;
+  int upper_bound(const key_type &pKey) const;
+
+protected:
+  olc_node(bool pIsLeaf);
+  ~olc_node() = default;
+
+  optimistic_lock mLock;
+  bool mIsLeaf;
+  int mSize;
+  alignas(Traits::CACHE_LINE) key_type mKeys[KEY_SLOTS];
+};
+
+template <typename Traits> class olc_leaf_node : public olc_node<Traits> {
+  template <typename, typename, typename, int, typename>
+  friend class concurrent_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+  typedef typename Traits::value_type value_type;
+
+  olc_leaf_node();
+  const value_type &get_value(int pIndex) const;
+  // Copies the value of pKey into pValue, if it is present. Optimistic
+  // readers make their copies of a leaf here, before they validate it.
+  bool copy_value(const key_type &pKey, value_type &pValue) const;
+
+private:
+  void insert_at(int pIndex, const key_type &pKey, const value_type &pValue);
+  void erase(int pIndex);
+  // moves the upper half into pNew and returns its first key
+  key_type split_into(olc_leaf_node *pNew);
+  void merge_from(olc_leaf_node *pRight);
+  // evens out the two nodes and returns the new first key of pRight
+  key_type redistribute(olc_leaf_node *pRight);
+
+  value_type mValues[olc_node<Traits>::CAPACITY];
+};
+
+// Child i sits to the right of key i - 1, as in inner_node.
+template <typename Traits> class olc_inner_node : public olc_node<Traits> {
+  template <typename, typename, typename, int, typename>
+  friend class concurrent_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+
+  olc_inner_node(olc_node<Traits> *pHeir);
+  olc_node<Traits> *get_child(int pIndex) const;
+
+private:
+  // inserts pKey at pIndex with pRight as the child to its right
+  void insert_at(int pIndex, const key_type &pKey, olc_node<Traits> *pRight);
+  // removes key pIndex and the child to its right
+  void erase(int pIndex);
+  // moves the keys above the middle one into pNew and returns the middle
+  // key, which belongs in the parent
+  key_type split_into(olc_inner_node *pNew);
+  void merge_from(olc_inner_node *pRight, const key_type &pSeparator);
+  key_type redistribute(olc_inner_node *pRight, const key_type &pSeparator);
+
+  olc_node<Traits> *mChildren[olc_node<Traits>::CAPACITY + 1];
+};
+
+// B+tree that any number of threads may search, insert into and remove
+// from at once, using optimistic lock coupling. Readers take no locks:
+// they walk down reading node versions and restart from the root if a node
+// changed under them. Writers descend the same way and lock only the nodes
+// they modify. Full nodes are split and underfull nodes are merged or
+// evened out with a sibling on the way down, so a change never has to
+// climb back up the tree. Nodes that a merge or a root collapse unlinks
+// are freed through an epoch_manager once no reader can still see them.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          int Fanout = 30, typename Search = simd_search_policy>
+class concurrent_bplustree {
+  static_assert(std::is_trivially_copyable<Key>::value &&
+                    std::is_trivially_copyable<Value>::value,
+                "optimistic readers need trivially copyable keys and values");
+
+public:
+  typedef bplustree_traits<Key, Value, Compare, Fanout, Search> traits;
+  typedef record<Key, Value> record_type;
+
+  concurrent_bplustree();
+  concurrent_bplustree(const concurrent_bplustree &) = delete;
+  concurrent_bplustree &operator=(const concurrent_bplustree &) = delete;
+  // must not run concurrently with any other call
+  ~concurrent_bplustree();
+
+  // copies the value of pKey into pValue; false if pKey is absent
+  bool search(const Key &pKey, Value &pValue) const;
+  // false, leaving the tree unchanged, if the key is already present
+  bool insert(const record_type &pRecord);
+  bool remove(const Key &pKey);
+
+  // Walks the whole tree and checks that the keys ascend, that every key
+  // lies within the separators above it, that all leaves are at the same
+  // depth and that no node is left locked or unlinked; pRecords receives
+  // the number of records. Must not run concurrently with any other call.
+  bool verify(std::size_t &pRecords) const;
+
+private:
+  typedef olc_node<traits> node_type;
+  typedef olc_leaf_node<traits> leaf_type;
+  typedef olc_inner_node<traits> inner_type;
+
+  // Each try_ function makes one attempt and sets pRestart if it ran into
+  // a concurrent writer, in which case it has changed nothing visible
+  // except possibly a split or merge on the way down.
+  bool try_search(const Key &pKey, Value &pValue, bool &pRestart) const;
+  bool try_insert(const record_type &pRecord, bool &pRestart);
+  bool try_remove(const Key &pKey, bool &pRestart);
+  node_type *read_root(std::uint64_t &pVersion, bool &pRestart) const;
+  // child pSlot of pParent, read under pVersion, and in pChildVersion the
+  // version of the child
+  node_type *read_child(const inner_type *pParent, std::uint64_t pVersion,
+                        int pSlot, std::uint64_t &pChildVersion,
+                        bool &pRestart) const;
+  void split(node_type *pNode, inner_type *pParent);
+  bool rebalance(inner_type *pParent, int pLeftSlot, node_type *pLeft,
+                 node_type *pRight);
+  void retire(node_type *pNode);
+  static void delete_node(void *pNode);
+  static void destroy_tree(node_type *pNode);
+  // pLow and pHigh, either of which may be null, bound the keys of pNode
+  static bool verify_node(const node_type *pNode, const Key *pLow,
+                          const Key *pHigh, int pDepth, int &pLeafDepth,
+                          std::size_t &pRecords);
+
+  std::atomic<node_type *> mRoot;
+  mutable epoch_manager mEpochs;
+};
+
+} // namespace bpt
+
+#include "concurrent_bplustree_impl.hpp"
+
+#endif
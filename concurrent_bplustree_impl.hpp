@@ -0,0 +1,705 @@
+#ifndef CONCURRENT_BPLUSTREE_IMPL_HPP
+#define CONCURRENT_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace bpt {
+
+// optimistic_lock class //////////////////////////////////////////////////////
+
+inline optimistic_lock::optimistic_lock() : mVersion(0) {}
+
+inline std::uint64_t optimistic_lock::read_lock(bool &pRestart) const {
+  std::uint64_t version = mVersion.load(std::memory_order_acquire);
+  if (version & 3) {
+    // locked or obsolete
+    pRestart = true;
+  }
+  return version;
+}
+
+inline void optimistic_lock::validate(std::uint64_t pVersion,
+                                      bool &pRestart) const {
+  // the reads of the node must not drift below the version check
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (mVersion.load(std::memory_order_relaxed) != pVersion) {
+    pRestart = true;
+  }
+}
+
+inline void optimistic_lock::upgrade(std::uint64_t pVersion, bool &pRestart) {
+  if (!mVersion.compare_exchange_strong(pVersion, pVersion + 2,
+                                        std::memory_order_acquire)) {
+    pRestart = true;
+  }
+}
+
+inline void optimistic_lock::write_unlock() {
+  mVersion.fetch_add(2, std::memory_order_release);
+}
+
+inline void optimistic_lock::write_unlock_obsolete() {
+  mVersion.fetch_add(3, std::memory_order_release);
+}
+
+// olc_node class /////////////////////////////////////////////////////////////
+template <typename Traits>
+olc_node<Traits>::olc_node(bool pIsLeaf)
+    : mIsLeaf(pIsLeaf), mSize(0), mKeys() {}
+
+template <typename Traits> bool olc_node<Traits>::is_leaf() const {
+  return mIsLeaf;
+}
+
+template <typename Traits> int olc_node<Traits>::get_size() const {
+  return mSize;
+}
+
+template <typename Traits> bool olc_node<Traits>::is_full() const {
+  return mSize >= CAPACITY;
+}
+
+template <typename Traits>
+const typename olc_node<Traits>::key_type &
+olc_node<Traits>::get_key(int pIndex) const {
+  return mKeys[pIndex];
+}
+
+template <typename Traits>
+int olc_node<Traits>::lower_bound(const key_type &pKey) const {
+  return Traits::search_policy::lower_bound(mKeys, mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+template <typename Traits>
+int olc_node<Traits>::upper_bound(const key_type &pKey) const {
+  return Traits::search_policy::upper_bound(mKeys, mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+// olc_leaf_node class ////////////////////////////////////////////////////////
+template <typename Traits>
+olc_leaf_node<Traits>::olc_leaf_node() : olc_node<Traits>(true), mValues() {}
+
+template <typename Traits>
+const typename olc_leaf_node<Traits>::value_type &
+olc_leaf_node<Traits>::get_value(int pIndex) const {
+  return mValues[pIndex];
+}
+
+template <typename Traits>
+bool olc_leaf_node<Traits>::copy_value(const key_type &pKey,
+                                       value_type &pValue) const {
+  int idx = this->lower_bound(pKey);
+  if (idx == this->mSize || Traits::less(pKey, this->mKeys[idx])) {
+    return false;
+  }
+  pValue = mValues[idx];
+  return true;
+}
+
+template <typename Traits>
+void olc_leaf_node<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                      const value_type &pValue) {
+  int size = this->mSize;
+  std::move_backward(this->mKeys + pIndex, this->mKeys + size,
+                     this->mKeys + size + 1);
+  std::move_backward(mValues + pIndex, mValues + size, mValues + size + 1);
+  this->mKeys[pIndex] = pKey;
+  mValues[pIndex] = pValue;
+  this->mSize++;
+}
+
+template <typename Traits> void olc_leaf_node<Traits>::erase(int pIndex) {
+  int size = this->mSize;
+  std::move(this->mKeys + pIndex + 1, this->mKeys + size,
+            this->mKeys + pIndex);
+  std::move(mValues + pIndex + 1, mValues + size, mValues + pIndex);
+  this->mSize--;
+}
+
+template <typename Traits>
+typename olc_leaf_node<Traits>::key_type
+olc_leaf_node<Traits>::split_into(olc_leaf_node *pNew) {
+  int from = this->mSize / 2;
+  std::copy(this->mKeys + from, this->mKeys + this->mSize, pNew->mKeys);
+  std::copy(mValues + from, mValues + this->mSize, pNew->mValues);
+  pNew->mSize = this->mSize - from;
+  this->mSize = from;
+  return pNew->mKeys[0];
+}
+
+template <typename Traits>
+void olc_leaf_node<Traits>::merge_from(olc_leaf_node *pRight) {
+  int size = this->mSize;
+  std::copy(pRight->mKeys, pRight->mKeys + pRight->mSize, this->mKeys + size);
+  std::copy(pRight->mValues, pRight->mValues + pRight->mSize, mValues + size);
+  this->mSize += pRight->mSize;
+}
+
+template <typename Traits>
+typename olc_leaf_node<Traits>::key_type
+olc_leaf_node<Traits>::redistribute(olc_leaf_node *pRight) {
+  int size = this->mSize, rsize = pRight->mSize;
+  int target = (size + rsize) / 2;
+  if (size < target) {
+    // pull the first records of pRight over
+    int count = target - size;
+    std::copy(pRight->mKeys, pRight->mKeys + count, this->mKeys + size);
+    std::copy(pRight->mValues, pRight->mValues + count, mValues + size);
+    std::copy(pRight->mKeys + count, pRight->mKeys + rsize, pRight->mKeys);
+    std::copy(pRight->mValues + count, pRight->mValues + rsize,
+              pRight->mValues);
+    pRight->mSize = rsize - count;
+  } else {
+    // push our last records in front of those of pRight
+    int count = size - target;
+    std::copy_backward(pRight->mKeys, pRight->mKeys + rsize,
+                       pRight->mKeys + rsize + count);
+    std::copy_backward(pRight->mValues, pRight->mValues + rsize,
+                       pRight->mValues + rsize + count);
+    std::copy(this->mKeys + target, this->mKeys + size, pRight->mKeys);
+    std::copy(mValues + target, mValues + size, pRight->mValues);
+    pRight->mSize = rsize + count;
+  }
+  this->mSize = target;
+  return pRight->mKeys[0];
+}
+
+// olc_inner_node class ///////////////////////////////////////////////////////
+template <typename Traits>
+olc_inner_node<Traits>::olc_inner_node(olc_node<Traits> *pHeir)
+    : olc_node<Traits>(false), mChildren() {
+  mChildren[0] = pHeir;
+}
+
+template <typename Traits>
+olc_node<Traits> *olc_inner_node<Traits>::get_child(int pIndex) const {
+  return mChildren[pIndex];
+}
+
+template <typename Traits>
+void olc_inner_node<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                       olc_node<Traits> *pRight) {
+  int size = this->mSize;
+  std::move_backward(this->mKeys + pIndex, this->mKeys + size,
+                     this->mKeys + size + 1);
+  std::copy_backward(mChildren + pIndex + 1, mChildren + size + 1,
+                     mChildren + size + 2);
+  this->mKeys[pIndex] = pKey;
+  mChildren[pIndex + 1] = pRight;
+  this->mSize++;
+}
+
+template <typename Traits> void olc_inner_node<Traits>::erase(int pIndex) {
+  int size = this->mSize;
+  std::move(this->mKeys + pIndex + 1, this->mKeys + size,
+            this->mKeys + pIndex);
+  std::copy(mChildren + pIndex + 2, mChildren + size + 1,
+            mChildren + pIndex + 1);
+  this->mSize--;
+}
+
+template <typename Traits>
+typename olc_inner_node<Traits>::key_type
+olc_inner_node<Traits>::split_into(olc_inner_node *pNew) {
+  int from = this->mSize / 2;
+  std::copy(this->mKeys + from + 1, this->mKeys + this->mSize, pNew->mKeys);
+  std::copy(mChildren + from + 1, mChildren + this->mSize + 1,
+            pNew->mChildren);
+  pNew->mSize = this->mSize - from - 1;
+  this->mSize = from;
+  return this->mKeys[from];
+}
+
+template <typename Traits>
+void olc_inner_node<Traits>::merge_from(olc_inner_node *pRight,
+                                        const key_type &pSeparator) {
+  int size = this->mSize;
+  this->mKeys[size] = pSeparator;
+  std::copy(pRight->mKeys, pRight->mKeys + pRight->mSize,
+            this->mKeys + size + 1);
+  std::copy(pRight->mChildren, pRight->mChildren + pRight->mSize + 1,
+            mChildren + size + 1);
+  this->mSize += pRight->mSize + 1;
+}
+
+// The separator comes down between the two key runs and whichever key ends
+// up in the middle goes back up.
+template <typename Traits>
+typename olc_inner_node<Traits>::key_type
+olc_inner_node<Traits>::redistribute(olc_inner_node *pRight,
+                                     const key_type &pSeparator) {
+  int size = this->mSize, rsize = pRight->mSize;
+  int target = (size + 1 + rsize) / 2;
+  key_type separator;
+  if (size < target) {
+    int count = target - size;
+    this->mKeys[size] = pSeparator;
+    std::copy(pRight->mKeys, pRight->mKeys + count - 1,
+              this->mKeys + size + 1);
+    std::copy(pRight->mChildren, pRight->mChildren + count,
+              mChildren + size + 1);
+    separator = pRight->mKeys[count - 1];
+    std::copy(pRight->mKeys + count, pRight->mKeys + rsize, pRight->mKeys);
+    std::copy(pRight->mChildren + count, pRight->mChildren + rsize + 1,
+              pRight->mChildren);
+    pRight->mSize = rsize - count;
+  } else {
+    int count = size - target;
+    std::copy_backward(pRight->mKeys, pRight->mKeys + rsize,
+                       pRight->mKeys + rsize + count);
+    std::copy_backward(pRight->mChildren, pRight->mChildren + rsize + 1,
+                       pRight->mChildren + rsize + 1 + count);
+    std::copy(this->mKeys + target + 1, this->mKeys + size, pRight->mKeys);
+    pRight->mKeys[count - 1] = pSeparator;
+    std::copy(mChildren + target + 1, mChildren + size + 1,
+              pRight->mChildren);
+    separator = this->mKeys[target];
+    pRight->mSize = rsize + count;
+  }
+  this->mSize = target;
+  return separator;
+}
+
+// concurrent_bplustree class /////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+concurrent_bplustree<Key, Value, Compare, Fanout,
+                     Search>::concurrent_bplustree()
+    : mRoot(new leaf_type()) {}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+concurrent_bplustree<Key, Value, Compare, Fanout,
+                     Search>::~concurrent_bplustree() {
+  destroy_tree(mRoot.load(std::memory_order_relaxed));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::search(
+    const Key &pKey, Value &pValue) const {
+  epoch_manager::guard guard(mEpochs);
+  for (;;) {
+    bool restart = false;
+    bool found = try_search(pKey, pValue, restart);
+    if (!restart) {
+      return found;
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::insert(
+    const record_type &pRecord) {
+  epoch_manager::guard guard(mEpochs);
+  for (;;) {
+    bool restart = false;
+    bool inserted = try_insert(pRecord, restart);
+    if (!restart) {
+      return inserted;
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::remove(
+    const Key &pKey) {
+  epoch_manager::guard guard(mEpochs);
+  for (;;) {
+    bool restart = false;
+    bool removed = try_remove(pKey, restart);
+    if (!restart) {
+      return removed;
+    }
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::verify(
+    std::size_t &pRecords) const {
+  pRecords = 0;
+  int leafDepth = -1;
+  return verify_node(mRoot.load(std::memory_order_acquire), nullptr, nullptr,
+                     0, leafDepth, pRecords);
+}
+
+// The root is only trusted if it is still the root once its version has
+// been read; a node that stopped being the root is locked while that
+// happens, so any later change shows up in its version.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+typename concurrent_bplustree<Key, Value, Compare, Fanout, Search>::node_type *
+concurrent_bplustree<Key, Value, Compare, Fanout, Search>::read_root(
+    std::uint64_t &pVersion, bool &pRestart) const {
+  node_type *root = mRoot.load(std::memory_order_acquire);
+  pVersion = root->mLock.read_lock(pRestart);
+  if (root != mRoot.load(std::memory_order_acquire)) {
+    pRestart = true;
+  }
+  return root;
+}
+
+// Lock coupling. The child pointer is copied while a writer may be
+// changing the parent, so the copy may be torn and point to a node retired
+// in an earlier epoch, which the current epoch no longer keeps. It is only
+// followed once the parent has been validated, and the parent is validated
+// again after the version of the child has been read. A split or merge of
+// the child always changes the parent too, so a child read this way covers
+// the key for as long as its own version stays the same.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+typename concurrent_bplustree<Key, Value, Compare, Fanout, Search>::node_type *
+concurrent_bplustree<Key, Value, Compare, Fanout, Search>::read_child(
+    const inner_type *pParent, std::uint64_t pVersion, int pSlot,
+    std::uint64_t &pChildVersion, bool &pRestart) const {
+  node_type *child = pParent->get_child(pSlot);
+  pParent->mLock.validate(pVersion, pRestart);
+  if (pRestart) {
+    return nullptr;
+  }
+  pChildVersion = child->mLock.read_lock(pRestart);
+  pParent->mLock.validate(pVersion, pRestart);
+  return child;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::try_search(
+    const Key &pKey, Value &pValue, bool &pRestart) const {
+  std::uint64_t version;
+  node_type *temp = read_root(version, pRestart);
+  if (pRestart) {
+    return false;
+  }
+  while (!temp->is_leaf()) {
+    inner_type *iTemp = static_cast<inner_type *>(temp);
+    std::uint64_t childVersion;
+    node_type *child = read_child(iTemp, version, iTemp->upper_bound(pKey),
+                                  childVersion, pRestart);
+    if (pRestart) {
+      return false;
+    }
+    temp = child;
+    version = childVersion;
+  }
+
+  leaf_type *ltemp = static_cast<leaf_type *>(temp);
+  bool found = ltemp->copy_value(pKey, pValue);
+  ltemp->mLock.validate(version, pRestart);
+  return found;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::try_insert(
+    const record_type &pRecord, bool &pRestart) {
+  const Key &key = pRecord.get_key();
+  inner_type *parent = nullptr;
+  std::uint64_t parentVersion = 0, version;
+  node_type *temp = read_root(version, pRestart);
+  if (pRestart) {
+    return false;
+  }
+  for (;;) {
+    if (temp->is_full()) {
+      // split eagerly, so that the parent always has room for the new link
+      if (parent) {
+        parent->mLock.upgrade(parentVersion, pRestart);
+        if (pRestart) {
+          return false;
+        }
+      }
+      temp->mLock.upgrade(version, pRestart);
+      if (!pRestart && !parent &&
+          temp != mRoot.load(std::memory_order_relaxed)) {
+        temp->mLock.write_unlock();
+        pRestart = true;
+      }
+      if (pRestart) {
+        if (parent) {
+          parent->mLock.write_unlock();
+        }
+        return false;
+      }
+      split(temp, parent);
+      temp->mLock.write_unlock();
+      if (parent) {
+        parent->mLock.write_unlock();
+      }
+      pRestart = true;
+      return false;
+    }
+    if (temp->is_leaf()) {
+      break;
+    }
+
+    inner_type *iTemp = static_cast<inner_type *>(temp);
+    std::uint64_t childVersion;
+    node_type *child = read_child(iTemp, version, iTemp->upper_bound(key),
+                                  childVersion, pRestart);
+    if (pRestart) {
+      return false;
+    }
+    parent = iTemp;
+    parentVersion = version;
+    temp = child;
+    version = childVersion;
+  }
+
+  leaf_type *ltemp = static_cast<leaf_type *>(temp);
+  ltemp->mLock.upgrade(version, pRestart);
+  if (pRestart) {
+    return false;
+  }
+  int idx = ltemp->lower_bound(key);
+  bool present =
+      idx < ltemp->get_size() && !traits::less(key, ltemp->get_key(idx));
+  if (!present) {
+    ltemp->insert_at(idx, key, pRecord.get_value());
+  }
+  ltemp->mLock.write_unlock();
+  return !present;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::try_remove(
+    const Key &pKey, bool &pRestart) {
+  std::uint64_t version;
+  node_type *temp = read_root(version, pRestart);
+  if (pRestart) {
+    return false;
+  }
+  bool isRoot = true;
+  while (!temp->is_leaf()) {
+    inner_type *iTemp = static_cast<inner_type *>(temp);
+    if (isRoot && iTemp->get_size() == 0) {
+      // the root was left with a single child; that child becomes the root
+      iTemp->mLock.upgrade(version, pRestart);
+      if (pRestart) {
+        return false;
+      }
+      if (iTemp != mRoot.load(std::memory_order_relaxed)) {
+        iTemp->mLock.write_unlock();
+      } else {
+        mRoot.store(iTemp->get_child(0), std::memory_order_release);
+        iTemp->mLock.write_unlock_obsolete();
+        retire(iTemp);
+      }
+      pRestart = true;
+      return false;
+    }
+
+    int slot = iTemp->upper_bound(pKey);
+    std::uint64_t childVersion;
+    node_type *child =
+        read_child(iTemp, version, slot, childVersion, pRestart);
+    if (pRestart) {
+      return false;
+    }
+
+    if (child->get_size() <= traits::MIN_THRESHOLD && iTemp->get_size() > 0) {
+      // fix the child up against a sibling before going into it
+      int leftSlot = slot < iTemp->get_size() ? slot : slot - 1;
+      node_type *left, *right;
+      std::uint64_t leftVersion, rightVersion;
+      if (leftSlot == slot) {
+        left = child;
+        leftVersion = childVersion;
+        right = read_child(iTemp, version, leftSlot + 1, rightVersion,
+                           pRestart);
+      } else {
+        right = child;
+        rightVersion = childVersion;
+        left = read_child(iTemp, version, leftSlot, leftVersion, pRestart);
+      }
+      if (pRestart) {
+        return false;
+      }
+      // an inner merge also pulls the separator down
+      int total = left->get_size() + right->get_size() + !left->is_leaf();
+      bool canMerge = total <= traits::MAX_THRESHOLD;
+      bool uneven = std::abs(left->get_size() - right->get_size()) > 1;
+      if (canMerge || uneven) {
+        iTemp->mLock.upgrade(version, pRestart);
+        if (pRestart) {
+          return false;
+        }
+        left->mLock.upgrade(leftVersion, pRestart);
+        if (pRestart) {
+          iTemp->mLock.write_unlock();
+          return false;
+        }
+        right->mLock.upgrade(rightVersion, pRestart);
+        if (pRestart) {
+          left->mLock.write_unlock();
+          iTemp->mLock.write_unlock();
+          return false;
+        }
+        if (rebalance(iTemp, leftSlot, left, right)) {
+          right->mLock.write_unlock_obsolete();
+          retire(right);
+        } else {
+          right->mLock.write_unlock();
+        }
+        left->mLock.write_unlock();
+        iTemp->mLock.write_unlock();
+        pRestart = true;
+        return false;
+      }
+    }
+    temp = child;
+    version = childVersion;
+    isRoot = false;
+  }
+
+  leaf_type *ltemp = static_cast<leaf_type *>(temp);
+  ltemp->mLock.upgrade(version, pRestart);
+  if (pRestart) {
+    return false;
+  }
+  int idx = ltemp->lower_bound(pKey);
+  bool present =
+      idx < ltemp->get_size() && !traits::less(pKey, ltemp->get_key(idx));
+  if (present) {
+    ltemp->erase(idx);
+  }
+  ltemp->mLock.write_unlock();
+  return present;
+}
+
+// pNode and pParent (or the root pointer, if pParent is null) are locked
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void concurrent_bplustree<Key, Value, Compare, Fanout, Search>::split(
+    node_type *pNode, inner_type *pParent) {
+  Key separator;
+  node_type *n;
+  if (pNode->is_leaf()) {
+    leaf_type *lNew = new leaf_type();
+    separator = static_cast<leaf_type *>(pNode)->split_into(lNew);
+    n = lNew;
+  } else {
+    inner_type *iNew = new inner_type(nullptr);
+    separator = static_cast<inner_type *>(pNode)->split_into(iNew);
+    n = iNew;
+  }
+  if (pParent) {
+    pParent->insert_at(pParent->upper_bound(separator), separator, n);
+  } else {
+    inner_type *root = new inner_type(pNode);
+    root->insert_at(0, separator, n);
+    mRoot.store(root, std::memory_order_release);
+  }
+}
+
+// All three nodes are locked. Returns true if pRight was merged into pLeft
+// and unlinked from pParent.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::rebalance(
+    inner_type *pParent, int pLeftSlot, node_type *pLeft, node_type *pRight) {
+  int total = pLeft->get_size() + pRight->get_size() + !pLeft->is_leaf();
+  if (total <= traits::MAX_THRESHOLD) {
+    if (pLeft->is_leaf()) {
+      static_cast<leaf_type *>(pLeft)->merge_from(
+          static_cast<leaf_type *>(pRight));
+    } else {
+      static_cast<inner_type *>(pLeft)->merge_from(
+          static_cast<inner_type *>(pRight), pParent->get_key(pLeftSlot));
+    }
+    pParent->erase(pLeftSlot);
+    return true;
+  }
+  if (pLeft->is_leaf()) {
+    pParent->mKeys[pLeftSlot] = static_cast<leaf_type *>(pLeft)->redistribute(
+        static_cast<leaf_type *>(pRight));
+  } else {
+    pParent->mKeys[pLeftSlot] =
+        static_cast<inner_type *>(pLeft)->redistribute(
+            static_cast<inner_type *>(pRight), pParent->get_key(pLeftSlot));
+  }
+  return false;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void concurrent_bplustree<Key, Value, Compare, Fanout, Search>::retire(
+    node_type *pNode) {
+  mEpochs.retire(pNode, &delete_node);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void concurrent_bplustree<Key, Value, Compare, Fanout, Search>::delete_node(
+    void *pNode) {
+  node_type *n = static_cast<node_type *>(pNode);
+  if (n->is_leaf()) {
+    delete static_cast<leaf_type *>(n);
+  } else {
+    delete static_cast<inner_type *>(n);
+  }
+}
+
+// Child i holds the keys from key i - 1 inclusive up to key i exclusive.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool concurrent_bplustree<Key, Value, Compare, Fanout, Search>::verify_node(
+    const node_type *pNode, const Key *pLow, const Key *pHigh, int pDepth,
+    int &pLeafDepth, std::size_t &pRecords) {
+  bool restart = false;
+  pNode->mLock.read_lock(restart);
+  int size = pNode->get_size();
+  if (restart || size < 0 || size > node_type::CAPACITY) {
+    return false;
+  }
+  for (int i = 0; i < size; i++) {
+    const Key &key = pNode->get_key(i);
+    if ((i > 0 && !traits::less(pNode->get_key(i - 1), key)) ||
+        (pLow && traits::less(key, *pLow)) ||
+        (pHigh && !traits::less(key, *pHigh))) {
+      return false;
+    }
+  }
+  if (pNode->is_leaf()) {
+    if (pLeafDepth < 0) {
+      pLeafDepth = pDepth;
+    }
+    pRecords += size;
+    return pDepth == pLeafDepth;
+  }
+  const inner_type *iNode = static_cast<const inner_type *>(pNode);
+  for (int i = 0; i <= size; i++) {
+    const node_type *child = iNode->get_child(i);
+    if (!child ||
+        !verify_node(child, i > 0 ? &iNode->get_key(i - 1) : pLow,
+                     i < size ? &iNode->get_key(i) : pHigh, pDepth + 1,
+                     pLeafDepth, pRecords)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void concurrent_bplustree<Key, Value, Compare, Fanout, Search>::destroy_tree(
+    node_type *pNode) {
+  if (!pNode->is_leaf()) {
+    inner_type *iNode = static_cast<inner_type *>(pNode);
+    for (int i = 0; i <= iNode->get_size(); i++) {
+      destroy_tree(iNode->get_child(i));
+    }
+  }
+  delete_node(pNode);
+}
+
+} // namespace bpt
+
+#endif
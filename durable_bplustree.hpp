@@ -0,0 +1,121 @@
+#ifndef DURABLE_BPLUSTREE_HPP
+#define DURABLE_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+#include "write_ahead_log.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bpt {
+
+// bplustree whose contents survive a crash. Every insert and remove is
+// applied in memory and appended to a write-ahead log as a logical record;
+// the call returns once the record is on disk, and calls from different
+// threads that land close together share one fdatasync (group commit, see
+// write_ahead_log). A checkpoint writes all records to a snapshot file
+// and drops the log records it covers, either when asked to or once the
+// log has grown past a threshold. open() loads the last snapshot and replays the log behind
+// it.
+//
+// The tree lives in pPath.snapshot and pPath.wal. Searches run
+// concurrently; changes are applied one at a time but commit together.
+// A change is visible to searches as soon as it is applied, before its
+// record is on disk, so a search may see a change that a crash before the
+// commit loses, and one whose commit failed. A checkpoint copies the
+// records while holding changes back, then writes and syncs the copy
+// while searches and changes carry on. Keys and values are logged as
+// their bytes, so both have to be trivially copyable.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          int Fanout = 30, typename Search = simd_search_policy>
+class durable_bplustree {
+  static_assert(std::is_trivially_copyable<Key>::value &&
+                    std::is_trivially_copyable<Value>::value,
+                "the log holds keys and values as raw bytes");
+
+public:
+  typedef bplustree<Key, Value, Compare, Fanout, Search> tree_type;
+  typedef record<Key, Value> record_type;
+
+  static constexpr std::size_t DEFAULT_CHECKPOINT_BYTES = 64 << 20;
+
+  durable_bplustree();
+  durable_bplustree(const durable_bplustree &) = delete;
+  durable_bplustree &operator=(const durable_bplustree &) = delete;
+  ~durable_bplustree();
+
+  // Recovers the tree stored under pPath, or starts an empty one. False if
+  // the files cannot be opened or the snapshot is damaged.
+  bool open(const std::string &pPath);
+  // takes a checkpoint, then closes the log
+  void close();
+
+  // copies the value of pKey into pValue; false if pKey is absent
+  bool search(const Key &pKey, Value &pValue) const;
+  // False if the key is already present (insert) or absent (remove), or
+  // if the log could not be written; in the last case the change stays in
+  // memory but may not survive a crash. Searches see the change before
+  // the call returns.
+  bool insert(const record_type &pRecord);
+  bool remove(const Key &pKey);
+
+  // writes a snapshot and drops the log records it holds
+  bool checkpoint();
+  void set_commit_window(std::chrono::microseconds pWindow);
+  // log size that triggers a checkpoint; 0 leaves checkpoints to the caller
+  void set_checkpoint_threshold(std::size_t pBytes);
+
+  std::size_t get_log_size() const;
+
+private:
+  enum log_operation : char { LOG_INSERT = 1, LOG_REMOVE = 2 };
+
+  struct snapshot_header {
+    std::uint64_t mMagic;
+    std::uint32_t mVersion;
+    std::uint32_t mKeySize;
+    std::uint32_t mValueSize;
+    // CRC-32 of everything behind the header
+    std::uint32_t mChecksum;
+    // last log record the snapshot contains
+    std::uint64_t mLsn;
+    std::uint64_t mCount;
+  };
+
+  static constexpr std::uint64_t SNAPSHOT_MAGIC = 0x3130706e73747062;
+  static constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+  // returns the LSN of the snapshot, or false if it is damaged
+  bool load_snapshot(std::uint64_t &pLsn);
+  bool save_snapshot(const std::vector<record_type> &pRecords,
+                     std::uint64_t pLsn) const;
+  void replay(const char *pPayload, std::size_t pSize);
+  // waits for pLsn, then takes a checkpoint if the log has grown too long
+  bool commit(std::uint64_t pLsn);
+  // checkpoint() with mCheckpointing already held
+  bool write_checkpoint();
+  std::string get_snapshot_path() const;
+  std::string get_log_path() const;
+
+  tree_type mTree;
+  write_ahead_log mLog;
+  // shared by searches and the copy a checkpoint takes, exclusive for
+  // changes
+  mutable std::shared_mutex mMutex;
+  // one checkpoint at a time
+  std::mutex mCheckpointing;
+  std::string mPath;
+  std::atomic<std::size_t> mCheckpointBytes;
+};
+
+} // namespace bpt
+
+#include "durable_bplustree_impl.hpp"
+
+#endif
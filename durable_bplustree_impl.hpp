@@ -0,0 +1,318 @@
+#ifndef DURABLE_BPLUSTREE_IMPL_HPP
+#define DURABLE_BPLUSTREE_IMPL_HPP
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bpt {
+
+// durable_bplustree class ////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+durable_bplustree<Key, Value, Compare, Fanout, Search>::durable_bplustree()
+    : mCheckpointBytes(DEFAULT_CHECKPOINT_BYTES) {}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+durable_bplustree<Key, Value, Compare, Fanout, Search>::~durable_bplustree() {
+  close();
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::open(
+    const std::string &pPath) {
+  close();
+  std::unique_lock<std::shared_mutex> lock(mMutex);
+  mPath = pPath;
+  std::uint64_t lsn;
+  if (!load_snapshot(lsn)) {
+    return false;
+  }
+  return mLog.open(get_log_path(), lsn,
+                   [this](std::uint64_t, const char *pPayload,
+                          std::size_t pSize) { replay(pPayload, pSize); });
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void durable_bplustree<Key, Value, Compare, Fanout, Search>::close() {
+  if (!mLog.is_open()) {
+    return;
+  }
+  checkpoint();
+  mLog.close();
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::search(
+    const Key &pKey, Value &pValue) const {
+  std::shared_lock<std::shared_mutex> lock(mMutex);
+  const Value *value = mTree.search(pKey);
+  if (!value) {
+    return false;
+  }
+  pValue = *value;
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::insert(
+    const record_type &pRecord) {
+  char payload[1 + sizeof(Key) + sizeof(Value)];
+  payload[0] = LOG_INSERT;
+  std::memcpy(payload + 1, &pRecord.get_key(), sizeof(Key));
+  std::memcpy(payload + 1 + sizeof(Key), &pRecord.get_value(), sizeof(Value));
+  std::uint64_t lsn;
+  {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (mTree.search(pRecord.get_key())) {
+      return false;
+    }
+    mTree.insert(pRecord);
+    lsn = mLog.append(payload, sizeof(payload));
+  }
+  return commit(lsn);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::remove(
+    const Key &pKey) {
+  char payload[1 + sizeof(Key)];
+  payload[0] = LOG_REMOVE;
+  std::memcpy(payload + 1, &pKey, sizeof(Key));
+  std::uint64_t lsn;
+  {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (!mTree.remove(pKey)) {
+      return false;
+    }
+    lsn = mLog.append(payload, sizeof(payload));
+  }
+  return commit(lsn);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::checkpoint() {
+  std::lock_guard<std::mutex> checkpointing(mCheckpointing);
+  return write_checkpoint();
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void durable_bplustree<Key, Value, Compare, Fanout, Search>::set_commit_window(
+    std::chrono::microseconds pWindow) {
+  mLog.set_commit_window(pWindow);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void durable_bplustree<Key, Value, Compare, Fanout,
+                       Search>::set_checkpoint_threshold(std::size_t pBytes) {
+  mCheckpointBytes = pBytes;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+durable_bplustree<Key, Value, Compare, Fanout, Search>::get_log_size() const {
+  return mLog.get_size();
+}
+
+// A missing snapshot is an empty tree at LSN 0.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::load_snapshot(
+    std::uint64_t &pLsn) {
+  std::vector<record_type> records;
+  pLsn = 0;
+  int fd = ::open(get_snapshot_path().c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    std::vector<char> bytes;
+    if (fstat(fd, &st) == 0) {
+      bytes.resize(st.st_size);
+    }
+    std::size_t read = 0;
+    while (read < bytes.size()) {
+      ssize_t n = pread(fd, bytes.data() + read, bytes.size() - read, read);
+      if (n <= 0) {
+        break;
+      }
+      read += n;
+    }
+    ::close(fd);
+
+    snapshot_header header;
+    const std::size_t recordSize = sizeof(Key) + sizeof(Value);
+    if (read < sizeof(snapshot_header) || read != bytes.size()) {
+      return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(snapshot_header));
+    const char *body = bytes.data() + sizeof(snapshot_header);
+    std::size_t bodySize = read - sizeof(snapshot_header);
+    if (header.mMagic != SNAPSHOT_MAGIC ||
+        header.mVersion != SNAPSHOT_VERSION ||
+        header.mKeySize != sizeof(Key) ||
+        header.mValueSize != sizeof(Value) ||
+        bodySize != header.mCount * recordSize ||
+        header.mChecksum != crc32(body, bodySize)) {
+      return false;
+    }
+    records.reserve(header.mCount);
+    for (std::size_t i = 0; i < header.mCount; i++) {
+      Key key;
+      Value value;
+      std::memcpy(&key, body + i * recordSize, sizeof(Key));
+      std::memcpy(&value, body + i * recordSize + sizeof(Key), sizeof(Value));
+      records.emplace_back(key, value);
+    }
+    pLsn = header.mLsn;
+  } else if (errno != ENOENT) {
+    return false;
+  }
+  return mTree.bulk_load(records.begin(), records.end());
+}
+
+// Writes the records to a temporary file and renames it over the old
+// snapshot once it is on disk, so a crash leaves one whole snapshot or the
+// other.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::save_snapshot(
+    const std::vector<record_type> &pRecords, std::uint64_t pLsn) const {
+  std::string path = get_snapshot_path(), temporary = path + ".tmp";
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  snapshot_header header = snapshot_header();
+  header.mMagic = SNAPSHOT_MAGIC;
+  header.mVersion = SNAPSHOT_VERSION;
+  header.mKeySize = sizeof(Key);
+  header.mValueSize = sizeof(Value);
+  header.mLsn = pLsn;
+
+  // the body goes out in chunks behind room left for the header
+  std::vector<char> chunk;
+  std::size_t offset = sizeof(snapshot_header);
+  bool ok = true;
+  auto writeChunk = [&]() {
+    std::size_t written = 0;
+    while (ok && written < chunk.size()) {
+      ssize_t n = pwrite(fd, chunk.data() + written, chunk.size() - written,
+                         offset + written);
+      ok = n > 0;
+      written += ok ? n : 0;
+    }
+    header.mChecksum = crc32(chunk.data(), chunk.size(), header.mChecksum);
+    offset += chunk.size();
+    chunk.clear();
+  };
+  for (const record_type &r : pRecords) {
+    const char *key = reinterpret_cast<const char *>(&r.get_key());
+    const char *value = reinterpret_cast<const char *>(&r.get_value());
+    chunk.insert(chunk.end(), key, key + sizeof(Key));
+    chunk.insert(chunk.end(), value, value + sizeof(Value));
+    header.mCount++;
+    if (chunk.size() >= (1 << 20)) {
+      writeChunk();
+    }
+  }
+  writeChunk();
+  ok = ok &&
+       pwrite(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+       fsync(fd) == 0;
+  ok = ::close(fd) == 0 && ok &&
+       std::rename(temporary.c_str(), path.c_str()) == 0;
+  // make the rename itself durable
+  return ok && sync_directory(path);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void durable_bplustree<Key, Value, Compare, Fanout, Search>::replay(
+    const char *pPayload, std::size_t pSize) {
+  Key key;
+  if (pSize < 1 + sizeof(Key)) {
+    return;
+  }
+  std::memcpy(&key, pPayload + 1, sizeof(Key));
+  if (pPayload[0] == LOG_INSERT && pSize == 1 + sizeof(Key) + sizeof(Value)) {
+    Value value;
+    std::memcpy(&value, pPayload + 1 + sizeof(Key), sizeof(Value));
+    if (!mTree.search(key)) {
+      mTree.insert(record_type(key, value));
+    }
+  } else if (pPayload[0] == LOG_REMOVE) {
+    mTree.remove(key);
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout, Search>::commit(
+    std::uint64_t pLsn) {
+  bool ok = mLog.commit(pLsn);
+  std::size_t threshold = mCheckpointBytes;
+  if (threshold > 0 && mLog.get_size() > threshold) {
+    std::unique_lock<std::mutex> checkpointing(mCheckpointing,
+                                               std::try_to_lock);
+    // a checkpoint under way will shrink the log, or another writer may
+    // have taken one meanwhile
+    if (checkpointing && mLog.get_size() > threshold) {
+      write_checkpoint();
+    }
+  }
+  return ok;
+}
+
+// Changes append to the log under the exclusive lock, so the copy taken
+// under the shared lock holds exactly the records up to the last LSN, and
+// the log size read with it is where the records behind that LSN start.
+// The snapshot is written from the copy with no lock held.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool durable_bplustree<Key, Value, Compare, Fanout,
+                       Search>::write_checkpoint() {
+  std::vector<record_type> records;
+  std::uint64_t lsn;
+  std::size_t logSize;
+  {
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    records.assign(mTree.begin(), mTree.end());
+    lsn = mLog.get_last_lsn();
+    logSize = mLog.get_size();
+  }
+  return save_snapshot(records, lsn) && mLog.truncate(lsn, logSize);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::string
+durable_bplustree<Key, Value, Compare, Fanout, Search>::get_snapshot_path()
+    const {
+  return mPath + ".snapshot";
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::string
+durable_bplustree<Key, Value, Compare, Fanout, Search>::get_log_path() const {
+  return mPath + ".wal";
+}
+
+} // namespace bpt
+
+#endif
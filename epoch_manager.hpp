@@ -0,0 +1,211 @@
+#ifndef EPOCH_MANAGER_HPP
+#define EPOCH_MANAGER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace bpt {
+
+namespace detail {
+
+// Hands every live thread a small index that no other live thread holds.
+// The index is returned when the thread exits, so a long-running process
+// that keeps starting threads reuses the same few indices.
+class thread_registry {
+public:
+  static constexpr std::size_t MAX_THREADS = 256;
+
+  static std::size_t get_index() {
+    thread_local holder h;
+    return h.mIndex;
+  }
+
+private:
+  struct holder {
+    holder() : mIndex(acquire()) {}
+    ~holder() { release(mIndex); }
+    std::size_t mIndex;
+  };
+
+  static std::mutex &get_mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::vector<bool> &get_used() {
+    static std::vector<bool> used(MAX_THREADS, false);
+    return used;
+  }
+
+  static std::size_t acquire() {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    std::vector<bool> &used = get_used();
+    for (std::size_t i = 0; i < MAX_THREADS; i++) {
+      if (!used[i]) {
+        used[i] = true;
+        return i;
+      }
+    }
+    throw std::length_error("bpt: too many live threads");
+  }
+
+  static void release(std::size_t pIndex) {
+    std::lock_guard<std::mutex> lock(get_mutex());
+    get_used()[pIndex] = false;
+  }
+};
+
+} // namespace detail
+
+// Epoch-based reclamation for lock-free readers. A thread wraps every
+// access to shared nodes in a guard, which publishes the global epoch the
+// thread entered in. An object that has been unlinked is handed to
+// retire() together with the epoch current at that moment, and is only
+// deleted once every thread still inside a guard entered in a later epoch:
+// such a thread started after the unlink and cannot hold a pointer to it.
+//
+// Retired objects are kept per thread and swept every RECLAIM_BATCH
+// retirements; whatever is still pending when the manager is destroyed is
+// deleted then, so the manager must outlive every guard on it.
+class epoch_manager {
+public:
+  class guard {
+  public:
+    explicit guard(epoch_manager &pManager);
+    guard(const guard &) = delete;
+    guard &operator=(const guard &) = delete;
+    ~guard();
+
+  private:
+    epoch_manager &mManager;
+  };
+
+  epoch_manager();
+  epoch_manager(const epoch_manager &) = delete;
+  epoch_manager &operator=(const epoch_manager &) = delete;
+  ~epoch_manager();
+
+  // pDeleter(pObject) runs once no guard can still reach pObject
+  void retire(void *pObject, void (*pDeleter)(void *));
+  std::size_t get_pending_count() const;
+
+private:
+  struct retired {
+    void *mObject;
+    void (*mDeleter)(void *);
+    std::uint64_t mEpoch;
+  };
+
+  // written by the owning thread only, except mEpoch which others scan
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> mEpoch;
+    int mDepth;
+    std::vector<retired> mRetired;
+  };
+
+  static constexpr std::uint64_t QUIESCENT = 0;
+  static constexpr std::size_t RECLAIM_BATCH = 64;
+
+  slot &get_slot();
+  void enter();
+  void exit();
+  std::uint64_t get_oldest_epoch() const;
+  void reclaim(slot &pSlot);
+
+  std::atomic<std::uint64_t> mGlobal;
+  slot mSlots[detail::thread_registry::MAX_THREADS];
+};
+
+inline epoch_manager::guard::guard(epoch_manager &pManager)
+    : mManager(pManager) {
+  mManager.enter();
+}
+
+inline epoch_manager::guard::~guard() { mManager.exit(); }
+
+inline epoch_manager::epoch_manager() : mGlobal(1) {
+  for (slot &s : mSlots) {
+    s.mEpoch.store(QUIESCENT, std::memory_order_relaxed);
+    s.mDepth = 0;
+  }
+}
+
+inline epoch_manager::~epoch_manager() {
+  for (slot &s : mSlots) {
+    for (const retired &r : s.mRetired) {
+      r.mDeleter(r.mObject);
+    }
+  }
+}
+
+inline void epoch_manager::retire(void *pObject, void (*pDeleter)(void *)) {
+  slot &s = get_slot();
+  // threads that enter from now on see the new epoch and never the object
+  std::uint64_t epoch = mGlobal.fetch_add(1, std::memory_order_seq_cst);
+  s.mRetired.push_back(retired{pObject, pDeleter, epoch});
+  if (s.mRetired.size() >= RECLAIM_BATCH) {
+    reclaim(s);
+  }
+}
+
+inline std::size_t epoch_manager::get_pending_count() const {
+  std::size_t count = 0;
+  for (const slot &s : mSlots) {
+    count += s.mRetired.size();
+  }
+  return count;
+}
+
+inline epoch_manager::slot &epoch_manager::get_slot() {
+  return mSlots[detail::thread_registry::get_index()];
+}
+
+inline void epoch_manager::enter() {
+  slot &s = get_slot();
+  if (s.mDepth++ == 0) {
+    s.mEpoch.store(mGlobal.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    // the announcement must be visible before any shared pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+inline void epoch_manager::exit() {
+  slot &s = get_slot();
+  if (--s.mDepth == 0) {
+    s.mEpoch.store(QUIESCENT, std::memory_order_release);
+  }
+}
+
+inline std::uint64_t epoch_manager::get_oldest_epoch() const {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::uint64_t oldest = UINT64_MAX;
+  for (const slot &s : mSlots) {
+    std::uint64_t epoch = s.mEpoch.load(std::memory_order_acquire);
+    if (epoch != QUIESCENT && epoch < oldest) {
+      oldest = epoch;
+    }
+  }
+  return oldest;
+}
+
+inline void epoch_manager::reclaim(slot &pSlot) {
+  std::uint64_t oldest = get_oldest_epoch();
+  std::size_t kept = 0;
+  for (const retired &r : pSlot.mRetired) {
+    if (r.mEpoch < oldest) {
+      r.mDeleter(r.mObject);
+    } else {
+      pSlot.mRetired[kept++] = r;
+    }
+  }
+  pSlot.mRetired.resize(kept);
+}
+
+} // namespace bpt
+
+#endif
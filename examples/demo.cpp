@@ -0,0 +1,27 @@
+#include "bplustree.hpp"
+
+#include <iostream>
+
+int main() {
+  bpt::bplustree<int, int> bt;
+
+  int n = 1000;
+
+  for (int i = 0; i < n; i++) {
+    bpt::record<int, int> r(i, i);
+    bt.insert(r);
+  }
+
+  for (int i = n - 1; i >= 0; i--) {
+    if (i % 5 == 0) {
+      std::cout << "deleting: " << i << std::endl;
+      bt.remove(i);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!bt.search(i)) {
+      std::cout << "key: " << i << " deleted" << std::endl;
+    }
+  }
+}
@@ -0,0 +1,245 @@
+#ifndef KEY_SEARCH_HPP
+#define KEY_SEARCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BPLUSTREE_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace bpt {
+
+// Search policies locate a key inside the sorted key array of one node.
+// lower_bound returns the index of the first key not less than pKey and
+// upper_bound the index of the first key greater than pKey. The key array
+// handed to a policy starts on a cache line and is padded to a whole number
+// of cache lines, so a policy may read past pSize up to the end of the line
+// that holds the last key.
+
+// std::lower_bound/std::upper_bound over the keys, usable with any key type
+struct binary_search_policy {
+  template <typename Key, typename Compare>
+  static int lower_bound(const Key *pKeys, int pSize, const Key &pKey,
+                         Compare pCompare) {
+    return std::lower_bound(pKeys, pKeys + pSize, pKey, pCompare) - pKeys;
+  }
+
+  template <typename Key, typename Compare>
+  static int upper_bound(const Key *pKeys, int pSize, const Key &pKey,
+                         Compare pCompare) {
+    return std::upper_bound(pKeys, pKeys + pSize, pKey, pCompare) - pKeys;
+  }
+};
+
+namespace detail {
+
+enum simd_level { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 };
+
+inline simd_level detect_simd_level() {
+#ifdef BPLUSTREE_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SIMD_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return SIMD_SSE;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+inline simd_level get_simd_level() {
+  static const simd_level level = detect_simd_level();
+  return level;
+}
+
+// Kernels count the keys below the probe. With pInclusive they count the
+// keys less than or equal to the probe instead.
+
+template <typename Int>
+int count_scalar(const Int *pKeys, int pSize, Int pKey, bool pInclusive) {
+  int count = 0;
+  if (pInclusive) {
+    for (int i = 0; i < pSize; i++) {
+      count += !(pKey < pKeys[i]);
+    }
+  } else {
+    for (int i = 0; i < pSize; i++) {
+      count += pKeys[i] < pKey;
+    }
+  }
+  return count;
+}
+
+#ifdef BPLUSTREE_X86_DISPATCH
+// lanes at or past pSize are cleared from the compare mask
+inline unsigned lane_mask(int pLanes, int pSize, int pIndex) {
+  int valid = pSize - pIndex;
+  return valid >= pLanes ? (1u << pLanes) - 1 : (1u << valid) - 1;
+}
+
+__attribute__((target("sse4.2"))) inline int
+count_sse(const int32_t *pKeys, int pSize, int32_t pKey, bool pInclusive) {
+  const __m128i *keys = reinterpret_cast<const __m128i *>(pKeys);
+  const __m128i probe = _mm_set1_epi32(pKey);
+  int count = 0;
+  for (int i = 0; i < pSize; i += 4) {
+    __m128i k = _mm_load_si128(keys++);
+    __m128i hit =
+        pInclusive ? _mm_cmpgt_epi32(k, probe) : _mm_cmpgt_epi32(probe, k);
+    unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+    if (pInclusive) {
+      mask = ~mask;
+    }
+    count += __builtin_popcount(mask & lane_mask(4, pSize, i));
+  }
+  return count;
+}
+
+__attribute__((target("sse4.2"))) inline int
+count_sse(const int64_t *pKeys, int pSize, int64_t pKey, bool pInclusive) {
+  const __m128i *keys = reinterpret_cast<const __m128i *>(pKeys);
+  const __m128i probe = _mm_set1_epi64x(pKey);
+  int count = 0;
+  for (int i = 0; i < pSize; i += 2) {
+    __m128i k = _mm_load_si128(keys++);
+    __m128i hit =
+        pInclusive ? _mm_cmpgt_epi64(k, probe) : _mm_cmpgt_epi64(probe, k);
+    unsigned mask = _mm_movemask_pd(_mm_castsi128_pd(hit));
+    if (pInclusive) {
+      mask = ~mask;
+    }
+    count += __builtin_popcount(mask & lane_mask(2, pSize, i));
+  }
+  return count;
+}
+
+__attribute__((target("avx2"))) inline int
+count_avx2(const int32_t *pKeys, int pSize, int32_t pKey, bool pInclusive) {
+  const __m256i *keys = reinterpret_cast<const __m256i *>(pKeys);
+  const __m256i probe = _mm256_set1_epi32(pKey);
+  int count = 0;
+  for (int i = 0; i < pSize; i += 8) {
+    __m256i k = _mm256_load_si256(keys++);
+    __m256i hit = pInclusive ? _mm256_cmpgt_epi32(k, probe)
+                             : _mm256_cmpgt_epi32(probe, k);
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+    if (pInclusive) {
+      mask = ~mask;
+    }
+    count += __builtin_popcount(mask & lane_mask(8, pSize, i));
+  }
+  return count;
+}
+
+__attribute__((target("avx2"))) inline int
+count_avx2(const int64_t *pKeys, int pSize, int64_t pKey, bool pInclusive) {
+  const __m256i *keys = reinterpret_cast<const __m256i *>(pKeys);
+  const __m256i probe = _mm256_set1_epi64x(pKey);
+  int count = 0;
+  for (int i = 0; i < pSize; i += 4) {
+    __m256i k = _mm256_load_si256(keys++);
+    __m256i hit = pInclusive ? _mm256_cmpgt_epi64(k, probe)
+                             : _mm256_cmpgt_epi64(probe, k);
+    unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(hit));
+    if (pInclusive) {
+      mask = ~mask;
+    }
+    count += __builtin_popcount(mask & lane_mask(4, pSize, i));
+  }
+  return count;
+}
+#endif
+
+// Large nodes are first narrowed by binary search to a window of two cache
+// lines, which the vector kernels then count in one pass. The window start
+// is rounded down to a vector boundary so that the kernels can use aligned
+// loads. The vector kernels only load the keys as vectors, so any 32- or
+// 64-bit signed integer type can be viewed as the lane type of that width.
+template <typename Key>
+int count_keys(const Key *pKeys, int pSize, Key pKey, bool pInclusive) {
+  const int window = 128 / sizeof(Key);
+  int lo = 0, hi = pSize;
+  while (hi - lo > window) {
+    int mid = lo + (hi - lo) / 2;
+    if (pInclusive ? !(pKey < pKeys[mid]) : pKeys[mid] < pKey) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+#ifdef BPLUSTREE_X86_DISPATCH
+  typedef typename std::conditional<sizeof(Key) == 4, int32_t, int64_t>::type
+      lane_type;
+  const lane_type probe = static_cast<lane_type>(pKey);
+  const lane_type *keys = reinterpret_cast<const lane_type *>(pKeys);
+  int base;
+  switch (get_simd_level()) {
+  case SIMD_AVX2:
+    base = lo & ~(32 / int(sizeof(Key)) - 1);
+    return base + count_avx2(keys + base, hi - base, probe, pInclusive);
+  case SIMD_SSE:
+    base = lo & ~(16 / int(sizeof(Key)) - 1);
+    return base + count_sse(keys + base, hi - base, probe, pInclusive);
+  default:
+    break;
+  }
+#endif
+  return lo + count_scalar(pKeys + lo, hi - lo, pKey, pInclusive);
+}
+
+template <typename Key, typename Compare>
+struct is_simd_searchable
+    : std::integral_constant<
+          bool, std::is_integral<Key>::value && std::is_signed<Key>::value &&
+                    (sizeof(Key) == 4 || sizeof(Key) == 8) &&
+                    (std::is_same<Compare, std::less<Key>>::value ||
+                     std::is_same<Compare, std::less<>>::value)> {};
+
+} // namespace detail
+
+// Counts the keys below the probe across the whole node with SIMD compares
+// instead of branching through a binary search. It applies to 32- and 64-bit
+// signed integer keys ordered by std::less; any other key type or comparator
+// falls back to binary_search_policy. The instruction set (AVX2, SSE4.2 or a
+// scalar loop) is picked once at runtime.
+struct simd_search_policy {
+  template <typename Key, typename Compare>
+  static int lower_bound(const Key *pKeys, int pSize, const Key &pKey,
+                         Compare pCompare) {
+    return search(pKeys, pSize, pKey, pCompare, false,
+                  detail::is_simd_searchable<Key, Compare>());
+  }
+
+  template <typename Key, typename Compare>
+  static int upper_bound(const Key *pKeys, int pSize, const Key &pKey,
+                         Compare pCompare) {
+    return search(pKeys, pSize, pKey, pCompare, true,
+                  detail::is_simd_searchable<Key, Compare>());
+  }
+
+private:
+  template <typename Key, typename Compare>
+  static int search(const Key *pKeys, int pSize, const Key &pKey,
+                    Compare pCompare, bool pInclusive, std::false_type) {
+    if (pInclusive) {
+      return binary_search_policy::upper_bound(pKeys, pSize, pKey, pCompare);
+    } else {
+      return binary_search_policy::lower_bound(pKeys, pSize, pKey, pCompare);
+    }
+  }
+
+  template <typename Key, typename Compare>
+  static int search(const Key *pKeys, int pSize, const Key &pKey, Compare,
+                    bool pInclusive, std::true_type) {
+    return detail::count_keys(pKeys, pSize, pKey, pInclusive);
+  }
+};
+
+} // namespace bpt
+
+#endif
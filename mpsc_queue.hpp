@@ -0,0 +1,84 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace bpt {
+
+// Unbounded multi-producer single-consumer queue (Vyukov). Producers link
+// a new cell behind the head with one atomic exchange and never wait on
+// each other or on the consumer; the consumer unlinks cells from the tail
+// without any atomic read-modify-write. The consumed cell stays behind as
+// the stub the next one hangs off, so T must be default constructible.
+//
+// A producer that has exchanged the head but not linked its cell yet
+// briefly hides every cell behind it, so pop() can fail on a queue that is
+// about to become non-empty; consumers simply retry.
+template <typename T> class mpsc_queue {
+public:
+  mpsc_queue();
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+  ~mpsc_queue();
+
+  // any thread
+  void push(T pValue);
+  // the consumer thread only
+  bool pop(T &pValue);
+  bool is_empty() const;
+
+private:
+  struct cell {
+    cell() : mNext(nullptr), mValue() {}
+    explicit cell(T pValue) : mNext(nullptr), mValue(std::move(pValue)) {}
+
+    std::atomic<cell *> mNext;
+    T mValue;
+  };
+
+  // producers and the consumer work on different cache lines
+  alignas(64) std::atomic<cell *> mHead;
+  alignas(64) cell *mTail;
+};
+
+template <typename T> mpsc_queue<T>::mpsc_queue() {
+  cell *stub = new cell();
+  mHead.store(stub, std::memory_order_relaxed);
+  mTail = stub;
+}
+
+template <typename T> mpsc_queue<T>::~mpsc_queue() {
+  while (mTail) {
+    cell *next = mTail->mNext.load(std::memory_order_relaxed);
+    delete mTail;
+    mTail = next;
+  }
+}
+
+template <typename T> void mpsc_queue<T>::push(T pValue) {
+  cell *c = new cell(std::move(pValue));
+  cell *prev = mHead.exchange(c, std::memory_order_acq_rel);
+  // sequentially consistent, so that a consumer going to sleep either sees
+  // the cell or is seen sleeping by the producer afterwards
+  prev->mNext.store(c, std::memory_order_seq_cst);
+}
+
+template <typename T> bool mpsc_queue<T>::pop(T &pValue) {
+  cell *next = mTail->mNext.load(std::memory_order_acquire);
+  if (!next) {
+    return false;
+  }
+  pValue = std::move(next->mValue);
+  delete mTail;
+  mTail = next;
+  return true;
+}
+
+template <typename T> bool mpsc_queue<T>::is_empty() const {
+  return mTail->mNext.load(std::memory_order_seq_cst) == nullptr;
+}
+
+} // namespace bpt
+
+#endif
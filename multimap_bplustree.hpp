@@ -0,0 +1,170 @@
+#ifndef MULTIMAP_BPLUSTREE_HPP
+#define MULTIMAP_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace bpt {
+
+// Sorted set of integer values, such as the row ids one key of a secondary
+// index points to. Up to INLINE_CAPACITY values sit in the object itself.
+// Longer lists spill into an overflow block of chunks, each holding up to
+// CHUNK_CAPACITY values as its first value followed by the varint-encoded
+// differences to the value before, so dense ids take a byte or two each.
+// A change decodes and encodes one chunk only, and appending a value past
+// the end of its chunk, as ascending row ids do, writes just its delta.
+template <typename Value> class posting_list {
+  static_assert(std::is_integral<Value>::value &&
+                    !std::is_same<Value, bool>::value,
+                "posting lists store values as differences of integers");
+
+public:
+  class const_iterator;
+
+  static constexpr int INLINE_CAPACITY = 16 / int(sizeof(Value));
+  static constexpr int CHUNK_CAPACITY = 128;
+
+  posting_list();
+  posting_list(const posting_list &pOther);
+  posting_list(posting_list &&pOther) noexcept;
+  posting_list &operator=(const posting_list &pOther);
+  posting_list &operator=(posting_list &&pOther) noexcept;
+  ~posting_list();
+
+  std::size_t get_size() const;
+  bool contains(const Value &pValue) const;
+  // false if the value is already in the list
+  bool insert(const Value &pValue);
+  // false if the value is not in the list
+  bool erase(const Value &pValue);
+  // ascending order; any change invalidates every iterator
+  const_iterator begin() const;
+  const_iterator end() const;
+  // bytes of the overflow block, if any
+  std::size_t get_heap_bytes() const;
+
+private:
+  typedef typename std::make_unsigned<Value>::type delta_type;
+
+  struct chunk {
+    Value mFirst;
+    Value mLast;
+    int mCount;
+    // the differences of values 1 to mCount - 1 to the value before
+    std::vector<unsigned char> mDeltas;
+  };
+
+  struct overflow_block {
+    // ordered by mFirst, none empty
+    std::vector<chunk> mChunks;
+  };
+
+  static void encode(chunk &pChunk, const Value *pValues, int pCount);
+  static void append_delta(std::vector<unsigned char> &pBytes,
+                           delta_type pDelta);
+  static void decode(const chunk &pChunk, Value *pValues);
+  static delta_type read_delta(const unsigned char *pBytes,
+                               std::size_t &pOffset);
+  // the chunk pValue belongs in: the last one starting at or before it
+  std::size_t find_chunk(const Value &pValue) const;
+  // moves pCount sorted values into a new overflow block
+  void spill(const Value *pValues, int pCount);
+  // moves the values back inline once few enough are left
+  void unspill();
+  void release();
+
+  std::uint32_t mSize;
+  bool mSpilled;
+  union {
+    Value mInline[INLINE_CAPACITY];
+    overflow_block *mBlock;
+  };
+};
+
+// Forward iterator decoding a posting list on the fly.
+template <typename Value> class posting_list<Value>::const_iterator {
+  friend class posting_list;
+
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef Value value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef void pointer;
+  typedef Value reference;
+
+  const_iterator();
+  Value operator*() const;
+  const_iterator &operator++();
+  const_iterator operator++(int);
+  bool operator==(const const_iterator &pOther) const;
+  bool operator!=(const const_iterator &pOther) const;
+
+private:
+  const_iterator(const posting_list *pList, std::size_t pChunk);
+  // chunks of the list; an inline list counts as one
+  std::size_t get_chunk_count() const;
+  void enter_chunk();
+
+  const posting_list *mList;
+  std::size_t mChunk;
+  // position within the chunk, and of the next delta in its bytes
+  int mIndex;
+  std::size_t mOffset;
+  Value mValue;
+};
+
+// Secondary-index style multimap: every distinct key is stored once in a
+// bplustree whose value is the posting_list of the values under that key,
+// so a key with many values costs one leaf slot plus a byte or two per
+// value, and finding all of them takes one descent. Pairs are unique: a
+// key holds each value at most once.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          int Fanout = 30, typename Search = simd_search_policy>
+class multimap_bplustree {
+public:
+  typedef bplustree<Key, posting_list<Value>, Compare, Fanout, Search>
+      tree_type;
+  typedef record<Key, Value> record_type;
+  typedef typename posting_list<Value>::const_iterator value_iterator;
+  typedef iterator_range<value_iterator> value_range;
+
+  multimap_bplustree();
+  multimap_bplustree(const multimap_bplustree &) = delete;
+  multimap_bplustree &operator=(const multimap_bplustree &) = delete;
+
+  // false, leaving the map unchanged, if the pair is already present
+  bool insert(const record_type &pRecord);
+  // removes one pair; false if it is absent
+  bool remove(const Key &pKey, const Value &pValue);
+  // removes every value of pKey and returns how many there were
+  std::size_t remove(const Key &pKey);
+  bool contains(const Key &pKey, const Value &pValue) const;
+  std::size_t count(const Key &pKey) const;
+  // The values of pKey in ascending order, empty if there are none. Any
+  // change to the map invalidates the range.
+  value_range equal_range(const Key &pKey) const;
+
+  // pairs stored
+  std::size_t get_size() const;
+  // distinct keys stored
+  std::size_t get_key_count() const;
+  // bytes of the nodes in use and of the overflow blocks; walks every
+  // posting list
+  std::size_t get_memory_usage() const;
+
+private:
+  tree_type mTree;
+  std::size_t mSize;
+  std::size_t mKeyCount;
+};
+
+} // namespace bpt
+
+#include "multimap_bplustree_impl.hpp"
+
+#endif
@@ -0,0 +1,494 @@
+#ifndef MULTIMAP_BPLUSTREE_IMPL_HPP
+#define MULTIMAP_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+
+namespace bpt {
+
+// posting_list class /////////////////////////////////////////////////////////
+template <typename Value>
+posting_list<Value>::posting_list() : mSize(0), mSpilled(false), mInline() {}
+
+template <typename Value>
+posting_list<Value>::posting_list(const posting_list &pOther)
+    : mSize(pOther.mSize), mSpilled(pOther.mSpilled) {
+  if (mSpilled) {
+    mBlock = new overflow_block(*pOther.mBlock);
+  } else {
+    std::copy(pOther.mInline, pOther.mInline + INLINE_CAPACITY, mInline);
+  }
+}
+
+template <typename Value>
+posting_list<Value>::posting_list(posting_list &&pOther) noexcept
+    : mSize(pOther.mSize), mSpilled(pOther.mSpilled) {
+  if (mSpilled) {
+    mBlock = pOther.mBlock;
+  } else {
+    std::copy(pOther.mInline, pOther.mInline + INLINE_CAPACITY, mInline);
+  }
+  pOther.mSize = 0;
+  pOther.mSpilled = false;
+}
+
+template <typename Value>
+posting_list<Value> &
+posting_list<Value>::operator=(const posting_list &pOther) {
+  if (&pOther != this) {
+    *this = posting_list(pOther);
+  }
+  return *this;
+}
+
+template <typename Value>
+posting_list<Value> &
+posting_list<Value>::operator=(posting_list &&pOther) noexcept {
+  if (&pOther != this) {
+    release();
+    mSize = pOther.mSize;
+    mSpilled = pOther.mSpilled;
+    if (mSpilled) {
+      mBlock = pOther.mBlock;
+    } else {
+      std::copy(pOther.mInline, pOther.mInline + INLINE_CAPACITY, mInline);
+    }
+    pOther.mSize = 0;
+    pOther.mSpilled = false;
+  }
+  return *this;
+}
+
+template <typename Value> posting_list<Value>::~posting_list() { release(); }
+
+template <typename Value> std::size_t posting_list<Value>::get_size() const {
+  return mSize;
+}
+
+template <typename Value>
+bool posting_list<Value>::contains(const Value &pValue) const {
+  if (!mSpilled) {
+    return std::binary_search(mInline, mInline + mSize, pValue);
+  }
+  const chunk &c = mBlock->mChunks[find_chunk(pValue)];
+  if (c.mLast < pValue) {
+    return false;
+  }
+  Value value = c.mFirst;
+  std::size_t offset = 0;
+  for (int i = 1; i < c.mCount && value < pValue; i++) {
+    value = Value(delta_type(value) + read_delta(c.mDeltas.data(), offset));
+  }
+  return value == pValue;
+}
+
+template <typename Value>
+bool posting_list<Value>::insert(const Value &pValue) {
+  if (!mSpilled) {
+    Value *pos = std::lower_bound(mInline, mInline + mSize, pValue);
+    if (pos != mInline + mSize && *pos == pValue) {
+      return false;
+    }
+    if (int(mSize) < INLINE_CAPACITY) {
+      std::copy_backward(pos, mInline + mSize, mInline + mSize + 1);
+      *pos = pValue;
+    } else {
+      Value values[INLINE_CAPACITY + 1];
+      Value *last = std::copy(mInline, pos, values);
+      *last = pValue;
+      std::copy(pos, mInline + mSize, last + 1);
+      spill(values, mSize + 1);
+    }
+    mSize++;
+    return true;
+  }
+  std::vector<chunk> &chunks = mBlock->mChunks;
+  std::size_t index = find_chunk(pValue);
+  chunk &c = chunks[index];
+  if (c.mLast < pValue) {
+    if (c.mCount < CHUNK_CAPACITY) {
+      append_delta(c.mDeltas, delta_type(delta_type(pValue) -
+                                         delta_type(c.mLast)));
+      c.mLast = pValue;
+      c.mCount++;
+      mSize++;
+      return true;
+    }
+    if (index + 1 == chunks.size()) {
+      // past the end of the list; leave the full chunk as it is
+      chunks.emplace_back();
+      encode(chunks.back(), &pValue, 1);
+      mSize++;
+      return true;
+    }
+  }
+  Value values[CHUNK_CAPACITY + 1];
+  decode(c, values);
+  int count = c.mCount;
+  Value *pos = std::lower_bound(values, values + count, pValue);
+  if (pos != values + count && *pos == pValue) {
+    return false;
+  }
+  std::copy_backward(pos, values + count, values + count + 1);
+  *pos = pValue;
+  count++;
+  if (count <= CHUNK_CAPACITY) {
+    encode(c, values, count);
+  } else {
+    // split the chunk in two halves
+    chunk right;
+    encode(right, values + count / 2, count - count / 2);
+    encode(c, values, count / 2);
+    chunks.insert(chunks.begin() + index + 1, std::move(right));
+  }
+  mSize++;
+  return true;
+}
+
+template <typename Value>
+bool posting_list<Value>::erase(const Value &pValue) {
+  if (!mSpilled) {
+    Value *pos = std::lower_bound(mInline, mInline + mSize, pValue);
+    if (pos == mInline + mSize || *pos != pValue) {
+      return false;
+    }
+    std::copy(pos + 1, mInline + mSize, pos);
+    mSize--;
+    return true;
+  }
+  std::vector<chunk> &chunks = mBlock->mChunks;
+  std::size_t index = find_chunk(pValue);
+  // room for a neighbour merged in behind
+  Value values[2 * CHUNK_CAPACITY];
+  decode(chunks[index], values);
+  int count = chunks[index].mCount;
+  Value *pos = std::lower_bound(values, values + count, pValue);
+  if (pos == values + count || *pos != pValue) {
+    return false;
+  }
+  std::copy(pos + 1, values + count, pos);
+  count--;
+  mSize--;
+  if (count == 0) {
+    chunks.erase(chunks.begin() + index);
+  } else if (count < CHUNK_CAPACITY / 4 && index + 1 < chunks.size() &&
+             count + chunks[index + 1].mCount <= CHUNK_CAPACITY) {
+    // a small chunk takes in the one behind it
+    decode(chunks[index + 1], values + count);
+    encode(chunks[index], values, count + chunks[index + 1].mCount);
+    chunks.erase(chunks.begin() + index + 1);
+  } else {
+    encode(chunks[index], values, count);
+  }
+  if (int(mSize) <= INLINE_CAPACITY / 2) {
+    unspill();
+  }
+  return true;
+}
+
+template <typename Value>
+typename posting_list<Value>::const_iterator
+posting_list<Value>::begin() const {
+  return const_iterator(this, 0);
+}
+
+template <typename Value>
+typename posting_list<Value>::const_iterator posting_list<Value>::end() const {
+  return const_iterator(this, mSpilled ? mBlock->mChunks.size() : mSize > 0);
+}
+
+template <typename Value>
+std::size_t posting_list<Value>::get_heap_bytes() const {
+  if (!mSpilled) {
+    return 0;
+  }
+  std::size_t bytes = sizeof(overflow_block) +
+                      mBlock->mChunks.capacity() * sizeof(chunk);
+  for (const chunk &c : mBlock->mChunks) {
+    bytes += c.mDeltas.capacity();
+  }
+  return bytes;
+}
+
+template <typename Value>
+void posting_list<Value>::encode(chunk &pChunk, const Value *pValues,
+                                 int pCount) {
+  pChunk.mFirst = pValues[0];
+  pChunk.mLast = pValues[pCount - 1];
+  pChunk.mCount = pCount;
+  pChunk.mDeltas.clear();
+  for (int i = 1; i < pCount; i++) {
+    append_delta(pChunk.mDeltas, delta_type(delta_type(pValues[i]) -
+                                            delta_type(pValues[i - 1])));
+  }
+}
+
+// Deltas are LEB128 varints: seven bits per byte, low bits first, the top
+// bit set on every byte but the last.
+template <typename Value>
+void posting_list<Value>::append_delta(std::vector<unsigned char> &pBytes,
+                                       delta_type pDelta) {
+  while (pDelta >= 0x80) {
+    pBytes.push_back(static_cast<unsigned char>(pDelta | 0x80));
+    pDelta >>= 7;
+  }
+  pBytes.push_back(static_cast<unsigned char>(pDelta));
+}
+
+template <typename Value>
+void posting_list<Value>::decode(const chunk &pChunk, Value *pValues) {
+  pValues[0] = pChunk.mFirst;
+  std::size_t offset = 0;
+  for (int i = 1; i < pChunk.mCount; i++) {
+    pValues[i] = Value(delta_type(pValues[i - 1]) +
+                       read_delta(pChunk.mDeltas.data(), offset));
+  }
+}
+
+template <typename Value>
+typename posting_list<Value>::delta_type
+posting_list<Value>::read_delta(const unsigned char *pBytes,
+                                std::size_t &pOffset) {
+  delta_type delta = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char byte = pBytes[pOffset++];
+    delta |= delta_type(delta_type(byte & 0x7f) << shift);
+    if (byte < 0x80) {
+      return delta;
+    }
+  }
+}
+
+template <typename Value>
+std::size_t posting_list<Value>::find_chunk(const Value &pValue) const {
+  const std::vector<chunk> &chunks = mBlock->mChunks;
+  auto after = std::upper_bound(
+      chunks.begin() + 1, chunks.end(), pValue,
+      [](const Value &pLeft, const chunk &pRight) {
+        return pLeft < pRight.mFirst;
+      });
+  return after - chunks.begin() - 1;
+}
+
+template <typename Value>
+void posting_list<Value>::spill(const Value *pValues, int pCount) {
+  overflow_block *block = new overflow_block();
+  for (int i = 0; i < pCount; i += CHUNK_CAPACITY) {
+    block->mChunks.emplace_back();
+    encode(block->mChunks.back(), pValues + i,
+           std::min(CHUNK_CAPACITY, pCount - i));
+  }
+  mBlock = block;
+  mSpilled = true;
+}
+
+template <typename Value> void posting_list<Value>::unspill() {
+  Value values[INLINE_CAPACITY];
+  Value *last = values;
+  for (const chunk &c : mBlock->mChunks) {
+    decode(c, last);
+    last += c.mCount;
+  }
+  delete mBlock;
+  mSpilled = false;
+  std::copy(values, last, mInline);
+}
+
+template <typename Value> void posting_list<Value>::release() {
+  if (mSpilled) {
+    delete mBlock;
+    mSpilled = false;
+  }
+  mSize = 0;
+}
+
+// posting_list::const_iterator class /////////////////////////////////////////
+template <typename Value>
+posting_list<Value>::const_iterator::const_iterator()
+    : mList(nullptr), mChunk(0), mIndex(0), mOffset(0), mValue() {}
+
+template <typename Value>
+posting_list<Value>::const_iterator::const_iterator(const posting_list *pList,
+                                                    std::size_t pChunk)
+    : mList(pList), mChunk(pChunk), mIndex(0), mOffset(0), mValue() {
+  if (mChunk < get_chunk_count()) {
+    enter_chunk();
+  }
+}
+
+template <typename Value>
+Value posting_list<Value>::const_iterator::operator*() const {
+  return mValue;
+}
+
+template <typename Value>
+typename posting_list<Value>::const_iterator &
+posting_list<Value>::const_iterator::operator++() {
+  mIndex++;
+  if (!mList->mSpilled) {
+    if (mIndex < int(mList->mSize)) {
+      mValue = mList->mInline[mIndex];
+    } else {
+      mChunk++;
+      mIndex = 0;
+    }
+    return *this;
+  }
+  const chunk &c = mList->mBlock->mChunks[mChunk];
+  if (mIndex < c.mCount) {
+    mValue = Value(delta_type(mValue) + read_delta(c.mDeltas.data(), mOffset));
+  } else {
+    mChunk++;
+    mIndex = 0;
+    if (mChunk < get_chunk_count()) {
+      enter_chunk();
+    }
+  }
+  return *this;
+}
+
+template <typename Value>
+typename posting_list<Value>::const_iterator
+posting_list<Value>::const_iterator::operator++(int) {
+  const_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+template <typename Value>
+bool posting_list<Value>::const_iterator::operator==(
+    const const_iterator &pOther) const {
+  return mList == pOther.mList && mChunk == pOther.mChunk &&
+         mIndex == pOther.mIndex;
+}
+
+template <typename Value>
+bool posting_list<Value>::const_iterator::operator!=(
+    const const_iterator &pOther) const {
+  return !(*this == pOther);
+}
+
+template <typename Value>
+std::size_t posting_list<Value>::const_iterator::get_chunk_count() const {
+  return mList->mSpilled ? mList->mBlock->mChunks.size() : mList->mSize > 0;
+}
+
+template <typename Value>
+void posting_list<Value>::const_iterator::enter_chunk() {
+  mIndex = 0;
+  mOffset = 0;
+  mValue = mList->mSpilled ? mList->mBlock->mChunks[mChunk].mFirst
+                           : mList->mInline[0];
+}
+
+// multimap_bplustree class ///////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::multimap_bplustree()
+    : mSize(0), mKeyCount(0) {}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool multimap_bplustree<Key, Value, Compare, Fanout, Search>::insert(
+    const record_type &pRecord) {
+  bool added = false;
+  bool found = mTree.update(
+      pRecord.get_key(), [&pRecord, &added](posting_list<Value> &pList) {
+        added = pList.insert(pRecord.get_value());
+      });
+  mKeyCount += !found;
+  mSize += added;
+  return added;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool multimap_bplustree<Key, Value, Compare, Fanout, Search>::remove(
+    const Key &pKey, const Value &pValue) {
+  posting_list<Value> *list = mTree.search(pKey);
+  if (!list || !list->erase(pValue)) {
+    return false;
+  }
+  mSize--;
+  if (list->get_size() == 0) {
+    mTree.remove(pKey);
+    mKeyCount--;
+  }
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::remove(
+    const Key &pKey) {
+  posting_list<Value> *list = mTree.search(pKey);
+  if (!list) {
+    return 0;
+  }
+  std::size_t count = list->get_size();
+  // free the overflow block now; the leaf slot may outlive the key
+  *list = posting_list<Value>();
+  mTree.remove(pKey);
+  mSize -= count;
+  mKeyCount--;
+  return count;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool multimap_bplustree<Key, Value, Compare, Fanout, Search>::contains(
+    const Key &pKey, const Value &pValue) const {
+  const posting_list<Value> *list = mTree.search(pKey);
+  return list && list->contains(pValue);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t multimap_bplustree<Key, Value, Compare, Fanout, Search>::count(
+    const Key &pKey) const {
+  const posting_list<Value> *list = mTree.search(pKey);
+  return list ? list->get_size() : 0;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+typename multimap_bplustree<Key, Value, Compare, Fanout, Search>::value_range
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::equal_range(
+    const Key &pKey) const {
+  const posting_list<Value> *list = mTree.search(pKey);
+  if (!list) {
+    return value_range(value_iterator(), value_iterator());
+  }
+  return value_range(list->begin(), list->end());
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::get_size() const {
+  return mSize;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::get_key_count()
+    const {
+  return mKeyCount;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+multimap_bplustree<Key, Value, Compare, Fanout, Search>::get_memory_usage()
+    const {
+  std::size_t bytes = mTree.get_memory_usage();
+  for (auto it = mTree.begin(); it != mTree.end(); ++it) {
+    bytes += it.get_value().get_heap_bytes();
+  }
+  return bytes;
+}
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace bpt {
+
+// Slab allocator for tree nodes of one type. Nodes are carved out of
+// SLAB_BYTES-sized slabs owned by the pool and recycled through an intrusive
+// free list, so a split costs no heap allocation once the pool has warmed up
+// and a merge hands its node straight back to the next split.
+//
+// The pool never runs destructors on its own: every node handed out by
+// create() must be returned through destroy() before the pool goes away.
+template <typename T> class node_pool {
+public:
+  node_pool();
+  node_pool(const node_pool &) = delete;
+  node_pool &operator=(const node_pool &) = delete;
+
+  template <typename... Args> T *create(Args &&...pArgs);
+  void destroy(T *pNode);
+  // takes over the slabs, free slots and live nodes of pOther, which is
+  // left empty; nodes created by pOther may then be destroyed here
+  void absorb(node_pool &pOther);
+
+  std::size_t get_live_count() const;
+  std::size_t get_capacity() const;
+  // bytes of the slabs and of the table holding them
+  std::size_t get_reserved_bytes() const;
+
+private:
+  union slot {
+    slot *mNext;
+    alignas(T) unsigned char mStorage[sizeof(T)];
+  };
+
+  static constexpr std::size_t SLAB_BYTES = 1 << 16;
+  static constexpr std::size_t SLOTS_PER_SLAB =
+      SLAB_BYTES / sizeof(slot) > 0 ? SLAB_BYTES / sizeof(slot) : 1;
+
+  void grow();
+
+  std::vector<std::unique_ptr<slot[]>> mSlabs;
+  slot *mFree;
+  std::size_t mLive;
+};
+
+template <typename T> node_pool<T>::node_pool() : mFree(nullptr), mLive(0) {}
+
+template <typename T>
+template <typename... Args>
+T *node_pool<T>::create(Args &&...pArgs) {
+  if (!mFree) {
+    grow();
+  }
+  slot *s = mFree;
+  mFree = s->mNext;
+  T *n = new (s->mStorage) T(std::forward<Args>(pArgs)...);
+  mLive++;
+  return n;
+}
+
+template <typename T> void node_pool<T>::destroy(T *pNode) {
+  pNode->~T();
+  slot *s = reinterpret_cast<slot *>(pNode);
+  s->mNext = mFree;
+  mFree = s;
+  mLive--;
+}
+
+template <typename T> void node_pool<T>::absorb(node_pool &pOther) {
+  for (std::unique_ptr<slot[]> &slab : pOther.mSlabs) {
+    mSlabs.push_back(std::move(slab));
+  }
+  pOther.mSlabs.clear();
+  while (pOther.mFree) {
+    slot *s = pOther.mFree;
+    pOther.mFree = s->mNext;
+    s->mNext = mFree;
+    mFree = s;
+  }
+  mLive += pOther.mLive;
+  pOther.mLive = 0;
+}
+
+template <typename T> std::size_t node_pool<T>::get_live_count() const {
+  return mLive;
+}
+
+template <typename T> std::size_t node_pool<T>::get_capacity() const {
+  return mSlabs.size() * SLOTS_PER_SLAB;
+}
+
+template <typename T> std::size_t node_pool<T>::get_reserved_bytes() const {
+  return mSlabs.size() * SLOTS_PER_SLAB * sizeof(slot) +
+         mSlabs.capacity() * sizeof(mSlabs[0]);
+}
+
+template <typename T> void node_pool<T>::grow() {
+  mSlabs.emplace_back(new slot[SLOTS_PER_SLAB]);
+  slot *slab = mSlabs.back().get();
+  // thread the new slots so that they are handed out in address order
+  for (std::size_t i = SLOTS_PER_SLAB; i-- > 0;) {
+    slab[i].mNext = mFree;
+    mFree = &slab[i];
+  }
+}
+
+} // namespace bpt
+
+#endif
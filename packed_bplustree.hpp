@@ -0,0 +1,207 @@
+#ifndef PACKED_BPLUSTREE_HPP
+#define PACKED_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace bpt {
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+class packed_bplustree;
+
+// compile-time parameters shared by the classes of one packed tree
+// instantiation
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+struct packed_traits {
+  static_assert(std::is_integral<Key>::value &&
+                    !std::is_same<Key, bool>::value,
+                "packed leaves store keys as differences of integers");
+  static_assert(std::is_trivially_copyable<Value>::value &&
+                    alignof(Value) <= 16,
+                "packed leaves store values as raw bytes");
+  static_assert(Fanout >= 3, "fanout must be at least 3");
+
+  typedef Key key_type;
+  typedef Value value_type;
+  typedef std::less<Key> key_compare;
+  typedef Search search_policy;
+  typedef typename std::make_unsigned<Key>::type delta_type;
+
+  static constexpr int CACHE_LINE = 64;
+  static constexpr int LEAF_BYTES = LeafBytes;
+  // the leaf header takes the first 32 bytes
+  static constexpr int LEAF_DATA_BYTES = LeafBytes - 32;
+  // Records a leaf holds even if its keys need their full width. Packed
+  // keys are read eight bytes at a time and may be read up to 7 bytes past
+  // their end, and the values behind them may need alignment padding.
+  static constexpr int RAW_RECORDS =
+      (LEAF_DATA_BYTES - 7 - int(alignof(Value)) + 1) /
+      int(sizeof(Key) + sizeof(Value));
+  // A leaf never holds more, so that either half of an overflowing leaf
+  // fits whatever its keys are.
+  static constexpr int LEAF_MAX = 2 * RAW_RECORDS - 1;
+  static constexpr int LEAF_MIN = LEAF_MAX / 6 > 0 ? LEAF_MAX / 6 : 1;
+  static constexpr int INNER_MAX = Fanout;
+  static constexpr int INNER_MIN = Fanout / 6 > 0 ? Fanout / 6 : 1;
+
+  static_assert(RAW_RECORDS >= 2, "leaf too small for the key and value");
+
+  static bool less(const Key &pLeft, const Key &pRight) {
+    return pLeft < pRight;
+  }
+};
+
+// common base of packed leaves and inner nodes; which one a child is
+// follows from its depth
+class packed_node {};
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "packed leaves assume little-endian 64-bit reads"
+#endif
+
+// Leaf that stores its keys frame-of-reference encoded: the first key is
+// the base and every key is kept as its difference to the base, packed
+// into just as many bits as the largest difference needs. The values
+// follow the packed keys unencoded. Every change decodes the leaf, edits
+// the plain records and encodes them again; lookups work on the packed
+// form directly.
+template <typename Traits> class packed_leaf : public packed_node {
+  template <typename, typename, int, int, typename>
+  friend class packed_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+  typedef typename Traits::value_type value_type;
+
+  packed_leaf();
+  int get_size() const;
+  key_type get_key(int pIndex) const;
+  const value_type &get_value(int pIndex) const;
+  // index of the first key not less than pKey
+  int lower_bound(const key_type &pKey) const;
+  packed_leaf *get_next() const;
+  // decodes every key into pKeys
+  void decode_keys(key_type *pKeys) const;
+
+private:
+  typedef typename Traits::delta_type delta_type;
+
+  // whether pCount sorted keys, and as many values, fit into one leaf
+  static bool fits(const key_type *pKeys, int pCount);
+  // replaces the records by pCount sorted ones, which must fit
+  void encode(const key_type *pKeys, const value_type *pValues, int pCount);
+  void decode(key_type *pKeys, value_type *pValues) const;
+  static int get_width(const key_type *pKeys, int pCount);
+  static int get_value_offset(int pCount, int pWidth);
+  std::uint64_t get_delta(int pIndex) const;
+
+  packed_leaf *mPrev;
+  packed_leaf *mNext;
+  key_type mBase;
+  std::uint16_t mSize;
+  // bits per packed key; 64 stores the keys whole
+  std::uint8_t mWidth;
+  alignas(16) unsigned char mData[Traits::LEAF_DATA_BYTES];
+};
+
+// Child i sits to the right of key i - 1, as in inner_node.
+template <typename Traits> class packed_inner : public packed_node {
+  template <typename, typename, int, int, typename>
+  friend class packed_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+
+  // one spare slot takes the overflow before a split
+  static constexpr int CAPACITY = Traits::INNER_MAX + 1;
+  static constexpr int KEY_SLOTS =
+      (CAPACITY * sizeof(key_type) + Traits::CACHE_LINE - 1) /
+      Traits::CACHE_LINE * Traits::CACHE_LINE / sizeof(key_type);
+
+  explicit packed_inner(packed_node *pHeir);
+  int get_size() const;
+  const key_type &get_key(int pIndex) const;
+  packed_node *get_child(int pIndex) const;
+  int upper_bound(const key_type &pKey) const;
+
+private:
+  void insert_at(int pIndex, const key_type &pKey, packed_node *pRight);
+  void erase(int pIndex);
+  void set_key(int pIndex, const key_type &pKey);
+  key_type split_into(packed_inner &pNew);
+  void merge_from(const packed_inner &pRight, const key_type &pSeparator);
+  key_type redistribute(packed_inner &pRight, const key_type &pSeparator);
+
+  int mSize;
+  alignas(Traits::CACHE_LINE) key_type mKeys[KEY_SLOTS];
+  packed_node *mChildren[CAPACITY + 1];
+};
+
+// B+tree over integer keys whose leaves are compressed: each leaf is a
+// fixed block of LeafBytes holding a frame-of-reference, bit-packed key
+// array and the values. Dense keys such as sequentially assigned ids take
+// a few bits each instead of sizeof(Key) bytes, so a leaf holds up to
+// twice as many records as an uncompressed one of the same size and the
+// tree needs fewer nodes. Inner nodes are plain. Keys are unique.
+template <typename Key, typename Value, int LeafBytes = 1024, int Fanout = 30,
+          typename Search = simd_search_policy>
+class packed_bplustree {
+public:
+  typedef packed_traits<Key, Value, LeafBytes, Fanout, Search> traits;
+  typedef record<Key, Value> record_type;
+
+  packed_bplustree();
+  packed_bplustree(const packed_bplustree &) = delete;
+  packed_bplustree &operator=(const packed_bplustree &) = delete;
+  ~packed_bplustree();
+
+  const Value *search(const Key &pKey) const;
+  // false, leaving the tree unchanged, if the key is already present
+  bool insert(const record_type &pRecord);
+  bool remove(const Key &pKey);
+  // calls pVisit(key, value) for the records with pLow <= key < pHigh in
+  // key order
+  template <typename Visitor>
+  void scan(const Key &pLow, const Key &pHigh, Visitor pVisit) const;
+
+  std::size_t get_size() const;
+  // bytes of the nodes in use
+  std::size_t get_memory_usage() const;
+
+private:
+  typedef packed_leaf<traits> leaf_type;
+  typedef packed_inner<traits> inner_type;
+
+  // every inner node has at least two children
+  static constexpr int MAX_HEIGHT = 64;
+
+  // Walks down to the leaf of pKey. If pPath is given, the inner nodes on
+  // the way and the child slots taken in them are stored from the root
+  // down.
+  leaf_type *find_leaf(const Key &pKey, inner_type **pPath,
+                       int *pSlots) const;
+  void split_upwards(inner_type **pPath, const int *pSlots,
+                     packed_node *pLeft, Key pSeparator, packed_node *pRight);
+  // merges or evens out children pLeftSlot and pLeftSlot + 1 of pParent,
+  // which sit at pDepth; true if they were merged
+  bool rebalance(inner_type *pParent, int pLeftSlot, int pDepth);
+  void destroy_tree(packed_node *pNode, int pDepth);
+
+  packed_node *mRoot;
+  // inner levels above the leaves
+  int mHeight;
+  std::size_t mSize;
+  node_pool<leaf_type> mLeaves;
+  node_pool<inner_type> mInners;
+};
+
+} // namespace bpt
+
+#include "packed_bplustree_impl.hpp"
+
+#endif
@@ -0,0 +1,487 @@
+#ifndef PACKED_BPLUSTREE_IMPL_HPP
+#define PACKED_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+#include <cstring>
+
+namespace bpt {
+
+// packed_leaf class //////////////////////////////////////////////////////////
+template <typename Traits>
+packed_leaf<Traits>::packed_leaf()
+    : mPrev(nullptr), mNext(nullptr), mBase(), mSize(0), mWidth(0) {}
+
+template <typename Traits> int packed_leaf<Traits>::get_size() const {
+  return mSize;
+}
+
+template <typename Traits>
+typename packed_leaf<Traits>::key_type
+packed_leaf<Traits>::get_key(int pIndex) const {
+  delta_type delta = delta_type(get_delta(pIndex));
+  return key_type(delta_type(delta_type(mBase) + delta));
+}
+
+template <typename Traits>
+const typename packed_leaf<Traits>::value_type &
+packed_leaf<Traits>::get_value(int pIndex) const {
+  return reinterpret_cast<const value_type *>(
+      mData + get_value_offset(mSize, mWidth))[pIndex];
+}
+
+// Binary search over the packed differences, so that a lookup unpacks
+// about log2(size) keys instead of the whole leaf. The loop has no data
+// dependent branch: the probe only decides how far the window moves.
+template <typename Traits>
+int packed_leaf<Traits>::lower_bound(const key_type &pKey) const {
+  if (mSize == 0 || !Traits::less(mBase, pKey)) {
+    return 0;
+  }
+  std::uint64_t target = delta_type(delta_type(pKey) - delta_type(mBase));
+  int low = 0;
+  for (int count = mSize; count > 1;) {
+    int half = count / 2;
+    low = get_delta(low + half) < target ? low + half : low;
+    count -= half;
+  }
+  return low + (get_delta(low) < target);
+}
+
+template <typename Traits>
+packed_leaf<Traits> *packed_leaf<Traits>::get_next() const {
+  return mNext;
+}
+
+template <typename Traits>
+void packed_leaf<Traits>::decode_keys(key_type *pKeys) const {
+  for (int i = 0; i < mSize; i++) {
+    pKeys[i] = get_key(i);
+  }
+}
+
+template <typename Traits>
+bool packed_leaf<Traits>::fits(const key_type *pKeys, int pCount) {
+  return get_value_offset(pCount, get_width(pKeys, pCount)) +
+             pCount * int(sizeof(value_type)) <=
+         Traits::LEAF_DATA_BYTES;
+}
+
+template <typename Traits>
+void packed_leaf<Traits>::encode(const key_type *pKeys,
+                                 const value_type *pValues, int pCount) {
+  mSize = pCount;
+  mWidth = get_width(pKeys, pCount);
+  mBase = pCount > 0 ? pKeys[0] : key_type();
+  int valueOffset = get_value_offset(pCount, mWidth);
+  std::memset(mData, 0, valueOffset);
+  for (int i = 0; mWidth > 0 && i < pCount; i++) {
+    std::uint64_t delta = delta_type(delta_type(pKeys[i]) - delta_type(mBase));
+    std::size_t bit = std::size_t(i) * mWidth;
+    std::uint64_t word;
+    std::memcpy(&word, mData + bit / 8, sizeof(word));
+    word |= delta << (bit % 8);
+    std::memcpy(mData + bit / 8, &word, sizeof(word));
+  }
+  std::memcpy(mData + valueOffset, pValues, pCount * sizeof(value_type));
+}
+
+template <typename Traits>
+void packed_leaf<Traits>::decode(key_type *pKeys, value_type *pValues) const {
+  decode_keys(pKeys);
+  std::memcpy(pValues, mData + get_value_offset(mSize, mWidth),
+              mSize * sizeof(value_type));
+}
+
+// Bits of the largest difference. Wider than 56 bits a shifted key no
+// longer fits into one 64-bit read, so such keys are kept whole.
+template <typename Traits>
+int packed_leaf<Traits>::get_width(const key_type *pKeys, int pCount) {
+  if (pCount < 2) {
+    return 0;
+  }
+  std::uint64_t range =
+      delta_type(delta_type(pKeys[pCount - 1]) - delta_type(pKeys[0]));
+  int width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+  return width > 56 ? 64 : width;
+}
+
+// The packed keys start the data area; the values follow them behind the
+// 7 bytes the last 64-bit read may run over.
+template <typename Traits>
+int packed_leaf<Traits>::get_value_offset(int pCount, int pWidth) {
+  int end = int((std::size_t(pCount) * pWidth + 7) / 8) + 7;
+  return (end + int(alignof(value_type)) - 1) / int(alignof(value_type)) *
+         int(alignof(value_type));
+}
+
+template <typename Traits>
+std::uint64_t packed_leaf<Traits>::get_delta(int pIndex) const {
+  if (mWidth == 0) {
+    return 0;
+  }
+  std::size_t bit = std::size_t(pIndex) * mWidth;
+  std::uint64_t word;
+  std::memcpy(&word, mData + bit / 8, sizeof(word));
+  return (word >> (bit % 8)) & (~std::uint64_t(0) >> (64 - mWidth));
+}
+
+// packed_inner class /////////////////////////////////////////////////////////
+template <typename Traits>
+packed_inner<Traits>::packed_inner(packed_node *pHeir) : mSize(0) {
+  mChildren[0] = pHeir;
+}
+
+template <typename Traits> int packed_inner<Traits>::get_size() const {
+  return mSize;
+}
+
+template <typename Traits>
+const typename packed_inner<Traits>::key_type &
+packed_inner<Traits>::get_key(int pIndex) const {
+  return mKeys[pIndex];
+}
+
+template <typename Traits>
+packed_node *packed_inner<Traits>::get_child(int pIndex) const {
+  return mChildren[pIndex];
+}
+
+template <typename Traits>
+int packed_inner<Traits>::upper_bound(const key_type &pKey) const {
+  return Traits::search_policy::upper_bound(mKeys, mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+template <typename Traits>
+void packed_inner<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                     packed_node *pRight) {
+  std::move_backward(mKeys + pIndex, mKeys + mSize, mKeys + mSize + 1);
+  std::copy_backward(mChildren + pIndex + 1, mChildren + mSize + 1,
+                     mChildren + mSize + 2);
+  mKeys[pIndex] = pKey;
+  mChildren[pIndex + 1] = pRight;
+  mSize++;
+}
+
+template <typename Traits> void packed_inner<Traits>::erase(int pIndex) {
+  std::move(mKeys + pIndex + 1, mKeys + mSize, mKeys + pIndex);
+  std::copy(mChildren + pIndex + 2, mChildren + mSize + 1,
+            mChildren + pIndex + 1);
+  mSize--;
+}
+
+template <typename Traits>
+void packed_inner<Traits>::set_key(int pIndex, const key_type &pKey) {
+  mKeys[pIndex] = pKey;
+}
+
+template <typename Traits>
+typename packed_inner<Traits>::key_type
+packed_inner<Traits>::split_into(packed_inner &pNew) {
+  int from = mSize / 2;
+  std::copy(mKeys + from + 1, mKeys + mSize, pNew.mKeys);
+  std::copy(mChildren + from + 1, mChildren + mSize + 1, pNew.mChildren);
+  pNew.mSize = mSize - from - 1;
+  mSize = from;
+  return mKeys[from];
+}
+
+template <typename Traits>
+void packed_inner<Traits>::merge_from(const packed_inner &pRight,
+                                      const key_type &pSeparator) {
+  mKeys[mSize] = pSeparator;
+  std::copy(pRight.mKeys, pRight.mKeys + pRight.mSize, mKeys + mSize + 1);
+  std::copy(pRight.mChildren, pRight.mChildren + pRight.mSize + 1,
+            mChildren + mSize + 1);
+  mSize += pRight.mSize + 1;
+}
+
+// The separator comes down between the two key runs and whichever key ends
+// up in the middle goes back up.
+template <typename Traits>
+typename packed_inner<Traits>::key_type
+packed_inner<Traits>::redistribute(packed_inner &pRight,
+                                   const key_type &pSeparator) {
+  int size = mSize, rsize = pRight.mSize;
+  int target = (size + 1 + rsize) / 2;
+  key_type separator;
+  if (size < target) {
+    int count = target - size;
+    mKeys[size] = pSeparator;
+    std::copy(pRight.mKeys, pRight.mKeys + count - 1, mKeys + size + 1);
+    std::copy(pRight.mChildren, pRight.mChildren + count,
+              mChildren + size + 1);
+    separator = pRight.mKeys[count - 1];
+    std::copy(pRight.mKeys + count, pRight.mKeys + rsize, pRight.mKeys);
+    std::copy(pRight.mChildren + count, pRight.mChildren + rsize + 1,
+              pRight.mChildren);
+    pRight.mSize = rsize - count;
+  } else {
+    int count = size - target;
+    std::copy_backward(pRight.mKeys, pRight.mKeys + rsize,
+                       pRight.mKeys + rsize + count);
+    std::copy_backward(pRight.mChildren, pRight.mChildren + rsize + 1,
+                       pRight.mChildren + rsize + 1 + count);
+    std::copy(mKeys + target + 1, mKeys + size, pRight.mKeys);
+    pRight.mKeys[count - 1] = pSeparator;
+    std::copy(mChildren + target + 1, mChildren + size + 1, pRight.mChildren);
+    separator = mKeys[target];
+    pRight.mSize = rsize + count;
+  }
+  mSize = target;
+  return separator;
+}
+
+// packed_bplustree class /////////////////////////////////////////////////////
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::packed_bplustree()
+    : mRoot(nullptr), mHeight(0), mSize(0) {
+  static_assert(sizeof(leaf_type) == LeafBytes,
+                "LeafBytes must be a multiple of 16");
+  mRoot = mLeaves.create();
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::~packed_bplustree() {
+  destroy_tree(mRoot, 0);
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+const Value *packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::search(
+    const Key &pKey) const {
+  const leaf_type *leaf = find_leaf(pKey, nullptr, nullptr);
+  int index = leaf->lower_bound(pKey);
+  if (index == leaf->get_size() || traits::less(pKey, leaf->get_key(index))) {
+    return nullptr;
+  }
+  return &leaf->get_value(index);
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+bool packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::insert(
+    const record_type &pRecord) {
+  const Key &key = pRecord.get_key();
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *leaf = find_leaf(key, path, slots);
+  int index = leaf->lower_bound(key), size = leaf->get_size();
+  if (index < size && !traits::less(key, leaf->get_key(index))) {
+    return false;
+  }
+  Key keys[traits::LEAF_MAX + 1];
+  Value values[traits::LEAF_MAX + 1];
+  leaf->decode(keys, values);
+  std::move_backward(keys + index, keys + size, keys + size + 1);
+  std::move_backward(values + index, values + size, values + size + 1);
+  keys[index] = key;
+  values[index] = pRecord.get_value();
+  size++;
+  mSize++;
+  if (size <= traits::LEAF_MAX && leaf_type::fits(keys, size)) {
+    leaf->encode(keys, values, size);
+    return true;
+  }
+  // either half holds at most RAW_RECORDS, which fit at any width
+  int half = size / 2;
+  leaf_type *right = mLeaves.create();
+  leaf->encode(keys, values, half);
+  right->encode(keys + half, values + half, size - half);
+  right->mPrev = leaf;
+  right->mNext = leaf->mNext;
+  if (leaf->mNext) {
+    leaf->mNext->mPrev = right;
+  }
+  leaf->mNext = right;
+  split_upwards(path, slots, leaf, keys[half], right);
+  return true;
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+bool packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::remove(
+    const Key &pKey) {
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *leaf = find_leaf(pKey, path, slots);
+  int index = leaf->lower_bound(pKey), size = leaf->get_size();
+  if (index == size || traits::less(pKey, leaf->get_key(index))) {
+    return false;
+  }
+  Key keys[traits::LEAF_MAX];
+  Value values[traits::LEAF_MAX];
+  leaf->decode(keys, values);
+  std::move(keys + index + 1, keys + size, keys + index);
+  std::move(values + index + 1, values + size, values + index);
+  // fewer keys never need more room
+  leaf->encode(keys, values, --size);
+  mSize--;
+  if (size >= traits::LEAF_MIN) {
+    return true;
+  }
+  // climb for as long as the node below is underfull
+  for (int level = mHeight - 1; level >= 0; level--) {
+    inner_type *parent = path[level];
+    int leftSlot = std::min(slots[level], parent->get_size() - 1);
+    if (!rebalance(parent, leftSlot, level + 1) ||
+        parent->get_size() >= traits::INNER_MIN) {
+      break;
+    }
+  }
+  // replace an inner root that has lost its last key by its only child
+  if (mHeight > 0 && static_cast<inner_type *>(mRoot)->get_size() == 0) {
+    inner_type *root = static_cast<inner_type *>(mRoot);
+    mRoot = root->get_child(0);
+    mHeight--;
+    mInners.destroy(root);
+  }
+  return true;
+}
+
+// Unpacks each leaf's keys in one pass before visiting its records.
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+template <typename Visitor>
+void packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::scan(
+    const Key &pLow, const Key &pHigh, Visitor pVisit) const {
+  const leaf_type *leaf = find_leaf(pLow, nullptr, nullptr);
+  int index = leaf->lower_bound(pLow);
+  Key keys[traits::LEAF_MAX];
+  for (; leaf; leaf = leaf->get_next(), index = 0) {
+    leaf->decode_keys(keys);
+    for (; index < leaf->get_size(); index++) {
+      if (!traits::less(keys[index], pHigh)) {
+        return;
+      }
+      pVisit(keys[index], leaf->get_value(index));
+    }
+  }
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+std::size_t
+packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::get_size() const {
+  return mSize;
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+std::size_t
+packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::get_memory_usage()
+    const {
+  return mLeaves.get_live_count() * sizeof(leaf_type) +
+         mInners.get_live_count() * sizeof(inner_type);
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+typename packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::leaf_type *
+packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::find_leaf(
+    const Key &pKey, inner_type **pPath, int *pSlots) const {
+  packed_node *node = mRoot;
+  for (int level = 0; level < mHeight; level++) {
+    inner_type *inner = static_cast<inner_type *>(node);
+    int slot = inner->upper_bound(pKey);
+    if (pPath) {
+      pPath[level] = inner;
+      pSlots[level] = slot;
+    }
+    node = inner->get_child(slot);
+  }
+  return static_cast<leaf_type *>(node);
+}
+
+// Hangs pRight, split off pLeft, into the parent of pLeft and splits every
+// ancestor that overflows, growing a new root if the old one splits.
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+void packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::split_upwards(
+    inner_type **pPath, const int *pSlots, packed_node *pLeft, Key pSeparator,
+    packed_node *pRight) {
+  for (int level = mHeight - 1; level >= 0; level--) {
+    inner_type *inner = pPath[level];
+    inner->insert_at(pSlots[level], pSeparator, pRight);
+    if (inner->get_size() <= traits::INNER_MAX) {
+      return;
+    }
+    inner_type *right = mInners.create(nullptr);
+    pSeparator = inner->split_into(*right);
+    pLeft = inner;
+    pRight = right;
+  }
+  inner_type *root = mInners.create(pLeft);
+  root->insert_at(0, pSeparator, pRight);
+  mRoot = root;
+  mHeight++;
+}
+
+// Leaves are merged if the records of both fit into one, else shared
+// evenly if the halves fit. Otherwise, with many wide keys next door, the
+// underfull leaf is left as it is.
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+bool packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::rebalance(
+    inner_type *pParent, int pLeftSlot, int pDepth) {
+  packed_node *leftNode = pParent->get_child(pLeftSlot);
+  packed_node *rightNode = pParent->get_child(pLeftSlot + 1);
+  if (pDepth == mHeight) {
+    leaf_type *left = static_cast<leaf_type *>(leftNode);
+    leaf_type *right = static_cast<leaf_type *>(rightNode);
+    Key keys[2 * traits::LEAF_MAX];
+    Value values[2 * traits::LEAF_MAX];
+    int size = left->get_size() + right->get_size();
+    left->decode(keys, values);
+    right->decode(keys + left->get_size(), values + left->get_size());
+    if (size > traits::LEAF_MAX || !leaf_type::fits(keys, size)) {
+      int half = size / 2;
+      if (leaf_type::fits(keys, half) &&
+          leaf_type::fits(keys + half, size - half)) {
+        left->encode(keys, values, half);
+        right->encode(keys + half, values + half, size - half);
+        pParent->set_key(pLeftSlot, keys[half]);
+      }
+      return false;
+    }
+    left->encode(keys, values, size);
+    left->mNext = right->mNext;
+    if (right->mNext) {
+      right->mNext->mPrev = left;
+    }
+    mLeaves.destroy(right);
+  } else {
+    inner_type *left = static_cast<inner_type *>(leftNode);
+    inner_type *right = static_cast<inner_type *>(rightNode);
+    const Key &separator = pParent->get_key(pLeftSlot);
+    if (left->get_size() + right->get_size() + 1 > traits::INNER_MAX) {
+      pParent->set_key(pLeftSlot, left->redistribute(*right, separator));
+      return false;
+    }
+    left->merge_from(*right, separator);
+    mInners.destroy(right);
+  }
+  pParent->erase(pLeftSlot);
+  return true;
+}
+
+template <typename Key, typename Value, int LeafBytes, int Fanout,
+          typename Search>
+void packed_bplustree<Key, Value, LeafBytes, Fanout, Search>::destroy_tree(
+    packed_node *pNode, int pDepth) {
+  if (pDepth == mHeight) {
+    mLeaves.destroy(static_cast<leaf_type *>(pNode));
+    return;
+  }
+  inner_type *inner = static_cast<inner_type *>(pNode);
+  for (int i = 0; i <= inner->get_size(); i++) {
+    destroy_tree(inner->get_child(i), pDepth + 1);
+  }
+  mInners.destroy(inner);
+}
+
+} // namespace bpt
+
+#endif
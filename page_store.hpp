@@ -0,0 +1,222 @@
+#ifndef PAGE_STORE_HPP
+#define PAGE_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bpt {
+
+// Pages are numbered from 0 in file order; page 0 is never a node, so 0
+// doubles as the null page id.
+typedef std::uint32_t page_id;
+constexpr page_id NULL_PAGE = 0;
+
+// A page store hands out fixed-size pages of one file. Every store offers
+//
+//   bool open(const std::string &pPath)  open or create the file
+//   bool close()                         false if changes could not be
+//                                        written back
+//   bool is_open() const
+//   std::size_t get_page_count() const   pages in the file
+//   bool resize(std::size_t pPages)      grow the file to pPages pages
+//   char *pin(page_id pId)               the page's bytes, valid until
+//                                        unpin, or nullptr if the page
+//                                        cannot be had
+//   void unpin(page_id pId, bool pDirty) pDirty: the bytes were changed
+//   void prefetch(page_id pId)           pId will be pinned soon
+//   bool flush()                         write every changed page back
+//
+// so that paged_bplustree can sit on any of them.
+
+// Thrown by page_ref when the store cannot supply a page, e.g. because it
+// could not be read.
+class page_error : public std::runtime_error {
+public:
+  explicit page_error(page_id pId);
+  page_id get_id() const;
+
+private:
+  page_id mId;
+};
+
+inline page_error::page_error(page_id pId)
+    : std::runtime_error("bpt: cannot pin page"), mId(pId) {}
+
+inline page_id page_error::get_id() const { return mId; }
+
+// Keeps one page pinned for as long as it lives; throws page_error if the
+// page cannot be pinned.
+template <typename Store> class page_ref {
+public:
+  page_ref(Store &pStore, page_id pId);
+  page_ref(const page_ref &) = delete;
+  page_ref &operator=(const page_ref &) = delete;
+  ~page_ref();
+  page_id get_id() const;
+  char *get_data() const;
+  // the page has to be written back
+  void mark_dirty();
+
+private:
+  Store &mStore;
+  page_id mId;
+  char *mData;
+  bool mDirty;
+};
+
+template <typename Store>
+page_ref<Store>::page_ref(Store &pStore, page_id pId)
+    : mStore(pStore), mId(pId), mData(pStore.pin(pId)), mDirty(false) {
+  if (!mData) {
+    throw page_error(pId);
+  }
+}
+
+template <typename Store> page_ref<Store>::~page_ref() {
+  mStore.unpin(mId, mDirty);
+}
+
+template <typename Store> page_id page_ref<Store>::get_id() const {
+  return mId;
+}
+
+template <typename Store> char *page_ref<Store>::get_data() const {
+  return mData;
+}
+
+template <typename Store> void page_ref<Store>::mark_dirty() { mDirty = true; }
+
+// Maps the whole file into memory, so a pinned page is read and written
+// where it lies in the page cache, with no copy and no decoding. A large
+// range of address space is reserved up front and the file is mapped into
+// it from the start; growing the file maps the new pages behind the old
+// ones, so pointers to pages never move.
+class mmap_page_store {
+public:
+  static constexpr std::size_t PAGE_SIZE = 4096;
+  // address space reserved per store; bounds the file size
+  static constexpr std::size_t RESERVED_BYTES = std::size_t(1) << 36;
+
+  mmap_page_store();
+  mmap_page_store(const mmap_page_store &) = delete;
+  mmap_page_store &operator=(const mmap_page_store &) = delete;
+  ~mmap_page_store();
+
+  bool open(const std::string &pPath);
+  bool close();
+  bool is_open() const;
+  std::size_t get_page_count() const;
+  bool resize(std::size_t pPages);
+  char *pin(page_id pId);
+  void unpin(page_id pId, bool pDirty);
+  void prefetch(page_id pId);
+  bool flush();
+  int get_fd() const;
+
+private:
+  bool map(std::size_t pFirst, std::size_t pLast);
+
+  int mFd;
+  char *mBase;
+  std::size_t mPageCount;
+};
+
+inline mmap_page_store::mmap_page_store()
+    : mFd(-1), mBase(nullptr), mPageCount(0) {}
+
+inline mmap_page_store::~mmap_page_store() { close(); }
+
+inline bool mmap_page_store::open(const std::string &pPath) {
+  close();
+  mFd = ::open(pPath.c_str(), O_RDWR | O_CREAT, 0644);
+  if (mFd < 0) {
+    return false;
+  }
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(mFd, &st) == 0 && st.st_size % PAGE_SIZE == 0 &&
+      std::size_t(st.st_size) <= RESERVED_BYTES) {
+    base = mmap(nullptr, RESERVED_BYTES, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  if (base == MAP_FAILED) {
+    ::close(mFd);
+    mFd = -1;
+    return false;
+  }
+  mBase = static_cast<char *>(base);
+  mPageCount = st.st_size / PAGE_SIZE;
+  if (mPageCount > 0 && !map(0, mPageCount)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+inline bool mmap_page_store::close() {
+  bool ok = true;
+  if (mBase) {
+    munmap(mBase, RESERVED_BYTES);
+    mBase = nullptr;
+  }
+  if (mFd >= 0) {
+    ok = ::close(mFd) == 0;
+    mFd = -1;
+  }
+  mPageCount = 0;
+  return ok;
+}
+
+inline bool mmap_page_store::is_open() const { return mFd >= 0; }
+
+inline std::size_t mmap_page_store::get_page_count() const {
+  return mPageCount;
+}
+
+inline bool mmap_page_store::resize(std::size_t pPages) {
+  if (pPages <= mPageCount) {
+    return true;
+  }
+  if (pPages * PAGE_SIZE > RESERVED_BYTES ||
+      ftruncate(mFd, pPages * PAGE_SIZE) != 0 || !map(mPageCount, pPages)) {
+    return false;
+  }
+  mPageCount = pPages;
+  return true;
+}
+
+inline char *mmap_page_store::pin(page_id pId) {
+  return mBase + std::size_t(pId) * PAGE_SIZE;
+}
+
+inline void mmap_page_store::unpin(page_id, bool) {}
+
+inline void mmap_page_store::prefetch(page_id pId) {
+  madvise(pin(pId), PAGE_SIZE, MADV_WILLNEED);
+}
+
+inline bool mmap_page_store::flush() {
+  return mPageCount == 0 ||
+         msync(mBase, mPageCount * PAGE_SIZE, MS_SYNC) == 0;
+}
+
+inline int mmap_page_store::get_fd() const { return mFd; }
+
+// maps pages [pFirst, pLast) of the file over their reserved addresses
+inline bool mmap_page_store::map(std::size_t pFirst, std::size_t pLast) {
+  void *at = mBase + pFirst * PAGE_SIZE;
+  void *mapped = mmap(at, (pLast - pFirst) * PAGE_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED, mFd, pFirst * PAGE_SIZE);
+  return mapped == at;
+}
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef PAGED_BPLUSTREE_HPP
+#define PAGED_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+#include "page_store.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace bpt {
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+class paged_bplustree;
+
+// The first cache line of every node page.
+struct page_header {
+  std::uint32_t mIsLeaf;
+  std::int32_t mSize;
+  // neighbouring leaves, NULL_PAGE at either end and in inner pages
+  page_id mPrev;
+  page_id mNext;
+};
+
+// Page 0 of every tree file.
+struct superblock {
+  std::uint64_t mMagic;
+  std::uint32_t mVersion;
+  std::uint32_t mPageSize;
+  std::uint32_t mKeySize;
+  std::uint32_t mValueSize;
+  page_id mRoot;
+  // inner levels above the leaves
+  std::uint32_t mHeight;
+  // first free page; each free page holds the id of the next one
+  page_id mFreeHead;
+  // pages handed out so far, free ones included; the file may be longer
+  std::uint32_t mPageCount;
+  std::uint64_t mRecordCount;
+};
+
+namespace detail {
+
+// offset of the entries behind pSlots keys, which start on the second
+// cache line of the page and are padded to whole cache lines
+constexpr std::size_t get_entries_offset(std::size_t pSlots,
+                                         std::size_t pKeySize,
+                                         std::size_t pAlign) {
+  return (64 + (pSlots * pKeySize + 63) / 64 * 64 + pAlign - 1) / pAlign *
+         pAlign;
+}
+
+// the most keys a page holds when each key comes with one entry, plus
+// pExtra entries on top
+constexpr std::size_t get_slot_count(std::size_t pPageSize,
+                                     std::size_t pKeySize,
+                                     std::size_t pEntrySize,
+                                     std::size_t pAlign, std::size_t pExtra) {
+  std::size_t slots = (pPageSize - 64) / (pKeySize + pEntrySize);
+  while (slots > 0 &&
+         get_entries_offset(slots, pKeySize, pAlign) +
+                 (slots + pExtra) * pEntrySize >
+             pPageSize) {
+    slots--;
+  }
+  return slots;
+}
+
+} // namespace detail
+
+// compile-time parameters of one paged tree instantiation; the fanouts
+// follow from the page size
+template <typename Key, typename Value, typename Compare, std::size_t PageSize,
+          typename Search>
+struct paged_traits {
+  typedef Key key_type;
+  typedef Value value_type;
+  typedef Compare key_compare;
+  typedef Search search_policy;
+
+  static constexpr int CACHE_LINE = 64;
+  static constexpr std::size_t PAGE_SIZE = PageSize;
+  static constexpr std::size_t KEYS_OFFSET = CACHE_LINE;
+  static constexpr int LEAF_SLOTS = detail::get_slot_count(
+      PageSize, sizeof(Key), sizeof(Value), alignof(Value), 0);
+  static constexpr int INNER_SLOTS = detail::get_slot_count(
+      PageSize, sizeof(Key), sizeof(page_id), alignof(page_id), 1);
+  static constexpr std::size_t VALUES_OFFSET =
+      detail::get_entries_offset(LEAF_SLOTS, sizeof(Key), alignof(Value));
+  static constexpr std::size_t CHILDREN_OFFSET =
+      detail::get_entries_offset(INNER_SLOTS, sizeof(Key), alignof(page_id));
+  // the last slot of a page takes the overflow that makes it split
+  static constexpr int LEAF_MAX = LEAF_SLOTS - 1;
+  static constexpr int INNER_MAX = INNER_SLOTS - 1;
+  static constexpr int LEAF_MIN = LEAF_MAX / 6 > 0 ? LEAF_MAX / 6 : 1;
+  static constexpr int INNER_MIN = INNER_MAX / 6 > 0 ? INNER_MAX / 6 : 1;
+
+  static_assert(sizeof(page_header) <= KEYS_OFFSET &&
+                    sizeof(superblock) <= PageSize,
+                "page too small");
+  static_assert(alignof(Key) <= CACHE_LINE && LEAF_MAX >= 3 &&
+                    INNER_MAX >= 3,
+                "key or value too large for a page");
+
+  static bool less(const Key &pLeft, const Key &pRight) {
+    return Compare()(pLeft, pRight);
+  }
+};
+
+// Views of a pinned node page. They own nothing and only lay the header,
+// the key array and the values or child ids over the page's bytes, so a
+// node is used where it lies, in the page cache or in a buffer frame.
+template <typename Traits> class page_node {
+  template <typename, typename, typename, typename, typename>
+  friend class paged_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+
+  explicit page_node(char *pData);
+  bool is_leaf() const;
+  int get_size() const;
+  const key_type &get_key(int pIndex) const;
+  int lower_bound(const key_type &pKey) const;
+  int upper_bound(const key_type &pKey) const;
+  page_id get_prev() const;
+  page_id get_next() const;
+
+protected:
+  page_header *mHeader;
+  key_type *mKeys;
+};
+
+template <typename Traits> class leaf_page : public page_node<Traits> {
+  template <typename, typename, typename, typename, typename>
+  friend class paged_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+  typedef typename Traits::value_type value_type;
+
+  explicit leaf_page(char *pData);
+  const value_type &get_value(int pIndex) const;
+
+private:
+  // formats the page as an empty leaf
+  void init();
+  void insert_at(int pIndex, const key_type &pKey, const value_type &pValue);
+  void erase(int pIndex);
+  // moves the upper half into pNew and returns its first key
+  key_type split_into(leaf_page &pNew);
+  void merge_from(const leaf_page &pRight);
+  // evens out the two pages and returns the new first key of pRight
+  key_type redistribute(leaf_page &pRight);
+
+  value_type *mValues;
+};
+
+// Child i sits to the right of key i - 1, as in inner_node.
+template <typename Traits> class inner_page : public page_node<Traits> {
+  template <typename, typename, typename, typename, typename>
+  friend class paged_bplustree;
+
+public:
+  typedef typename Traits::key_type key_type;
+
+  explicit inner_page(char *pData);
+  page_id get_child(int pIndex) const;
+
+private:
+  // formats the page as an inner node whose only child is pHeir
+  void init(page_id pHeir);
+  void set_key(int pIndex, const key_type &pKey);
+  // inserts pKey at pIndex with pRight as the child to its right
+  void insert_at(int pIndex, const key_type &pKey, page_id pRight);
+  // removes key pIndex and the child to its right
+  void erase(int pIndex);
+  // moves the keys above the middle one into pNew and returns the middle
+  // key, which belongs in the parent
+  key_type split_into(inner_page &pNew);
+  void merge_from(const inner_page &pRight, const key_type &pSeparator);
+  key_type redistribute(inner_page &pRight, const key_type &pSeparator);
+
+  page_id *mChildren;
+};
+
+// B+tree kept in a file of fixed-size pages. Children and leaf neighbours
+// are page ids instead of pointers, so the file is the tree: open() on an
+// existing file picks up where the last flush() left off, with nothing to
+// parse or rebuild. Page 0 is the superblock with the root, the height and
+// the list of free pages; the other pages are nodes or free. Nodes are read
+// and changed in place through the Store, which decides how pages get
+// between the file and memory (see page_store.hpp).
+//
+// Changes reach the file by flush() or close() at the latest; a crash in
+// between can leave the file inconsistent. If the store cannot supply a
+// page, e.g. because a read failed, search, insert, remove and scan throw
+// page_error and an insert or remove may be left half done, so the file
+// is only as good as after a crash. Keys and values are stored as their
+// bytes, so both have to be trivially copyable.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Store = mmap_page_store,
+          typename Search = simd_search_policy>
+class paged_bplustree {
+  static_assert(std::is_trivially_copyable<Key>::value &&
+                    std::is_trivially_copyable<Value>::value,
+                "pages hold keys and values as raw bytes");
+
+public:
+  typedef paged_traits<Key, Value, Compare, Store::PAGE_SIZE, Search> traits;
+  typedef record<Key, Value> record_type;
+
+  paged_bplustree();
+  paged_bplustree(const paged_bplustree &) = delete;
+  paged_bplustree &operator=(const paged_bplustree &) = delete;
+  ~paged_bplustree();
+
+  // Opens the tree in pPath, creating an empty one if the file is missing
+  // or empty. False if the file cannot be opened or holds something other
+  // than a tree of this key size, value size and page size.
+  bool open(const std::string &pPath);
+  // writes back every change, then closes the file; false if the changes
+  // could not all be written
+  bool close();
+  bool is_open() const;
+  // writes back every change and the superblock
+  bool flush();
+
+  // copies the value of pKey into pValue; false if pKey is absent
+  bool search(const Key &pKey, Value &pValue) const;
+  // false, leaving the tree unchanged, if the key is already present or
+  // the file cannot grow
+  bool insert(const record_type &pRecord);
+  bool remove(const Key &pKey);
+  // calls pVisit(key, value) for the records with pLow <= key < pHigh in
+  // key order
+  template <typename Visitor>
+  void scan(const Key &pLow, const Key &pHigh, Visitor pVisit) const;
+
+  std::uint64_t get_record_count() const;
+  // inner levels above the leaves
+  std::uint32_t get_height() const;
+  Store &get_store();
+
+private:
+  typedef page_node<traits> node_type;
+  typedef leaf_page<traits> leaf_type;
+  typedef inner_page<traits> inner_type;
+  typedef page_ref<Store> ref_type;
+
+  static constexpr std::uint64_t MAGIC = 0x3130656572747062; // "bptree01"
+  static constexpr std::uint32_t VERSION = 1;
+  // Page ids have 32 bits and every inner page but the root has at least
+  // two children, so no tree grows more inner levels than this.
+  static constexpr int MAX_HEIGHT = 32;
+  // pages a new file starts with
+  static constexpr std::size_t INITIAL_PAGES = 64;
+
+  bool create();
+  bool load_superblock();
+  bool store_superblock();
+  // Walks down to the leaf that holds pKey. If pPath is given, the inner
+  // pages passed on the way and the child slots taken in them are stored
+  // in pPath and pSlots from the root down.
+  page_id find_leaf(const Key &pKey, page_id *pPath, int *pSlots) const;
+  void split_upwards(const page_id *pPath, const int *pSlots, page_id pLeft,
+                     Key pSeparator, page_id pRight);
+  // merges or evens out children pLeftSlot and pLeftSlot + 1 of pParent;
+  // true if they were merged
+  bool rebalance(inner_type &pParent, int pLeftSlot);
+  void collapse_root();
+  // makes sure pCount pages can be allocated without growing the file
+  bool reserve_pages(std::size_t pCount);
+  page_id allocate_page();
+  void free_page(page_id pId);
+
+  mutable Store mStore;
+  superblock mSuper;
+};
+
+} // namespace bpt
+
+#include "paged_bplustree_impl.hpp"
+
+#endif
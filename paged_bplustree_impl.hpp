@@ -0,0 +1,627 @@
+#ifndef PAGED_BPLUSTREE_IMPL_HPP
+#define PAGED_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace bpt {
+
+// page_node class ////////////////////////////////////////////////////////////
+template <typename Traits>
+page_node<Traits>::page_node(char *pData)
+    : mHeader(reinterpret_cast<page_header *>(pData)),
+      mKeys(reinterpret_cast<key_type *>(pData + Traits::KEYS_OFFSET)) {}
+
+template <typename Traits> bool page_node<Traits>::is_leaf() const {
+  return mHeader->mIsLeaf != 0;
+}
+
+template <typename Traits> int page_node<Traits>::get_size() const {
+  return mHeader->mSize;
+}
+
+template <typename Traits>
+const typename page_node<Traits>::key_type &
+page_node<Traits>::get_key(int pIndex) const {
+  return mKeys[pIndex];
+}
+
+template <typename Traits>
+int page_node<Traits>::lower_bound(const key_type &pKey) const {
+  return Traits::search_policy::lower_bound(mKeys, mHeader->mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+template <typename Traits>
+int page_node<Traits>::upper_bound(const key_type &pKey) const {
+  return Traits::search_policy::upper_bound(mKeys, mHeader->mSize, pKey,
+                                            typename Traits::key_compare());
+}
+
+template <typename Traits> page_id page_node<Traits>::get_prev() const {
+  return mHeader->mPrev;
+}
+
+template <typename Traits> page_id page_node<Traits>::get_next() const {
+  return mHeader->mNext;
+}
+
+// leaf_page class ////////////////////////////////////////////////////////////
+template <typename Traits>
+leaf_page<Traits>::leaf_page(char *pData)
+    : page_node<Traits>(pData),
+      mValues(reinterpret_cast<value_type *>(pData + Traits::VALUES_OFFSET)) {}
+
+template <typename Traits>
+const typename leaf_page<Traits>::value_type &
+leaf_page<Traits>::get_value(int pIndex) const {
+  return mValues[pIndex];
+}
+
+template <typename Traits> void leaf_page<Traits>::init() {
+  std::memset(this->mHeader, 0, sizeof(page_header));
+  this->mHeader->mIsLeaf = 1;
+}
+
+template <typename Traits>
+void leaf_page<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                  const value_type &pValue) {
+  int size = this->mHeader->mSize;
+  std::move_backward(this->mKeys + pIndex, this->mKeys + size,
+                     this->mKeys + size + 1);
+  std::move_backward(mValues + pIndex, mValues + size, mValues + size + 1);
+  this->mKeys[pIndex] = pKey;
+  mValues[pIndex] = pValue;
+  this->mHeader->mSize++;
+}
+
+template <typename Traits> void leaf_page<Traits>::erase(int pIndex) {
+  int size = this->mHeader->mSize;
+  std::move(this->mKeys + pIndex + 1, this->mKeys + size,
+            this->mKeys + pIndex);
+  std::move(mValues + pIndex + 1, mValues + size, mValues + pIndex);
+  this->mHeader->mSize--;
+}
+
+template <typename Traits>
+typename leaf_page<Traits>::key_type
+leaf_page<Traits>::split_into(leaf_page &pNew) {
+  int size = this->mHeader->mSize, from = size / 2;
+  std::copy(this->mKeys + from, this->mKeys + size, pNew.mKeys);
+  std::copy(mValues + from, mValues + size, pNew.mValues);
+  pNew.mHeader->mSize = size - from;
+  this->mHeader->mSize = from;
+  return pNew.mKeys[0];
+}
+
+template <typename Traits>
+void leaf_page<Traits>::merge_from(const leaf_page &pRight) {
+  int size = this->mHeader->mSize, rsize = pRight.mHeader->mSize;
+  std::copy(pRight.mKeys, pRight.mKeys + rsize, this->mKeys + size);
+  std::copy(pRight.mValues, pRight.mValues + rsize, mValues + size);
+  this->mHeader->mSize += rsize;
+}
+
+template <typename Traits>
+typename leaf_page<Traits>::key_type
+leaf_page<Traits>::redistribute(leaf_page &pRight) {
+  int size = this->mHeader->mSize, rsize = pRight.mHeader->mSize;
+  int target = (size + rsize) / 2;
+  if (size < target) {
+    // pull the first records of pRight over
+    int count = target - size;
+    std::copy(pRight.mKeys, pRight.mKeys + count, this->mKeys + size);
+    std::copy(pRight.mValues, pRight.mValues + count, mValues + size);
+    std::copy(pRight.mKeys + count, pRight.mKeys + rsize, pRight.mKeys);
+    std::copy(pRight.mValues + count, pRight.mValues + rsize, pRight.mValues);
+    pRight.mHeader->mSize = rsize - count;
+  } else {
+    // push our last records in front of those of pRight
+    int count = size - target;
+    std::copy_backward(pRight.mKeys, pRight.mKeys + rsize,
+                       pRight.mKeys + rsize + count);
+    std::copy_backward(pRight.mValues, pRight.mValues + rsize,
+                       pRight.mValues + rsize + count);
+    std::copy(this->mKeys + target, this->mKeys + size, pRight.mKeys);
+    std::copy(mValues + target, mValues + size, pRight.mValues);
+    pRight.mHeader->mSize = rsize + count;
+  }
+  this->mHeader->mSize = target;
+  return pRight.mKeys[0];
+}
+
+// inner_page class ///////////////////////////////////////////////////////////
+template <typename Traits>
+inner_page<Traits>::inner_page(char *pData)
+    : page_node<Traits>(pData),
+      mChildren(reinterpret_cast<page_id *>(pData + Traits::CHILDREN_OFFSET)) {
+}
+
+template <typename Traits>
+page_id inner_page<Traits>::get_child(int pIndex) const {
+  return mChildren[pIndex];
+}
+
+template <typename Traits> void inner_page<Traits>::init(page_id pHeir) {
+  std::memset(this->mHeader, 0, sizeof(page_header));
+  mChildren[0] = pHeir;
+}
+
+template <typename Traits>
+void inner_page<Traits>::set_key(int pIndex, const key_type &pKey) {
+  this->mKeys[pIndex] = pKey;
+}
+
+template <typename Traits>
+void inner_page<Traits>::insert_at(int pIndex, const key_type &pKey,
+                                   page_id pRight) {
+  int size = this->mHeader->mSize;
+  std::move_backward(this->mKeys + pIndex, this->mKeys + size,
+                     this->mKeys + size + 1);
+  std::copy_backward(mChildren + pIndex + 1, mChildren + size + 1,
+                     mChildren + size + 2);
+  this->mKeys[pIndex] = pKey;
+  mChildren[pIndex + 1] = pRight;
+  this->mHeader->mSize++;
+}
+
+template <typename Traits> void inner_page<Traits>::erase(int pIndex) {
+  int size = this->mHeader->mSize;
+  std::move(this->mKeys + pIndex + 1, this->mKeys + size,
+            this->mKeys + pIndex);
+  std::copy(mChildren + pIndex + 2, mChildren + size + 1,
+            mChildren + pIndex + 1);
+  this->mHeader->mSize--;
+}
+
+template <typename Traits>
+typename inner_page<Traits>::key_type
+inner_page<Traits>::split_into(inner_page &pNew) {
+  int size = this->mHeader->mSize, from = size / 2;
+  std::copy(this->mKeys + from + 1, this->mKeys + size, pNew.mKeys);
+  std::copy(mChildren + from + 1, mChildren + size + 1, pNew.mChildren);
+  pNew.mHeader->mSize = size - from - 1;
+  this->mHeader->mSize = from;
+  return this->mKeys[from];
+}
+
+template <typename Traits>
+void inner_page<Traits>::merge_from(const inner_page &pRight,
+                                    const key_type &pSeparator) {
+  int size = this->mHeader->mSize, rsize = pRight.mHeader->mSize;
+  this->mKeys[size] = pSeparator;
+  std::copy(pRight.mKeys, pRight.mKeys + rsize, this->mKeys + size + 1);
+  std::copy(pRight.mChildren, pRight.mChildren + rsize + 1,
+            mChildren + size + 1);
+  this->mHeader->mSize += rsize + 1;
+}
+
+// The separator comes down between the two key runs and whichever key ends
+// up in the middle goes back up.
+template <typename Traits>
+typename inner_page<Traits>::key_type
+inner_page<Traits>::redistribute(inner_page &pRight,
+                                 const key_type &pSeparator) {
+  int size = this->mHeader->mSize, rsize = pRight.mHeader->mSize;
+  int target = (size + 1 + rsize) / 2;
+  key_type separator;
+  if (size < target) {
+    int count = target - size;
+    this->mKeys[size] = pSeparator;
+    std::copy(pRight.mKeys, pRight.mKeys + count - 1, this->mKeys + size + 1);
+    std::copy(pRight.mChildren, pRight.mChildren + count,
+              mChildren + size + 1);
+    separator = pRight.mKeys[count - 1];
+    std::copy(pRight.mKeys + count, pRight.mKeys + rsize, pRight.mKeys);
+    std::copy(pRight.mChildren + count, pRight.mChildren + rsize + 1,
+              pRight.mChildren);
+    pRight.mHeader->mSize = rsize - count;
+  } else {
+    int count = size - target;
+    std::copy_backward(pRight.mKeys, pRight.mKeys + rsize,
+                       pRight.mKeys + rsize + count);
+    std::copy_backward(pRight.mChildren, pRight.mChildren + rsize + 1,
+                       pRight.mChildren + rsize + 1 + count);
+    std::copy(this->mKeys + target + 1, this->mKeys + size, pRight.mKeys);
+    pRight.mKeys[count - 1] = pSeparator;
+    std::copy(mChildren + target + 1, mChildren + size + 1, pRight.mChildren);
+    separator = this->mKeys[target];
+    pRight.mHeader->mSize = rsize + count;
+  }
+  this->mHeader->mSize = target;
+  return separator;
+}
+
+// paged_bplustree class //////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+paged_bplustree<Key, Value, Compare, Store, Search>::paged_bplustree()
+    : mStore(), mSuper() {}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+paged_bplustree<Key, Value, Compare, Store, Search>::~paged_bplustree() {
+  close();
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::open(
+    const std::string &pPath) {
+  close();
+  if (!mStore.open(pPath)) {
+    return false;
+  }
+  if (mStore.get_page_count() == 0 ? create() : load_superblock()) {
+    return true;
+  }
+  mStore.close();
+  return false;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::close() {
+  if (!mStore.is_open()) {
+    return true;
+  }
+  bool ok = flush();
+  return mStore.close() && ok;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::is_open() const {
+  return mStore.is_open();
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::flush() {
+  bool stored = store_superblock();
+  return mStore.flush() && stored;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::search(
+    const Key &pKey, Value &pValue) const {
+  ref_type ref(mStore, find_leaf(pKey, nullptr, nullptr));
+  leaf_type leaf(ref.get_data());
+  int index = leaf.lower_bound(pKey);
+  if (index == leaf.get_size() || traits::less(pKey, leaf.get_key(index))) {
+    return false;
+  }
+  pValue = leaf.get_value(index);
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::insert(
+    const record_type &pRecord) {
+  const Key &key = pRecord.get_key();
+  page_id path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  page_id id = find_leaf(key, path, slots);
+  ref_type ref(mStore, id);
+  leaf_type leaf(ref.get_data());
+  int index = leaf.lower_bound(key);
+  if (index < leaf.get_size() && !traits::less(key, leaf.get_key(index))) {
+    return false;
+  }
+  // a split takes at most one new page per level and a new root
+  if (!reserve_pages(mSuper.mHeight + 2)) {
+    return false;
+  }
+  ref.mark_dirty();
+  leaf.insert_at(index, key, pRecord.get_value());
+  mSuper.mRecordCount++;
+  if (leaf.get_size() <= traits::LEAF_MAX) {
+    return true;
+  }
+
+  page_id right = allocate_page();
+  ref_type rightRef(mStore, right);
+  rightRef.mark_dirty();
+  leaf_type rightLeaf(rightRef.get_data());
+  rightLeaf.init();
+  Key separator = leaf.split_into(rightLeaf);
+  rightLeaf.mHeader->mPrev = id;
+  rightLeaf.mHeader->mNext = leaf.get_next();
+  if (leaf.get_next() != NULL_PAGE) {
+    ref_type nextRef(mStore, leaf.get_next());
+    nextRef.mark_dirty();
+    leaf_type(nextRef.get_data()).mHeader->mPrev = right;
+  }
+  leaf.mHeader->mNext = right;
+  split_upwards(path, slots, id, separator, right);
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::remove(
+    const Key &pKey) {
+  page_id path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  {
+    ref_type ref(mStore, find_leaf(pKey, path, slots));
+    leaf_type leaf(ref.get_data());
+    int index = leaf.lower_bound(pKey);
+    if (index == leaf.get_size() || traits::less(pKey, leaf.get_key(index))) {
+      return false;
+    }
+    ref.mark_dirty();
+    leaf.erase(index);
+    mSuper.mRecordCount--;
+    if (leaf.get_size() >= traits::LEAF_MIN) {
+      return true;
+    }
+  }
+  // climb for as long as the page below is underfull
+  for (int level = int(mSuper.mHeight) - 1; level >= 0; level--) {
+    ref_type ref(mStore, path[level]);
+    ref.mark_dirty();
+    inner_type parent(ref.get_data());
+    int leftSlot = std::min(slots[level], parent.get_size() - 1);
+    if (!rebalance(parent, leftSlot) ||
+        parent.get_size() >= traits::INNER_MIN) {
+      break;
+    }
+  }
+  collapse_root();
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+template <typename Visitor>
+void paged_bplustree<Key, Value, Compare, Store, Search>::scan(
+    const Key &pLow, const Key &pHigh, Visitor pVisit) const {
+  page_id id = find_leaf(pLow, nullptr, nullptr);
+  ref_type first(mStore, id);
+  int index = leaf_type(first.get_data()).lower_bound(pLow);
+  while (id != NULL_PAGE) {
+    ref_type ref(mStore, id);
+    leaf_type leaf(ref.get_data());
+    // the next leaf loads while this one is visited
+    if (leaf.get_next() != NULL_PAGE) {
+      mStore.prefetch(leaf.get_next());
+    }
+    for (; index < leaf.get_size(); index++) {
+      if (!traits::less(leaf.get_key(index), pHigh)) {
+        return;
+      }
+      pVisit(leaf.get_key(index), leaf.get_value(index));
+    }
+    id = leaf.get_next();
+    index = 0;
+  }
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+std::uint64_t
+paged_bplustree<Key, Value, Compare, Store, Search>::get_record_count() const {
+  return mSuper.mRecordCount;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+std::uint32_t
+paged_bplustree<Key, Value, Compare, Store, Search>::get_height() const {
+  return mSuper.mHeight;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+Store &paged_bplustree<Key, Value, Compare, Store, Search>::get_store() {
+  return mStore;
+}
+
+// a superblock and an empty root leaf
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::create() {
+  if (!mStore.resize(INITIAL_PAGES)) {
+    return false;
+  }
+  mSuper = superblock();
+  mSuper.mMagic = MAGIC;
+  mSuper.mVersion = VERSION;
+  mSuper.mPageSize = traits::PAGE_SIZE;
+  mSuper.mKeySize = sizeof(Key);
+  mSuper.mValueSize = sizeof(Value);
+  mSuper.mPageCount = 1;
+  mSuper.mRoot = allocate_page();
+  char *data = mStore.pin(mSuper.mRoot);
+  if (!data) {
+    return false;
+  }
+  leaf_type(data).init();
+  mStore.unpin(mSuper.mRoot, true);
+  return store_superblock();
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::load_superblock() {
+  const char *data = mStore.pin(0);
+  if (!data) {
+    return false;
+  }
+  std::memcpy(&mSuper, data, sizeof(superblock));
+  mStore.unpin(0, false);
+  return mSuper.mMagic == MAGIC && mSuper.mVersion == VERSION &&
+         mSuper.mPageSize == traits::PAGE_SIZE &&
+         mSuper.mKeySize == sizeof(Key) &&
+         mSuper.mValueSize == sizeof(Value) &&
+         mSuper.mPageCount <= mStore.get_page_count() &&
+         mSuper.mRoot != NULL_PAGE && mSuper.mRoot < mSuper.mPageCount;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::store_superblock() {
+  char *data = mStore.pin(0);
+  if (!data) {
+    return false;
+  }
+  std::memcpy(data, &mSuper, sizeof(superblock));
+  mStore.unpin(0, true);
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+page_id paged_bplustree<Key, Value, Compare, Store, Search>::find_leaf(
+    const Key &pKey, page_id *pPath, int *pSlots) const {
+  page_id id = mSuper.mRoot;
+  for (std::uint32_t level = 0; level < mSuper.mHeight; level++) {
+    ref_type ref(mStore, id);
+    inner_type inner(ref.get_data());
+    int slot = inner.upper_bound(pKey);
+    if (pPath) {
+      pPath[level] = id;
+      pSlots[level] = slot;
+    }
+    id = inner.get_child(slot);
+  }
+  return id;
+}
+
+// Hangs pRight, split off pLeft, into the parent of pLeft and splits every
+// ancestor that overflows, growing a new root if the old one splits.
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+void paged_bplustree<Key, Value, Compare, Store, Search>::split_upwards(
+    const page_id *pPath, const int *pSlots, page_id pLeft, Key pSeparator,
+    page_id pRight) {
+  for (int level = int(mSuper.mHeight) - 1; level >= 0; level--) {
+    ref_type ref(mStore, pPath[level]);
+    ref.mark_dirty();
+    inner_type inner(ref.get_data());
+    inner.insert_at(pSlots[level], pSeparator, pRight);
+    if (inner.get_size() <= traits::INNER_MAX) {
+      return;
+    }
+    page_id right = allocate_page();
+    ref_type rightRef(mStore, right);
+    rightRef.mark_dirty();
+    inner_type rightInner(rightRef.get_data());
+    rightInner.init(NULL_PAGE);
+    pSeparator = inner.split_into(rightInner);
+    pLeft = pPath[level];
+    pRight = right;
+  }
+  page_id root = allocate_page();
+  ref_type ref(mStore, root);
+  ref.mark_dirty();
+  inner_type inner(ref.get_data());
+  inner.init(pLeft);
+  inner.insert_at(0, pSeparator, pRight);
+  mSuper.mRoot = root;
+  mSuper.mHeight++;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::rebalance(
+    inner_type &pParent, int pLeftSlot) {
+  page_id leftId = pParent.get_child(pLeftSlot);
+  page_id rightId = pParent.get_child(pLeftSlot + 1);
+  ref_type leftRef(mStore, leftId), rightRef(mStore, rightId);
+  leftRef.mark_dirty();
+  rightRef.mark_dirty();
+  if (node_type(leftRef.get_data()).is_leaf()) {
+    leaf_type left(leftRef.get_data()), right(rightRef.get_data());
+    if (left.get_size() + right.get_size() > traits::LEAF_MAX) {
+      pParent.set_key(pLeftSlot, left.redistribute(right));
+      return false;
+    }
+    left.merge_from(right);
+    left.mHeader->mNext = right.get_next();
+    if (right.get_next() != NULL_PAGE) {
+      ref_type nextRef(mStore, right.get_next());
+      nextRef.mark_dirty();
+      leaf_type(nextRef.get_data()).mHeader->mPrev = leftId;
+    }
+  } else {
+    inner_type left(leftRef.get_data()), right(rightRef.get_data());
+    const Key &separator = pParent.get_key(pLeftSlot);
+    if (left.get_size() + right.get_size() + 1 > traits::INNER_MAX) {
+      pParent.set_key(pLeftSlot, left.redistribute(right, separator));
+      return false;
+    }
+    left.merge_from(right, separator);
+  }
+  pParent.erase(pLeftSlot);
+  free_page(rightId);
+  return true;
+}
+
+// replaces an inner root that has lost its last key by its only child
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+void paged_bplustree<Key, Value, Compare, Store, Search>::collapse_root() {
+  if (mSuper.mHeight == 0) {
+    return;
+  }
+  page_id root = mSuper.mRoot;
+  {
+    ref_type ref(mStore, root);
+    inner_type inner(ref.get_data());
+    if (inner.get_size() > 0) {
+      return;
+    }
+    mSuper.mRoot = inner.get_child(0);
+  }
+  mSuper.mHeight--;
+  free_page(root);
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+bool paged_bplustree<Key, Value, Compare, Store, Search>::reserve_pages(
+    std::size_t pCount) {
+  std::size_t needed = std::size_t(mSuper.mPageCount) + pCount;
+  if (needed <= mStore.get_page_count()) {
+    return true;
+  }
+  if (needed > std::numeric_limits<page_id>::max()) {
+    return false;
+  }
+  // grow geometrically, or by just enough if the store cannot
+  return mStore.resize(std::max(needed, 2 * mStore.get_page_count())) ||
+         mStore.resize(needed);
+}
+
+// from the free list if it has any, else behind the last page handed out;
+// reserve_pages() must have made room for the latter
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+page_id paged_bplustree<Key, Value, Compare, Store, Search>::allocate_page() {
+  if (mSuper.mFreeHead == NULL_PAGE) {
+    return mSuper.mPageCount++;
+  }
+  page_id id = mSuper.mFreeHead;
+  ref_type ref(mStore, id);
+  std::memcpy(&mSuper.mFreeHead, ref.get_data(), sizeof(page_id));
+  return id;
+}
+
+template <typename Key, typename Value, typename Compare, typename Store,
+          typename Search>
+void paged_bplustree<Key, Value, Compare, Store, Search>::free_page(
+    page_id pId) {
+  ref_type ref(mStore, pId);
+  ref.mark_dirty();
+  std::memcpy(ref.get_data(), &mSuper.mFreeHead, sizeof(page_id));
+  mSuper.mFreeHead = pId;
+}
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace bpt {
+
+namespace detail {
+
+// pRequested threads, or one per hardware thread if pRequested is 0
+inline unsigned get_thread_count(unsigned pRequested) {
+  if (pRequested > 0) {
+    return pRequested;
+  }
+  unsigned hardware = std::thread::hardware_concurrency();
+  return hardware > 0 ? hardware : 1;
+}
+
+// first index of chunk pIndex when [0, pCount) is cut into pChunks
+// contiguous chunks whose sizes differ by at most one
+inline std::size_t chunk_begin(std::size_t pCount, unsigned pChunks,
+                               unsigned pIndex) {
+  return pCount * pIndex / pChunks;
+}
+
+// Runs pBody(chunk, begin, end) for each of the pThreads chunks of
+// [0, pCount) on its own thread. Chunk 0 runs on the calling thread, and
+// the call returns once every chunk is done.
+template <typename Body>
+void parallel_for(std::size_t pCount, unsigned pThreads, Body pBody) {
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < pThreads; t++) {
+    workers.emplace_back(pBody, t, chunk_begin(pCount, pThreads, t),
+                         chunk_begin(pCount, pThreads, t + 1));
+  }
+  pBody(0u, std::size_t(0), chunk_begin(pCount, pThreads, 1));
+  for (std::thread &w : workers) {
+    w.join();
+  }
+}
+
+// Sorts pThreads chunks concurrently, then merges neighbouring runs
+// pairwise, all pairs of a round at once, until one run is left.
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt pBegin, RandomIt pEnd, unsigned pThreads,
+                   Compare pCompare) {
+  std::size_t count = pEnd - pBegin;
+  if (pThreads <= 1 || count < 2 * std::size_t(pThreads)) {
+    std::sort(pBegin, pEnd, pCompare);
+    return;
+  }
+  parallel_for(pThreads, pThreads,
+               [&](unsigned, std::size_t pFirst, std::size_t pLast) {
+                 for (std::size_t c = pFirst; c < pLast; c++) {
+                   std::sort(pBegin + chunk_begin(count, pThreads, c),
+                             pBegin + chunk_begin(count, pThreads, c + 1),
+                             pCompare);
+                 }
+               });
+  for (unsigned width = 1; width < pThreads; width *= 2) {
+    unsigned merges = (pThreads + 2 * width - 1) / (2 * width);
+    parallel_for(merges, merges,
+                 [&](unsigned, std::size_t pFirst, std::size_t pLast) {
+                   for (std::size_t m = pFirst; m < pLast; m++) {
+                     unsigned lo = m * 2 * width;
+                     unsigned mid = std::min(lo + width, pThreads);
+                     unsigned hi = std::min(lo + 2 * width, pThreads);
+                     std::inplace_merge(
+                         pBegin + chunk_begin(count, pThreads, lo),
+                         pBegin + chunk_begin(count, pThreads, mid),
+                         pBegin + chunk_begin(count, pThreads, hi), pCompare);
+                   }
+                 });
+  }
+}
+
+} // namespace detail
+
+} // namespace bpt
+
+#endif
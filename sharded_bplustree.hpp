@@ -0,0 +1,138 @@
+#ifndef SHARDED_BPLUSTREE_HPP
+#define SHARDED_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+#include "mpsc_queue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace bpt {
+
+// Range-partitioned front end over several single-threaded bplustree
+// instances. Every shard owns the keys of one range and is served by one
+// worker thread, which is the only thread that ever touches the shard's
+// tree; callers route a request by key onto the shard's request queue and
+// get a future back. The trees need no synchronization of their own, so
+// the shards scale without sharing anything but the routing table.
+//
+// rebalance() moves half the records of a shard that served far more
+// requests than the average over to its cooler neighbour and shifts the
+// boundary between them. Callbacks of the batch calls run on the worker
+// threads and must not call back into the sharded tree.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          int Fanout = 30, typename Search = simd_search_policy>
+class sharded_bplustree {
+public:
+  typedef bplustree<Key, Value, Compare, Fanout, Search> tree_type;
+  typedef record<Key, Value> record_type;
+
+  // A shard per range: shard 0 holds the keys below pBounds[0], shard i
+  // those in [pBounds[i - 1], pBounds[i]) and the last shard the rest.
+  // pBounds must be strictly increasing.
+  explicit sharded_bplustree(const std::vector<Key> &pBounds);
+  sharded_bplustree(const sharded_bplustree &) = delete;
+  sharded_bplustree &operator=(const sharded_bplustree &) = delete;
+  // serves every request already queued, then stops the workers
+  ~sharded_bplustree();
+
+  std::future<std::optional<Value>> search(const Key &pKey);
+  std::future<bool> insert(const record_type &pRecord);
+  std::future<bool> remove(const Key &pKey);
+
+  // Each shard serves its part of a batch in one request and reports every
+  // element through pCallback(index, result); the future becomes ready
+  // once all of them have been reported. The input must stay alive until
+  // then.
+  std::future<void>
+  search_batch(const Key *pKeys, std::size_t pCount,
+               std::function<void(std::size_t, const Value *)> pCallback);
+  std::future<void>
+  insert_batch(const record_type *pRecords, std::size_t pCount,
+               std::function<void(std::size_t, bool)> pCallback);
+  std::future<void>
+  remove_batch(const Key *pKeys, std::size_t pCount,
+               std::function<void(std::size_t, bool)> pCallback);
+
+  // Looks at the requests each shard served since the last call and, if
+  // the busiest one served more than HOT_FACTOR times the average, moves
+  // half of its records to its less busy neighbour. Returns true if
+  // records are moving. The routing table is locked only to shift the
+  // boundary; requests for the moved keys then wait on the neighbour until
+  // the records arrive, and all others carry on.
+  bool rebalance();
+  // calls rebalance() after every pInterval routed requests; 0 disables
+  void set_auto_rebalance(std::size_t pInterval);
+
+  std::size_t get_shard_count() const;
+  std::vector<Key> get_bounds() const;
+
+private:
+  // a unit of work run by a worker on its tree
+  class request {
+  public:
+    virtual ~request() = default;
+    // returns the number of caller requests it served
+    virtual std::size_t execute(tree_type &pTree) = 0;
+  };
+
+  template <typename Function> class task : public request {
+  public:
+    explicit task(Function pFunction);
+    std::size_t execute(tree_type &pTree) override;
+
+  private:
+    Function mFunction;
+  };
+
+  struct shard {
+    tree_type mTree;
+    // a null request stops the worker
+    mpsc_queue<std::unique_ptr<request>> mQueue;
+    std::atomic<bool> mSleeping;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::atomic<std::uint64_t> mServed;
+    std::uint64_t mLastServed;
+    std::thread mWorker;
+  };
+
+  static constexpr int HOT_FACTOR = 2;
+
+  std::size_t route(const Key &pKey) const;
+  template <typename Function> void post(std::size_t pShard, Function pTask);
+  template <typename Function>
+  void post_routed(const Key &pKey, Function pTask);
+  void post_request(std::size_t pShard, std::unique_ptr<request> pRequest);
+  void note_routed(std::size_t pCount);
+  template <typename Input, typename Operation>
+  std::future<void> post_batch(const Input *pInput, std::size_t pCount,
+                               Operation pOperation);
+  static const Key &get_key_of(const Key &pKey);
+  static const Key &get_key_of(const record_type &pRecord);
+  static void run(shard *pShard);
+
+  std::vector<std::unique_ptr<shard>> mShards;
+  // upper bounds of all shards but the last; read by every caller, written
+  // only by rebalance()
+  std::vector<Key> mBounds;
+  mutable std::shared_mutex mRouting;
+  std::mutex mBalancing;
+  std::atomic<std::size_t> mRebalanceInterval;
+  std::atomic<std::size_t> mRouted;
+};
+
+} // namespace bpt
+
+#include "sharded_bplustree_impl.hpp"
+
+#endif
@@ -0,0 +1,432 @@
+#ifndef SHARDED_BPLUSTREE_IMPL_HPP
+#define SHARDED_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+
+namespace bpt {
+
+// task class /////////////////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+template <typename Function>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::task<Function>::task(
+    Function pFunction)
+    : mFunction(std::move(pFunction)) {}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+template <typename Function>
+std::size_t
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::task<Function>::execute(
+    tree_type &pTree) {
+  return mFunction(pTree);
+}
+
+// sharded_bplustree class ////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::sharded_bplustree(
+    const std::vector<Key> &pBounds)
+    : mBounds(pBounds), mRebalanceInterval(0), mRouted(0) {
+  for (std::size_t i = 0; i <= pBounds.size(); i++) {
+    shard *s = new shard();
+    s->mSleeping.store(false, std::memory_order_relaxed);
+    s->mServed.store(0, std::memory_order_relaxed);
+    s->mLastServed = 0;
+    mShards.emplace_back(s);
+  }
+  for (std::unique_ptr<shard> &s : mShards) {
+    s->mWorker = std::thread(&sharded_bplustree::run, s.get());
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::~sharded_bplustree() {
+  for (std::size_t i = 0; i < mShards.size(); i++) {
+    post_request(i, nullptr);
+  }
+  for (std::unique_ptr<shard> &s : mShards) {
+    s->mWorker.join();
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<std::optional<Value>>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::search(
+    const Key &pKey) {
+  std::promise<std::optional<Value>> promise;
+  std::future<std::optional<Value>> result = promise.get_future();
+  post_routed(pKey, [pKey, promise = std::move(promise)](
+                        tree_type &pTree) mutable -> std::size_t {
+    const Value *value = pTree.search(pKey);
+    promise.set_value(value ? std::optional<Value>(*value) : std::nullopt);
+    return 1;
+  });
+  return result;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<bool>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::insert(
+    const record_type &pRecord) {
+  std::promise<bool> promise;
+  std::future<bool> result = promise.get_future();
+  post_routed(pRecord.get_key(), [pRecord, promise = std::move(promise)](
+                                     tree_type &pTree) mutable -> std::size_t {
+    promise.set_value(pTree.insert(pRecord));
+    return 1;
+  });
+  return result;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<bool>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::remove(
+    const Key &pKey) {
+  std::promise<bool> promise;
+  std::future<bool> result = promise.get_future();
+  post_routed(pKey, [pKey, promise = std::move(promise)](
+                        tree_type &pTree) mutable -> std::size_t {
+    promise.set_value(pTree.remove(pKey));
+    return 1;
+  });
+  return result;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<void>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::search_batch(
+    const Key *pKeys, std::size_t pCount,
+    std::function<void(std::size_t, const Value *)> pCallback) {
+  return post_batch(pKeys, pCount,
+                    [pCallback](tree_type &pTree, const Key &pKey,
+                                std::size_t pIndex) {
+                      pCallback(pIndex, pTree.search(pKey));
+                    });
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<void>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::insert_batch(
+    const record_type *pRecords, std::size_t pCount,
+    std::function<void(std::size_t, bool)> pCallback) {
+  return post_batch(pRecords, pCount,
+                    [pCallback](tree_type &pTree, const record_type &pRecord,
+                                std::size_t pIndex) {
+                      pCallback(pIndex, pTree.insert(pRecord));
+                    });
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::future<void>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::remove_batch(
+    const Key *pKeys, std::size_t pCount,
+    std::function<void(std::size_t, bool)> pCallback) {
+  return post_batch(pKeys, pCount,
+                    [pCallback](tree_type &pTree, const Key &pKey,
+                                std::size_t pIndex) {
+                      pCallback(pIndex, pTree.remove(pKey));
+                    });
+}
+
+// The hot worker first picks the split key, walking only the half that
+// will move, while requests keep flowing. The routing table is then locked
+// just long enough to move the boundary and queue the hand-over on both
+// shards: the hot worker extracts the half after serving every request
+// routed before the swap, and the cool worker takes the records in before
+// any request routed after it, so requests for moved keys simply wait on
+// the cool shard while the records are on their way.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+bool sharded_bplustree<Key, Value, Compare, Fanout, Search>::rebalance() {
+  std::unique_lock<std::mutex> balancing(mBalancing, std::try_to_lock);
+  if (!balancing) {
+    // somebody else is already at it
+    return false;
+  }
+  // only rebalance() changes the shards and bounds, so while it holds
+  // mBalancing it may read them without mRouting
+  std::size_t count = mShards.size();
+  if (count < 2) {
+    return false;
+  }
+  std::vector<std::uint64_t> load(count);
+  std::uint64_t total = 0;
+  std::size_t hot = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    std::uint64_t served = mShards[i]->mServed.load(std::memory_order_relaxed);
+    load[i] = served - mShards[i]->mLastServed;
+    mShards[i]->mLastServed = served;
+    total += load[i];
+    if (load[i] > load[hot]) {
+      hot = i;
+    }
+  }
+  if (total == 0 || load[hot] * count <= HOT_FACTOR * total) {
+    return false;
+  }
+  std::size_t cool;
+  if (hot == 0) {
+    cool = 1;
+  } else if (hot == count - 1) {
+    cool = count - 2;
+  } else {
+    cool = load[hot - 1] <= load[hot + 1] ? hot - 1 : hot + 1;
+  }
+  bool upper = cool > hot;
+
+  // the hot shard gives away the half next to cool
+  std::promise<std::optional<Key>> picked;
+  std::future<std::optional<Key>> chosen = picked.get_future();
+  post(hot, [&picked, upper](tree_type &pTree) -> std::size_t {
+    std::size_t half = pTree.get_stats().mRecords / 2;
+    if (half == 0) {
+      picked.set_value(std::nullopt);
+      return 0;
+    }
+    typename tree_type::const_iterator split;
+    if (upper) {
+      split = pTree.end();
+      for (std::size_t i = 0; i < half; i++) {
+        --split;
+      }
+    } else {
+      split = pTree.begin();
+      for (std::size_t i = 0; i < half; i++) {
+        ++split;
+      }
+    }
+    // never cut through a run of equal keys
+    typename tree_type::const_iterator begin = pTree.begin();
+    while (split != begin) {
+      typename tree_type::const_iterator previous = split;
+      --previous;
+      if (tree_type::traits::less(previous.get_key(), split.get_key())) {
+        break;
+      }
+      split = previous;
+    }
+    if (split == begin) {
+      picked.set_value(std::nullopt);
+    } else {
+      picked.set_value(split.get_key());
+    }
+    return 0;
+  });
+  std::optional<Key> split = chosen.get();
+  if (!split) {
+    return false;
+  }
+
+  std::shared_ptr<std::promise<std::vector<record_type>>> extracted =
+      std::make_shared<std::promise<std::vector<record_type>>>();
+  std::shared_future<std::vector<record_type>> moved =
+      extracted->get_future().share();
+  {
+    std::unique_lock<std::shared_mutex> routing(mRouting);
+    mBounds[upper ? hot : hot - 1] = *split;
+    post(hot, [extracted, upper, key = *split](
+                  tree_type &pTree) -> std::size_t {
+      typename tree_type::const_iterator first = pTree.begin();
+      typename tree_type::const_iterator last = pTree.end();
+      if (upper) {
+        first = pTree.lower_bound(key);
+      } else {
+        last = pTree.lower_bound(key);
+      }
+      std::vector<record_type> records(first, last);
+      for (const record_type &r : records) {
+        pTree.remove(r.get_key());
+      }
+      extracted->set_value(std::move(records));
+      return 0;
+    });
+    post(cool, [moved](tree_type &pTree) -> std::size_t {
+      for (const record_type &r : moved.get()) {
+        pTree.insert(r);
+      }
+      return 0;
+    });
+  }
+  return true;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void sharded_bplustree<Key, Value, Compare, Fanout,
+                       Search>::set_auto_rebalance(std::size_t pInterval) {
+  mRebalanceInterval.store(pInterval, std::memory_order_relaxed);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::get_shard_count()
+    const {
+  return mShards.size();
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::vector<Key>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::get_bounds() const {
+  std::shared_lock<std::shared_mutex> routing(mRouting);
+  return mBounds;
+}
+
+// callers hold mRouting
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+std::size_t
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::route(
+    const Key &pKey) const {
+  return std::upper_bound(mBounds.begin(), mBounds.end(), pKey, Compare()) -
+         mBounds.begin();
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+template <typename Function>
+void sharded_bplustree<Key, Value, Compare, Fanout, Search>::post(
+    std::size_t pShard, Function pTask) {
+  post_request(pShard, std::unique_ptr<request>(
+                           new task<Function>(std::move(pTask))));
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+template <typename Function>
+void sharded_bplustree<Key, Value, Compare, Fanout, Search>::post_routed(
+    const Key &pKey, Function pTask) {
+  {
+    std::shared_lock<std::shared_mutex> routing(mRouting);
+    post(route(pKey), std::move(pTask));
+  }
+  note_routed(1);
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void sharded_bplustree<Key, Value, Compare, Fanout, Search>::post_request(
+    std::size_t pShard, std::unique_ptr<request> pRequest) {
+  shard &s = *mShards[pShard];
+  s.mQueue.push(std::move(pRequest));
+  if (s.mSleeping.load(std::memory_order_seq_cst)) {
+    // the worker holds the mutex from going to sleep until it waits
+    { std::lock_guard<std::mutex> lock(s.mMutex); }
+    s.mWake.notify_one();
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void sharded_bplustree<Key, Value, Compare, Fanout, Search>::note_routed(
+    std::size_t pCount) {
+  std::size_t interval = mRebalanceInterval.load(std::memory_order_relaxed);
+  if (interval == 0) {
+    return;
+  }
+  std::size_t before = mRouted.fetch_add(pCount, std::memory_order_relaxed);
+  if (before / interval != (before + pCount) / interval) {
+    rebalance();
+  }
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+template <typename Input, typename Operation>
+std::future<void>
+sharded_bplustree<Key, Value, Compare, Fanout, Search>::post_batch(
+    const Input *pInput, std::size_t pCount, Operation pOperation) {
+  struct batch {
+    std::atomic<std::size_t> mPending;
+    std::promise<void> mDone;
+  };
+  std::shared_ptr<batch> state = std::make_shared<batch>();
+  std::future<void> done = state->mDone.get_future();
+  if (pCount == 0) {
+    state->mDone.set_value();
+    return done;
+  }
+  {
+    std::shared_lock<std::shared_mutex> routing(mRouting);
+    std::vector<std::vector<std::size_t>> parts(mShards.size());
+    for (std::size_t i = 0; i < pCount; i++) {
+      parts[route(get_key_of(pInput[i]))].push_back(i);
+    }
+    std::size_t used = 0;
+    for (const std::vector<std::size_t> &part : parts) {
+      used += !part.empty();
+    }
+    state->mPending.store(used, std::memory_order_relaxed);
+    for (std::size_t s = 0; s < parts.size(); s++) {
+      if (parts[s].empty()) {
+        continue;
+      }
+      post(s, [state, pInput, pOperation, indices = std::move(parts[s])](
+                  tree_type &pTree) -> std::size_t {
+        for (std::size_t i : indices) {
+          pOperation(pTree, pInput[i], i);
+        }
+        if (state->mPending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          state->mDone.set_value();
+        }
+        return indices.size();
+      });
+    }
+  }
+  note_routed(pCount);
+  return done;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+const Key &sharded_bplustree<Key, Value, Compare, Fanout, Search>::get_key_of(
+    const Key &pKey) {
+  return pKey;
+}
+
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+const Key &sharded_bplustree<Key, Value, Compare, Fanout, Search>::get_key_of(
+    const record_type &pRecord) {
+  return pRecord.get_key();
+}
+
+// Worker loop: serve requests in queue order and sleep while there are
+// none. The sleeping flag is raised before the final emptiness check, so a
+// producer either sees the flag and wakes the worker or pushed early
+// enough for the check to see its request.
+template <typename Key, typename Value, typename Compare, int Fanout,
+          typename Search>
+void sharded_bplustree<Key, Value, Compare, Fanout, Search>::run(
+    shard *pShard) {
+  for (;;) {
+    std::unique_ptr<request> r;
+    if (!pShard->mQueue.pop(r)) {
+      std::unique_lock<std::mutex> lock(pShard->mMutex);
+      pShard->mSleeping.store(true, std::memory_order_seq_cst);
+      while (pShard->mQueue.is_empty()) {
+        pShard->mWake.wait(lock);
+      }
+      pShard->mSleeping.store(false, std::memory_order_relaxed);
+      continue;
+    }
+    if (!r) {
+      return;
+    }
+    std::size_t served = r->execute(pShard->mTree);
+    pShard->mServed.fetch_add(served, std::memory_order_relaxed);
+  }
+}
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef STRING_BPLUSTREE_HPP
+#define STRING_BPLUSTREE_HPP
+
+#include "bplustree.hpp"
+#include "string_key.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace bpt {
+
+template <typename Value, int LeafBytes, int Fanout> class string_bplustree;
+
+// compile-time parameters shared by the classes of one string tree
+// instantiation
+template <typename Value, int LeafBytes, int Fanout> struct string_traits {
+  static_assert(std::is_trivially_copyable<Value>::value &&
+                    alignof(Value) <= 16,
+                "string leaves store values as raw bytes");
+  static_assert(LeafBytes % 16 == 0 && LeafBytes <= 65536,
+                "leaf offsets are 16 bits wide");
+  static_assert(Fanout >= 3, "fanout must be at least 3");
+
+  typedef Value value_type;
+
+  // the leaf header takes the first 32 bytes
+  static constexpr int LEAF_DATA_BYTES = LeafBytes - 32;
+  // Longest key accepted. It keeps records small enough against a leaf
+  // that an overflowing leaf always has a split point where both halves
+  // fit.
+  static constexpr int MAX_KEY_SIZE =
+      LEAF_DATA_BYTES / 5 - int(sizeof(Value)) - 12;
+  // a leaf using fewer bytes of its data area is merged or refilled
+  static constexpr int LEAF_MIN_BYTES = LEAF_DATA_BYTES / 4;
+  static constexpr int INNER_MAX = Fanout;
+  static constexpr int INNER_MIN = Fanout / 6 > 0 ? Fanout / 6 : 1;
+
+  static_assert(MAX_KEY_SIZE >= 16, "leaf too small for the value");
+};
+
+// common base of string leaves and inner nodes; which one a child is
+// follows from its depth
+class string_node {};
+
+// Leaf holding its keys prefix-compressed in a fixed block. The bytes all
+// keys share are stored once; behind them every key has a slot with the
+// next 8 bytes as an integer head and the length of the remainder, whose
+// bytes beyond the head go to a tail area at the end. Lookups compare
+// heads and only memcmp the tails of equal heads. The data area reads
+//
+//   prefix | heads (u64) | slots | values | tails
+//
+// Every change decodes the leaf, edits the plain records and encodes them
+// again.
+template <typename Traits> class string_leaf : public string_node {
+  template <typename, int, int> friend class string_bplustree;
+
+public:
+  typedef typename Traits::value_type value_type;
+
+  string_leaf();
+  int get_size() const;
+  // appends key pIndex to pOut
+  void copy_key(int pIndex, std::string &pOut) const;
+  const value_type &get_value(int pIndex) const;
+  // index of the first key not less than pKey; pFound tells if it equals
+  // pKey
+  int lower_bound(std::string_view pKey, bool &pFound) const;
+  string_leaf *get_next() const;
+  // bytes of the data area in use
+  int get_used_bytes() const;
+
+private:
+  struct slot {
+    std::uint16_t mTail;
+    // bytes of the key behind the prefix
+    std::uint16_t mSize;
+  };
+
+  // bytes that pCount sorted keys and as many values take in one leaf
+  static int get_encoded_size(const std::string *pKeys, int pCount);
+  static bool fits(const std::string *pKeys, int pCount);
+  // replaces the records by pCount sorted ones, which must fit
+  void encode(const std::string *pKeys, const value_type *pValues,
+              int pCount);
+  void decode(std::string *pKeys, value_type *pValues) const;
+  static std::size_t get_prefix_size(const std::string *pKeys, int pCount);
+  static int get_heads_offset(int pPrefixSize);
+  static int get_values_offset(int pPrefixSize, int pCount);
+  const std::uint64_t *get_heads() const;
+  const slot *get_slots() const;
+  // three-way comparison of key pIndex with the key whose bytes behind the
+  // prefix are pRest, with head pHead
+  int compare(int pIndex, std::uint64_t pHead, std::string_view pRest) const;
+
+  string_leaf *mPrev;
+  string_leaf *mNext;
+  std::uint16_t mSize;
+  std::uint16_t mPrefixSize;
+  alignas(16) unsigned char mData[Traits::LEAF_DATA_BYTES];
+};
+
+// Child i sits to the right of key i - 1, as in inner_node. The keys are
+// the shortened separators of key_separator<string_key>.
+template <typename Traits> class string_inner : public string_node {
+  template <typename, int, int> friend class string_bplustree;
+
+public:
+  // one spare slot takes the overflow before a split
+  static constexpr int CAPACITY = Traits::INNER_MAX + 1;
+
+  explicit string_inner(string_node *pHeir);
+  int get_size() const;
+  const string_key &get_key(int pIndex) const;
+  string_node *get_child(int pIndex) const;
+  // index of the first key greater than the key with head pHead
+  int upper_bound(std::uint64_t pHead, std::string_view pKey) const;
+
+private:
+  void insert_at(int pIndex, string_key pKey, string_node *pRight);
+  void erase(int pIndex);
+  void set_key(int pIndex, string_key pKey);
+  string_key split_into(string_inner &pNew);
+  void merge_from(string_inner &pRight, const string_key &pSeparator);
+  string_key redistribute(string_inner &pRight, const string_key &pSeparator);
+
+  int mSize;
+  string_key mKeys[CAPACITY];
+  string_node *mChildren[CAPACITY + 1];
+};
+
+// B+tree over variable-length byte string keys such as paths or
+// "tenant:object" ids, ordered like std::string. Leaves are fixed blocks of
+// LeafBytes that store the prefix their keys share once, so keys with long
+// common prefixes cost little more than their distinct bytes. Leaf splits
+// post the shortest separator that tells the halves apart, which keeps the
+// inner keys short and mostly free of heap allocations. Every comparison
+// starts with 8-byte integer heads. Keys are unique and at most
+// MAX_KEY_SIZE bytes long.
+template <typename Value, int LeafBytes = 2048, int Fanout = 30>
+class string_bplustree {
+public:
+  typedef string_traits<Value, LeafBytes, Fanout> traits;
+  typedef record<std::string, Value> record_type;
+
+  static constexpr int MAX_KEY_SIZE = traits::MAX_KEY_SIZE;
+
+  string_bplustree();
+  string_bplustree(const string_bplustree &) = delete;
+  string_bplustree &operator=(const string_bplustree &) = delete;
+  ~string_bplustree();
+
+  const Value *search(std::string_view pKey) const;
+  // False, leaving the tree unchanged, if the key is already present or
+  // longer than MAX_KEY_SIZE.
+  bool insert(const record_type &pRecord);
+  bool remove(std::string_view pKey);
+  // Calls pVisit(key, value) for the records with pLow <= key < pHigh in
+  // key order. The key is a std::string_view that is only valid during
+  // the call.
+  template <typename Visitor>
+  void scan(std::string_view pLow, std::string_view pHigh,
+            Visitor pVisit) const;
+
+  std::size_t get_size() const;
+  // bytes of the nodes in use, including separators on the heap
+  std::size_t get_memory_usage() const;
+
+private:
+  typedef string_leaf<traits> leaf_type;
+  typedef string_inner<traits> inner_type;
+
+  // every inner node has at least two children
+  static constexpr int MAX_HEIGHT = 64;
+
+  // Walks down to the leaf of pKey. If pPath is given, the inner nodes on
+  // the way and the child slots taken in them are stored from the root
+  // down.
+  leaf_type *find_leaf(std::string_view pKey, inner_type **pPath,
+                       int *pSlots) const;
+  // grows mKeys and mValues to hold pCount records
+  void reserve_records(int pCount);
+  // Encodes the first pCount records of mKeys and mValues into pLeaf, or,
+  // if they do not fit, into pLeaf and a new right sibling hung into the
+  // tree along pPath. True if the leaf was split.
+  bool store(leaf_type *pLeaf, int pCount, inner_type **pPath,
+             const int *pSlots);
+  // The split point nearest the middle at which the records before and
+  // behind it both fit into a leaf. Keys within MAX_KEY_SIZE guarantee
+  // there is one.
+  static int find_split(const std::string *pKeys, int pCount);
+  void split_upwards(inner_type **pPath, const int *pSlots,
+                     string_node *pLeft, string_key pSeparator,
+                     string_node *pRight);
+  // merges or evens out children pLeftSlot and pLeftSlot + 1 of pParent,
+  // which sit at pDepth; true if they were merged
+  bool rebalance(inner_type *pParent, int pLeftSlot, int pDepth);
+  std::size_t get_inner_bytes(const string_node *pNode, int pDepth) const;
+  void destroy_tree(string_node *pNode, int pDepth);
+
+  string_node *mRoot;
+  // inner levels above the leaves
+  int mHeight;
+  std::size_t mSize;
+  // decoded records of the leaves being changed, kept to reuse their
+  // buffers
+  std::vector<std::string> mKeys;
+  std::vector<Value> mValues;
+  node_pool<leaf_type> mLeaves;
+  node_pool<inner_type> mInners;
+};
+
+} // namespace bpt
+
+#include "string_bplustree_impl.hpp"
+
+#endif
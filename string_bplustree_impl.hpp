@@ -0,0 +1,606 @@
+#ifndef STRING_BPLUSTREE_IMPL_HPP
+#define STRING_BPLUSTREE_IMPL_HPP
+
+#include <algorithm>
+#include <cstring>
+
+namespace bpt {
+
+// string_leaf class //////////////////////////////////////////////////////////
+template <typename Traits>
+string_leaf<Traits>::string_leaf()
+    : mPrev(nullptr), mNext(nullptr), mSize(0), mPrefixSize(0) {}
+
+template <typename Traits> int string_leaf<Traits>::get_size() const {
+  return mSize;
+}
+
+template <typename Traits>
+void string_leaf<Traits>::copy_key(int pIndex, std::string &pOut) const {
+  pOut.append(reinterpret_cast<const char *>(mData), mPrefixSize);
+  std::uint64_t head = get_heads()[pIndex];
+  const slot &s = get_slots()[pIndex];
+  for (int i = 0; i < 8 && i < s.mSize; i++) {
+    pOut.push_back(char(head >> (56 - 8 * i)));
+  }
+  if (s.mSize > 8) {
+    pOut.append(reinterpret_cast<const char *>(mData + s.mTail), s.mSize - 8);
+  }
+}
+
+template <typename Traits>
+const typename string_leaf<Traits>::value_type &
+string_leaf<Traits>::get_value(int pIndex) const {
+  return reinterpret_cast<const value_type *>(
+      mData + get_values_offset(mPrefixSize, mSize))[pIndex];
+}
+
+// The prefix is compared once; the binary search then runs over the heads
+// of the bytes behind it.
+template <typename Traits>
+int string_leaf<Traits>::lower_bound(std::string_view pKey,
+                                     bool &pFound) const {
+  pFound = false;
+  if (mSize == 0) {
+    return 0;
+  }
+  std::size_t common = std::min<std::size_t>(pKey.size(), mPrefixSize);
+  int order = common == 0 ? 0 : std::memcmp(pKey.data(), mData, common);
+  if (order < 0 || (order == 0 && pKey.size() < mPrefixSize)) {
+    return 0;
+  }
+  if (order > 0) {
+    return mSize;
+  }
+  std::string_view rest = pKey.substr(mPrefixSize);
+  std::uint64_t head = detail::load_head(rest.data(), rest.size());
+  int low = 0;
+  for (int count = mSize; count > 0;) {
+    int half = count / 2;
+    if (compare(low + half, head, rest) < 0) {
+      low += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  pFound = low < mSize && compare(low, head, rest) == 0;
+  return low;
+}
+
+template <typename Traits>
+string_leaf<Traits> *string_leaf<Traits>::get_next() const {
+  return mNext;
+}
+
+template <typename Traits> int string_leaf<Traits>::get_used_bytes() const {
+  if (mSize == 0) {
+    return 0;
+  }
+  const slot &last = get_slots()[mSize - 1];
+  return last.mTail + std::max(0, int(last.mSize) - 8);
+}
+
+template <typename Traits>
+int string_leaf<Traits>::get_encoded_size(const std::string *pKeys,
+                                          int pCount) {
+  std::size_t prefix = get_prefix_size(pKeys, pCount);
+  std::size_t size = get_values_offset(prefix, pCount) +
+                     std::size_t(pCount) * sizeof(value_type);
+  for (int i = 0; i < pCount; i++) {
+    size += std::max<std::size_t>(pKeys[i].size() - prefix, 8) - 8;
+  }
+  return int(std::min<std::size_t>(size, Traits::LEAF_DATA_BYTES + 1));
+}
+
+template <typename Traits>
+bool string_leaf<Traits>::fits(const std::string *pKeys, int pCount) {
+  return get_encoded_size(pKeys, pCount) <= Traits::LEAF_DATA_BYTES;
+}
+
+template <typename Traits>
+void string_leaf<Traits>::encode(const std::string *pKeys,
+                                 const value_type *pValues, int pCount) {
+  std::size_t prefix = get_prefix_size(pKeys, pCount);
+  mSize = pCount;
+  mPrefixSize = prefix;
+  if (pCount > 0) {
+    std::memcpy(mData, pKeys[0].data(), prefix);
+  }
+  std::uint64_t *heads =
+      reinterpret_cast<std::uint64_t *>(mData + get_heads_offset(prefix));
+  slot *slots = reinterpret_cast<slot *>(heads + pCount);
+  int valuesOffset = get_values_offset(prefix, pCount);
+  int tail = valuesOffset + pCount * int(sizeof(value_type));
+  for (int i = 0; i < pCount; i++) {
+    const char *rest = pKeys[i].data() + prefix;
+    int size = int(pKeys[i].size() - prefix);
+    heads[i] = detail::load_head(rest, size);
+    slots[i].mTail = tail;
+    slots[i].mSize = size;
+    if (size > 8) {
+      std::memcpy(mData + tail, rest + 8, size - 8);
+      tail += size - 8;
+    }
+  }
+  std::memcpy(mData + valuesOffset, pValues, pCount * sizeof(value_type));
+}
+
+template <typename Traits>
+void string_leaf<Traits>::decode(std::string *pKeys,
+                                 value_type *pValues) const {
+  for (int i = 0; i < mSize; i++) {
+    pKeys[i].clear();
+    copy_key(i, pKeys[i]);
+  }
+  std::memcpy(pValues, mData + get_values_offset(mPrefixSize, mSize),
+              mSize * sizeof(value_type));
+}
+
+// The keys are sorted, so what the first and the last share, all share.
+template <typename Traits>
+std::size_t string_leaf<Traits>::get_prefix_size(const std::string *pKeys,
+                                                 int pCount) {
+  if (pCount == 0) {
+    return 0;
+  }
+  const std::string &first = pKeys[0], &last = pKeys[pCount - 1];
+  std::size_t size = std::min(first.size(), last.size()), prefix = 0;
+  while (prefix < size && first[prefix] == last[prefix]) {
+    prefix++;
+  }
+  return prefix;
+}
+
+template <typename Traits>
+int string_leaf<Traits>::get_heads_offset(int pPrefixSize) {
+  return (pPrefixSize + 7) / 8 * 8;
+}
+
+template <typename Traits>
+int string_leaf<Traits>::get_values_offset(int pPrefixSize, int pCount) {
+  int end = get_heads_offset(pPrefixSize) +
+            pCount * int(sizeof(std::uint64_t) + sizeof(slot));
+  return (end + int(alignof(value_type)) - 1) / int(alignof(value_type)) *
+         int(alignof(value_type));
+}
+
+template <typename Traits>
+const std::uint64_t *string_leaf<Traits>::get_heads() const {
+  return reinterpret_cast<const std::uint64_t *>(
+      mData + get_heads_offset(mPrefixSize));
+}
+
+template <typename Traits>
+const typename string_leaf<Traits>::slot *
+string_leaf<Traits>::get_slots() const {
+  return reinterpret_cast<const slot *>(get_heads() + mSize);
+}
+
+template <typename Traits>
+int string_leaf<Traits>::compare(int pIndex, std::uint64_t pHead,
+                                 std::string_view pRest) const {
+  const slot &s = get_slots()[pIndex];
+  // compare_bytes() looks at the bytes from offset 8 on, which is where
+  // the tail starts
+  const char *bytes = reinterpret_cast<const char *>(mData + s.mTail) - 8;
+  return detail::compare_bytes(get_heads()[pIndex], bytes, s.mSize, pHead,
+                               pRest.data(), pRest.size());
+}
+
+// string_inner class /////////////////////////////////////////////////////////
+template <typename Traits>
+string_inner<Traits>::string_inner(string_node *pHeir) : mSize(0) {
+  mChildren[0] = pHeir;
+}
+
+template <typename Traits> int string_inner<Traits>::get_size() const {
+  return mSize;
+}
+
+template <typename Traits>
+const string_key &string_inner<Traits>::get_key(int pIndex) const {
+  return mKeys[pIndex];
+}
+
+template <typename Traits>
+string_node *string_inner<Traits>::get_child(int pIndex) const {
+  return mChildren[pIndex];
+}
+
+template <typename Traits>
+int string_inner<Traits>::upper_bound(std::uint64_t pHead,
+                                      std::string_view pKey) const {
+  int low = 0;
+  for (int count = mSize; count > 0;) {
+    int half = count / 2;
+    if (mKeys[low + half].compare(pHead, pKey) <= 0) {
+      low += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return low;
+}
+
+template <typename Traits>
+void string_inner<Traits>::insert_at(int pIndex, string_key pKey,
+                                     string_node *pRight) {
+  std::move_backward(mKeys + pIndex, mKeys + mSize, mKeys + mSize + 1);
+  std::copy_backward(mChildren + pIndex + 1, mChildren + mSize + 1,
+                     mChildren + mSize + 2);
+  mKeys[pIndex] = std::move(pKey);
+  mChildren[pIndex + 1] = pRight;
+  mSize++;
+}
+
+template <typename Traits> void string_inner<Traits>::erase(int pIndex) {
+  std::move(mKeys + pIndex + 1, mKeys + mSize, mKeys + pIndex);
+  std::copy(mChildren + pIndex + 2, mChildren + mSize + 1,
+            mChildren + pIndex + 1);
+  mKeys[--mSize] = string_key();
+}
+
+template <typename Traits>
+void string_inner<Traits>::set_key(int pIndex, string_key pKey) {
+  mKeys[pIndex] = std::move(pKey);
+}
+
+template <typename Traits>
+string_key string_inner<Traits>::split_into(string_inner &pNew) {
+  int from = mSize / 2;
+  std::move(mKeys + from + 1, mKeys + mSize, pNew.mKeys);
+  std::copy(mChildren + from + 1, mChildren + mSize + 1, pNew.mChildren);
+  pNew.mSize = mSize - from - 1;
+  mSize = from;
+  return std::move(mKeys[from]);
+}
+
+template <typename Traits>
+void string_inner<Traits>::merge_from(string_inner &pRight,
+                                      const string_key &pSeparator) {
+  mKeys[mSize] = pSeparator;
+  std::move(pRight.mKeys, pRight.mKeys + pRight.mSize, mKeys + mSize + 1);
+  std::copy(pRight.mChildren, pRight.mChildren + pRight.mSize + 1,
+            mChildren + mSize + 1);
+  mSize += pRight.mSize + 1;
+  pRight.mSize = 0;
+}
+
+// The separator comes down between the two key runs and whichever key ends
+// up in the middle goes back up.
+template <typename Traits>
+string_key string_inner<Traits>::redistribute(string_inner &pRight,
+                                              const string_key &pSeparator) {
+  int size = mSize, rsize = pRight.mSize;
+  int target = (size + 1 + rsize) / 2;
+  string_key separator;
+  if (size < target) {
+    int count = target - size;
+    mKeys[size] = pSeparator;
+    std::move(pRight.mKeys, pRight.mKeys + count - 1, mKeys + size + 1);
+    std::copy(pRight.mChildren, pRight.mChildren + count,
+              mChildren + size + 1);
+    separator = std::move(pRight.mKeys[count - 1]);
+    std::move(pRight.mKeys + count, pRight.mKeys + rsize, pRight.mKeys);
+    std::copy(pRight.mChildren + count, pRight.mChildren + rsize + 1,
+              pRight.mChildren);
+    pRight.mSize = rsize - count;
+  } else {
+    int count = size - target;
+    std::move_backward(pRight.mKeys, pRight.mKeys + rsize,
+                       pRight.mKeys + rsize + count);
+    std::copy_backward(pRight.mChildren, pRight.mChildren + rsize + 1,
+                       pRight.mChildren + rsize + 1 + count);
+    std::move(mKeys + target + 1, mKeys + size, pRight.mKeys);
+    pRight.mKeys[count - 1] = pSeparator;
+    std::copy(mChildren + target + 1, mChildren + size + 1, pRight.mChildren);
+    separator = std::move(mKeys[target]);
+    pRight.mSize = rsize + count;
+  }
+  mSize = target;
+  return separator;
+}
+
+// string_bplustree class /////////////////////////////////////////////////////
+template <typename Value, int LeafBytes, int Fanout>
+string_bplustree<Value, LeafBytes, Fanout>::string_bplustree()
+    : mRoot(nullptr), mHeight(0), mSize(0) {
+  static_assert(sizeof(leaf_type) == LeafBytes, "unexpected leaf padding");
+  mRoot = mLeaves.create();
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+string_bplustree<Value, LeafBytes, Fanout>::~string_bplustree() {
+  destroy_tree(mRoot, 0);
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+const Value *string_bplustree<Value, LeafBytes, Fanout>::search(
+    std::string_view pKey) const {
+  const leaf_type *leaf = find_leaf(pKey, nullptr, nullptr);
+  bool found;
+  int index = leaf->lower_bound(pKey, found);
+  return found ? &leaf->get_value(index) : nullptr;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+bool string_bplustree<Value, LeafBytes, Fanout>::insert(
+    const record_type &pRecord) {
+  const std::string &key = pRecord.get_key();
+  if (key.size() > std::size_t(MAX_KEY_SIZE)) {
+    return false;
+  }
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *leaf = find_leaf(key, path, slots);
+  bool found;
+  int index = leaf->lower_bound(key, found), size = leaf->get_size();
+  if (found) {
+    return false;
+  }
+  reserve_records(size + 1);
+  std::string *keys = mKeys.data();
+  Value *values = mValues.data();
+  leaf->decode(keys, values);
+  std::move_backward(keys + index, keys + size, keys + size + 1);
+  std::move_backward(values + index, values + size, values + size + 1);
+  keys[index] = key;
+  values[index] = pRecord.get_value();
+  store(leaf, size + 1, path, slots);
+  mSize++;
+  return true;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+bool string_bplustree<Value, LeafBytes, Fanout>::remove(std::string_view pKey) {
+  inner_type *path[MAX_HEIGHT];
+  int slots[MAX_HEIGHT];
+  leaf_type *leaf = find_leaf(pKey, path, slots);
+  bool found;
+  int index = leaf->lower_bound(pKey, found), size = leaf->get_size();
+  if (!found) {
+    return false;
+  }
+  reserve_records(size);
+  std::string *keys = mKeys.data();
+  Value *values = mValues.data();
+  leaf->decode(keys, values);
+  std::move(keys + index + 1, keys + size, keys + index);
+  std::move(values + index + 1, values + size, values + index);
+  mSize--;
+  if (store(leaf, size - 1, path, slots) ||
+      leaf->get_used_bytes() >= traits::LEAF_MIN_BYTES) {
+    return true;
+  }
+  // climb for as long as the node below is underfull
+  for (int level = mHeight - 1; level >= 0; level--) {
+    inner_type *parent = path[level];
+    int leftSlot = std::min(slots[level], parent->get_size() - 1);
+    if (!rebalance(parent, leftSlot, level + 1) ||
+        parent->get_size() >= traits::INNER_MIN) {
+      break;
+    }
+  }
+  // replace an inner root that has lost its last key by its only child
+  if (mHeight > 0 && static_cast<inner_type *>(mRoot)->get_size() == 0) {
+    inner_type *root = static_cast<inner_type *>(mRoot);
+    mRoot = root->get_child(0);
+    mHeight--;
+    mInners.destroy(root);
+  }
+  return true;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+template <typename Visitor>
+void string_bplustree<Value, LeafBytes, Fanout>::scan(std::string_view pLow,
+                                                      std::string_view pHigh,
+                                                      Visitor pVisit) const {
+  const leaf_type *leaf = find_leaf(pLow, nullptr, nullptr);
+  bool found;
+  int index = leaf->lower_bound(pLow, found);
+  std::string key;
+  for (; leaf; leaf = leaf->get_next(), index = 0) {
+    for (; index < leaf->get_size(); index++) {
+      key.clear();
+      leaf->copy_key(index, key);
+      if (std::string_view(key) >= pHigh) {
+        return;
+      }
+      pVisit(std::string_view(key), leaf->get_value(index));
+    }
+  }
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+std::size_t string_bplustree<Value, LeafBytes, Fanout>::get_size() const {
+  return mSize;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+std::size_t
+string_bplustree<Value, LeafBytes, Fanout>::get_memory_usage() const {
+  return mLeaves.get_live_count() * sizeof(leaf_type) +
+         get_inner_bytes(mRoot, 0);
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+typename string_bplustree<Value, LeafBytes, Fanout>::leaf_type *
+string_bplustree<Value, LeafBytes, Fanout>::find_leaf(std::string_view pKey,
+                                                      inner_type **pPath,
+                                                      int *pSlots) const {
+  std::uint64_t head = detail::load_head(pKey.data(), pKey.size());
+  string_node *node = mRoot;
+  for (int level = 0; level < mHeight; level++) {
+    inner_type *inner = static_cast<inner_type *>(node);
+    int slot = inner->upper_bound(head, pKey);
+    if (pPath) {
+      pPath[level] = inner;
+      pSlots[level] = slot;
+    }
+    node = inner->get_child(slot);
+  }
+  return static_cast<leaf_type *>(node);
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+void string_bplustree<Value, LeafBytes, Fanout>::reserve_records(int pCount) {
+  if (int(mKeys.size()) < pCount) {
+    mKeys.resize(pCount);
+    mValues.resize(pCount);
+  }
+}
+
+// A remove can need a few more bytes than before too: when the first or
+// last key goes, the prefix grows and its alignment padding with it.
+template <typename Value, int LeafBytes, int Fanout>
+bool string_bplustree<Value, LeafBytes, Fanout>::store(leaf_type *pLeaf,
+                                                       int pCount,
+                                                       inner_type **pPath,
+                                                       const int *pSlots) {
+  std::string *keys = mKeys.data();
+  Value *values = mValues.data();
+  if (leaf_type::fits(keys, pCount)) {
+    pLeaf->encode(keys, values, pCount);
+    return false;
+  }
+  int split = find_split(keys, pCount);
+  leaf_type *right = mLeaves.create();
+  pLeaf->encode(keys, values, split);
+  right->encode(keys + split, values + split, pCount - split);
+  right->mPrev = pLeaf;
+  right->mNext = pLeaf->mNext;
+  if (pLeaf->mNext) {
+    pLeaf->mNext->mPrev = right;
+  }
+  pLeaf->mNext = right;
+  split_upwards(pPath, pSlots, pLeaf,
+                detail::shortest_separator(keys[split - 1], keys[split]),
+                right);
+  return true;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+int string_bplustree<Value, LeafBytes, Fanout>::find_split(
+    const std::string *pKeys, int pCount) {
+  for (int distance = 0; distance <= pCount / 2; distance++) {
+    for (int split : {pCount / 2 - distance, pCount / 2 + distance}) {
+      if (split > 0 && split < pCount && leaf_type::fits(pKeys, split) &&
+          leaf_type::fits(pKeys + split, pCount - split)) {
+        return split;
+      }
+    }
+  }
+  return -1;
+}
+
+// Hangs pRight, split off pLeft, into the parent of pLeft and splits every
+// ancestor that overflows, growing a new root if the old one splits.
+template <typename Value, int LeafBytes, int Fanout>
+void string_bplustree<Value, LeafBytes, Fanout>::split_upwards(
+    inner_type **pPath, const int *pSlots, string_node *pLeft,
+    string_key pSeparator, string_node *pRight) {
+  for (int level = mHeight - 1; level >= 0; level--) {
+    inner_type *inner = pPath[level];
+    inner->insert_at(pSlots[level], std::move(pSeparator), pRight);
+    if (inner->get_size() <= traits::INNER_MAX) {
+      return;
+    }
+    inner_type *right = mInners.create(nullptr);
+    pSeparator = inner->split_into(*right);
+    pLeft = inner;
+    pRight = right;
+  }
+  inner_type *root = mInners.create(pLeft);
+  root->insert_at(0, std::move(pSeparator), pRight);
+  mRoot = root;
+  mHeight++;
+}
+
+// Leaves are merged if the records of both fit into one, else shared at
+// the split point nearest the middle where both halves fit, if any.
+template <typename Value, int LeafBytes, int Fanout>
+bool string_bplustree<Value, LeafBytes, Fanout>::rebalance(
+    inner_type *pParent, int pLeftSlot, int pDepth) {
+  string_node *leftNode = pParent->get_child(pLeftSlot);
+  string_node *rightNode = pParent->get_child(pLeftSlot + 1);
+  if (pDepth == mHeight) {
+    leaf_type *left = static_cast<leaf_type *>(leftNode);
+    leaf_type *right = static_cast<leaf_type *>(rightNode);
+    int size = left->get_size() + right->get_size();
+    reserve_records(size);
+    std::string *keys = mKeys.data();
+    Value *values = mValues.data();
+    left->decode(keys, values);
+    right->decode(keys + left->get_size(), values + left->get_size());
+    if (!leaf_type::fits(keys, size)) {
+      int split = find_split(keys, size);
+      if (split > 0) {
+        left->encode(keys, values, split);
+        right->encode(keys + split, values + split, size - split);
+        pParent->set_key(pLeftSlot, detail::shortest_separator(
+                                        keys[split - 1], keys[split]));
+      }
+      return false;
+    }
+    left->encode(keys, values, size);
+    left->mNext = right->mNext;
+    if (right->mNext) {
+      right->mNext->mPrev = left;
+    }
+    mLeaves.destroy(right);
+  } else {
+    inner_type *left = static_cast<inner_type *>(leftNode);
+    inner_type *right = static_cast<inner_type *>(rightNode);
+    const string_key &separator = pParent->get_key(pLeftSlot);
+    if (left->get_size() + right->get_size() + 1 > traits::INNER_MAX) {
+      pParent->set_key(pLeftSlot, left->redistribute(*right, separator));
+      return false;
+    }
+    left->merge_from(*right, separator);
+    mInners.destroy(right);
+  }
+  pParent->erase(pLeftSlot);
+  return true;
+}
+
+// node bytes of the inner levels plus the separators that did not fit
+// into their std::string inline
+template <typename Value, int LeafBytes, int Fanout>
+std::size_t string_bplustree<Value, LeafBytes, Fanout>::get_inner_bytes(
+    const string_node *pNode, int pDepth) const {
+  if (pDepth == mHeight) {
+    return 0;
+  }
+  const inner_type *inner = static_cast<const inner_type *>(pNode);
+  std::size_t bytes = sizeof(inner_type);
+  std::size_t inlineCapacity = std::string().capacity();
+  for (int i = 0; i <= inner->get_size(); i++) {
+    if (i < inner->get_size() &&
+        inner->get_key(i).get_bytes().capacity() > inlineCapacity) {
+      bytes += inner->get_key(i).get_bytes().capacity() + 1;
+    }
+    bytes += get_inner_bytes(inner->get_child(i), pDepth + 1);
+  }
+  return bytes;
+}
+
+template <typename Value, int LeafBytes, int Fanout>
+void string_bplustree<Value, LeafBytes, Fanout>::destroy_tree(
+    string_node *pNode, int pDepth) {
+  if (pDepth == mHeight) {
+    mLeaves.destroy(static_cast<leaf_type *>(pNode));
+    return;
+  }
+  inner_type *inner = static_cast<inner_type *>(pNode);
+  for (int i = 0; i <= inner->get_size(); i++) {
+    destroy_tree(inner->get_child(i), pDepth + 1);
+  }
+  mInners.destroy(inner);
+}
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef STRING_KEY_HPP
+#define STRING_KEY_HPP
+
+#include "bplustree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace bpt {
+
+namespace detail {
+
+// The first 8 bytes of pBytes as a big-endian integer, zero-padded, so that
+// heads order like the bytes they come from.
+inline std::uint64_t load_head(const char *pBytes, std::size_t pSize) {
+  unsigned char buffer[8] = {};
+  std::memcpy(buffer, pBytes, pSize < 8 ? pSize : 8);
+  std::uint64_t head = 0;
+  for (int i = 0; i < 8; i++) {
+    head = head << 8 | buffer[i];
+  }
+  return head;
+}
+
+// Three-way comparison of two byte strings whose heads are known: one
+// integer comparison settles most pairs, and memcmp only looks at the bytes
+// behind equal heads.
+inline int compare_bytes(std::uint64_t pLeftHead, const char *pLeft,
+                         std::size_t pLeftSize, std::uint64_t pRightHead,
+                         const char *pRight, std::size_t pRightSize) {
+  if (pLeftHead != pRightHead) {
+    return pLeftHead < pRightHead ? -1 : 1;
+  }
+  if (pLeftSize > 8 && pRightSize > 8) {
+    std::size_t common = pLeftSize < pRightSize ? pLeftSize : pRightSize;
+    int order = std::memcmp(pLeft + 8, pRight + 8, common - 8);
+    if (order != 0) {
+      return order;
+    }
+  }
+  // equal heads pad a shorter string with zeros; it still sorts first
+  return pLeftSize < pRightSize ? -1 : pLeftSize > pRightSize;
+}
+
+// shortest prefix of pRight that is still greater than pLeft < pRight
+inline std::string shortest_separator(std::string_view pLeft,
+                                      std::string_view pRight) {
+  std::size_t common = 0;
+  while (common < pLeft.size() && pLeft[common] == pRight[common]) {
+    common++;
+  }
+  return std::string(pRight.substr(0, common + 1));
+}
+
+} // namespace detail
+
+// Byte string key ordered like std::string that keeps its first 8 bytes as
+// an integer next to the bytes, so most comparisons in a node are one
+// integer comparison without touching the heap.
+class string_key {
+public:
+  string_key() : mHead(0) {}
+  string_key(std::string pBytes)
+      : mHead(detail::load_head(pBytes.data(), pBytes.size())),
+        mBytes(std::move(pBytes)) {}
+  string_key(const char *pBytes) : string_key(std::string(pBytes)) {}
+
+  const std::string &get_bytes() const { return mBytes; }
+  std::uint64_t get_head() const { return mHead; }
+
+  // three-way comparison against a byte string with head pHead
+  int compare(std::uint64_t pHead, std::string_view pBytes) const {
+    return detail::compare_bytes(mHead, mBytes.data(), mBytes.size(), pHead,
+                                 pBytes.data(), pBytes.size());
+  }
+
+  friend bool operator<(const string_key &pLeft, const string_key &pRight) {
+    return pLeft.compare(pRight.mHead, pRight.mBytes) < 0;
+  }
+  friend bool operator==(const string_key &pLeft, const string_key &pRight) {
+    return pLeft.mHead == pRight.mHead && pLeft.mBytes == pRight.mBytes;
+  }
+  friend bool operator!=(const string_key &pLeft, const string_key &pRight) {
+    return !(pLeft == pRight);
+  }
+  friend std::ostream &operator<<(std::ostream &pOut, const string_key &pKey) {
+    return pOut << pKey.mBytes;
+  }
+
+private:
+  std::uint64_t mHead;
+  std::string mBytes;
+};
+
+// Leaf splits of string trees post the shortest prefix of the right half's
+// first key that separates it from the left half, e.g. "tenant7:o" between
+// "tenant7:index" and "tenant7:object-17".
+template <> struct key_separator<string_key, std::less<string_key>> {
+  static string_key make(const string_key &pLeft, const string_key &pRight) {
+    return detail::shortest_separator(pLeft.get_bytes(), pRight.get_bytes());
+  }
+};
+
+template <> struct key_separator<std::string, std::less<std::string>> {
+  static std::string make(const std::string &pLeft,
+                          const std::string &pRight) {
+    return detail::shortest_separator(pLeft, pRight);
+  }
+};
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,328 @@
+// bplustree against std::map. Random inserts, removes, upserts and lookups,
+// with and without a finger, run on trees of several fanouts, both search
+// policies and every remove_policy, the lazy one compacted at the end.
+// Keys are drawn from a small range, half of them around a moving point
+// as fingers expect, and only absent keys are inserted, as the model holds
+// each key once. Every so often the whole tree is walked forwards and
+// backwards and its bounds, ranges and, in Counted trees, order statistics
+// are checked. Then keys are inserted many times over into trees checked
+// against a std::multimap, so that equal keys span several leaves, and
+// keys are appended in ascending order.
+
+#include "bplustree.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef std::map<std::int64_t, std::int64_t> model_type;
+typedef std::multimap<std::int64_t, std::int64_t> multi_model_type;
+
+template <typename Tree, typename Model>
+void check_same(const Tree &pTree, const Model &pExpected) {
+  auto it = pTree.begin();
+  for (const auto &entry : pExpected) {
+    CHECK(it != pTree.end() && it.get_key() == entry.first &&
+          it.get_value() == entry.second);
+    ++it;
+  }
+  CHECK(it == pTree.end());
+  // and back again
+  for (auto entry = pExpected.rbegin(); entry != pExpected.rend(); ++entry) {
+    CHECK(it != pTree.begin());
+    --it;
+    CHECK(it.get_key() == entry->first && it.get_value() == entry->second);
+  }
+  CHECK(it == pTree.begin());
+  CHECK(std::size_t(std::distance(pTree.begin(), pTree.end())) ==
+        pExpected.size());
+}
+
+template <typename Iterator, typename Model>
+bool is_at(const Iterator &pIt, const Iterator &pEnd,
+           typename Model::const_iterator pExpected, const Model &pModel) {
+  if (pExpected == pModel.end()) {
+    return pIt == pEnd;
+  }
+  return pIt != pEnd && pIt.get_key() == pExpected->first &&
+         pIt.get_value() == pExpected->second;
+}
+
+template <typename Tree, typename Model>
+void check_bounds(const Tree &pTree, const Model &pExpected,
+                  std::int64_t pLow, std::int64_t pHigh) {
+  CHECK(is_at(pTree.lower_bound(pLow), pTree.end(),
+              pExpected.lower_bound(pLow), pExpected));
+  CHECK(is_at(pTree.upper_bound(pLow), pTree.end(),
+              pExpected.upper_bound(pLow), pExpected));
+  auto expected = pExpected.lower_bound(pLow);
+  for (auto r : pTree.range(pLow, pHigh)) {
+    CHECK(expected != pExpected.end() && r.get_key() == expected->first &&
+          r.get_value() == expected->second);
+    ++expected;
+  }
+  CHECK(expected == pExpected.end() || expected->first >= pHigh);
+}
+
+// rank(), select() and count() only exist in Counted trees
+template <bool Counted> struct order_statistics {
+  template <typename Tree, typename Model>
+  static void check(const Tree &, const Model &, std::int64_t, std::int64_t,
+                    std::size_t) {}
+};
+
+template <> struct order_statistics<true> {
+  template <typename Tree, typename Model>
+  static void check(const Tree &pTree, const Model &pExpected,
+                    std::int64_t pLow, std::int64_t pHigh,
+                    std::size_t pIndex) {
+    auto low = pExpected.lower_bound(pLow);
+    CHECK(pTree.rank(pLow) ==
+          std::size_t(std::distance(pExpected.begin(), low)));
+    std::size_t count =
+        pLow < pHigh ? std::distance(low, pExpected.lower_bound(pHigh)) : 0;
+    CHECK(pTree.count(pLow, pHigh) == count);
+    CHECK(is_at(pTree.select(pIndex), pTree.end(),
+                pIndex < pExpected.size() ? std::next(pExpected.begin(), pIndex)
+                                          : pExpected.end(),
+                pExpected));
+  }
+};
+
+template <typename Tree, typename Model>
+void check_whole(const Tree &pTree, const Model &pExpected,
+                 std::mt19937_64 &pRng, std::int64_t pRange) {
+  check_same(pTree, pExpected);
+  CHECK(pTree.get_stats().mRecords == pExpected.size());
+  std::uniform_int_distribution<std::int64_t> pick(-2, pRange + 2);
+  for (int i = 0; i < 20; i++) {
+    std::int64_t low = pick(pRng), high = low + pick(pRng) / 4;
+    check_bounds(pTree, pExpected, low, high);
+    order_statistics<Tree::traits::COUNTED>::check(
+        pTree, pExpected, low, high, pRng() % (pExpected.size() + 2));
+  }
+}
+
+template <typename Tree>
+void fuzz(bpt::remove_policy pPolicy, std::int64_t pRange, int pOperations,
+          std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  Tree tree;
+  const Tree &constTree = tree;
+  tree.set_remove_policy(pPolicy);
+  model_type expected;
+  std::mt19937_64 rng(pSeed);
+  std::int64_t centre = 0;
+  typename Tree::const_iterator finger;
+  for (std::int64_t i = 0; i < pOperations; i++) {
+    if (rng() % 64 == 0) {
+      centre = std::int64_t(rng() % pRange);
+    }
+    std::int64_t key = rng() % 2 ? std::int64_t(rng() % pRange)
+                                  : centre + std::int64_t(rng() % 16);
+    auto found = expected.find(key);
+    bool present = found != expected.end();
+    // any change made without the finger invalidates it
+    bool keepFinger = false;
+    switch (rng() % 12) {
+    case 0:
+    case 1:
+      if (!present) {
+        CHECK(tree.insert(record_type(key, i)));
+        expected.emplace(key, i);
+      }
+      break;
+    case 2:
+      if (!present) {
+        CHECK(tree.insert(record_type(key, i), finger));
+        expected.emplace(key, i);
+        // on the inserted record
+        CHECK(finger.get_key() == key && finger.get_value() == i);
+      }
+      keepFinger = true;
+      break;
+    case 3:
+    case 4:
+      CHECK(tree.remove(key) == present);
+      if (present) {
+        expected.erase(found);
+      }
+      break;
+    case 5:
+      CHECK(tree.insert_or_assign(key, i) == present);
+      expected[key] = i;
+      break;
+    case 6:
+      CHECK(tree.try_emplace(key, -i) == present);
+      expected.emplace(key, -i);
+      break;
+    case 7:
+      CHECK(tree.update(key, [](std::int64_t &pValue) { pValue += 3; }) ==
+            present);
+      expected[key] += 3;
+      break;
+    case 8:
+    case 9: {
+      const std::int64_t *value = constTree.search(key, finger);
+      CHECK(present ? value && *value == found->second : !value);
+      CHECK(is_at(finger, tree.end(), expected.lower_bound(key), expected));
+      keepFinger = true;
+      break;
+    }
+    default: {
+      const std::int64_t *value = constTree.search(key);
+      CHECK(present ? value && *value == found->second : !value);
+      break;
+    }
+    }
+    if (!keepFinger) {
+      finger = typename Tree::const_iterator();
+    }
+    if (i % 5000 == 0) {
+      check_whole(tree, expected, rng, pRange);
+    }
+  }
+  check_whole(tree, expected, rng, pRange);
+  if (pPolicy == bpt::REMOVE_LAZY) {
+    tree.compact();
+    check_whole(tree, expected, rng, pRange);
+  }
+  // empty it again
+  while (!expected.empty()) {
+    CHECK(tree.remove(expected.begin()->first));
+    expected.erase(expected.begin());
+  }
+  check_whole(tree, expected, rng, pRange);
+}
+
+// Inserts and lookups only, with and without a finger, then a save and a
+// load: removes take out every equal key of a leaf at once, which a
+// multimap cannot model.
+template <typename Tree> void fuzz_duplicates(std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  const std::int64_t range = 50;
+  Tree tree;
+  multi_model_type expected;
+  std::mt19937_64 rng(pSeed);
+  typename Tree::const_iterator finger;
+  for (std::int64_t i = 0; i < 20000; i++) {
+    std::int64_t key = std::int64_t(rng() % range);
+    switch (rng() % 3) {
+    case 0:
+      // equal keys go behind the ones already there, as in the multimap
+      CHECK(tree.insert(record_type(key, i)));
+      expected.emplace(key, i);
+      finger = typename Tree::const_iterator();
+      break;
+    case 1:
+      CHECK(tree.insert(record_type(key, i), finger));
+      expected.emplace(key, i);
+      CHECK(finger.get_key() == key && finger.get_value() == i);
+      break;
+    default: {
+      // on the first of the equal records, from wherever the finger was
+      const std::int64_t *value = tree.search(key, finger);
+      auto first = expected.lower_bound(key);
+      CHECK(is_at(finger, tree.end(), first, expected));
+      std::size_t count = expected.count(key);
+      CHECK(count == 0 ? !value : value && *value == first->second);
+      auto it = finger;
+      for (std::size_t seen = 0; seen < count; seen++, ++it) {
+        CHECK(it != tree.end() && it.get_key() == key);
+      }
+      CHECK(it == tree.end() || it.get_key() != key);
+      break;
+    }
+    }
+    if (i % 2000 == 0) {
+      check_whole(tree, expected, rng, range);
+    }
+  }
+  check_whole(tree, expected, rng, range);
+  // a dump keeps equal keys in their order
+  const char *path = "bplustree_test.dump";
+  CHECK(tree.save(path));
+  Tree loaded;
+  CHECK(loaded.load(path));
+  check_whole(loaded, expected, rng, range);
+  std::remove(path);
+}
+
+// Keys in ascending order take the shortcut to the last leaf and split it
+// at the right edge, which leaves the nodes behind it full. Removes at the
+// right edge and keys put into the gaps must still land where they belong.
+template <typename Tree> void check_appends(std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  const std::int64_t range = 40000;
+  Tree tree;
+  model_type expected;
+  std::mt19937_64 rng(pSeed);
+  for (std::int64_t key = 0; key < range; key += 2) {
+    CHECK(tree.insert(record_type(key, -key)));
+    expected.emplace(key, -key);
+  }
+  check_whole(tree, expected, rng, range);
+  CHECK(tree.get_stats().mLeafFill > 0.9);
+  // and no inner node is left without a key of its own
+  CHECK(tree.get_stats().mInnerOccupancy[0] == 0);
+  // shrink the right edge, then grow it again
+  for (int i = 0; i < 3000; i++) {
+    CHECK(tree.remove(std::prev(expected.end())->first));
+    expected.erase(std::prev(expected.end()));
+  }
+  for (std::int64_t key = range - 6000; key < range; key += 2) {
+    CHECK(tree.insert(record_type(key, key)));
+    expected.emplace(key, key);
+  }
+  check_whole(tree, expected, rng, range);
+  for (int i = 0; i < 10000; i++) {
+    std::int64_t key = 2 * std::int64_t(rng() % (range / 2)) + 1;
+    if (!expected.count(key)) {
+      CHECK(tree.insert(record_type(key, i)));
+      expected.emplace(key, i);
+    }
+  }
+  check_whole(tree, expected, rng, range);
+  // the counts of a bulk-loaded tree are taken after the build
+  std::vector<record_type> records;
+  for (const auto &entry : expected) {
+    records.emplace_back(entry.first, entry.second);
+  }
+  Tree loaded;
+  CHECK(loaded.bulk_load(records.begin(), records.end(), 0.6));
+  check_whole(loaded, expected, rng, range);
+}
+
+template <typename Tree> void fuzz_all(std::uint64_t pSeed) {
+  for (bpt::remove_policy policy :
+       {bpt::REMOVE_MERGE, bpt::REMOVE_REDISTRIBUTE, bpt::REMOVE_LAZY}) {
+    fuzz<Tree>(policy, 50, 20000, pSeed);
+    fuzz<Tree>(policy, 20000, 60000, pSeed + 1);
+  }
+  fuzz_duplicates<Tree>(pSeed + 2);
+  check_appends<Tree>(pSeed + 3);
+}
+
+} // namespace
+
+int main() {
+  typedef std::less<std::int64_t> less;
+  fuzz_all<bpt::bplustree<std::int64_t, std::int64_t, less, 3>>(1);
+  fuzz_all<bpt::bplustree<std::int64_t, std::int64_t, less, 4,
+                          bpt::binary_search_policy>>(10);
+  fuzz_all<bpt::bplustree<std::int64_t, std::int64_t>>(20);
+  fuzz_all<bpt::bplustree<std::int64_t, std::int64_t, less, 5,
+                          bpt::simd_search_policy, true>>(30);
+  fuzz_all<bpt::bplustree<std::int64_t, std::int64_t, less, 30,
+                          bpt::simd_search_policy, true>>(40);
+  std::printf("ok\n");
+  return 0;
+}
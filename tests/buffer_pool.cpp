@@ -0,0 +1,165 @@
+// buffer_pool_page_store on its own and under paged_bplustree. A tree on a
+// pool of MIN_FRAMES frames, far fewer than its pages, is run against a
+// std::map through inserts, removes, searches, scans and reopens. Then
+// the failure paths: a pin with every frame pinned, a pin of a page the
+// file no longer holds in full, and a tree whose file was cut short under
+// it. Each must be reported, by pin(), flush() and close() or by
+// page_error, and never come back as a zero-filled page.
+
+#include "buffer_pool.hpp"
+#include "paged_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+typedef bpt::paged_bplustree<std::int64_t, std::int64_t,
+                             std::less<std::int64_t>,
+                             bpt::buffer_pool_page_store>
+    tree_type;
+
+const char *const PATH = "buffer_pool_test.tree";
+
+bool open_tree(tree_type &pTree) {
+  pTree.get_store().set_frame_count(bpt::buffer_pool_page_store::MIN_FRAMES);
+  return pTree.open(PATH);
+}
+
+void check_against_map() {
+  ::unlink(PATH);
+  std::map<std::int64_t, std::int64_t> expected;
+  std::mt19937_64 rng(1);
+  std::uniform_int_distribution<std::int64_t> pick(0, 20000);
+  tree_type tree;
+  CHECK(open_tree(tree));
+  for (int i = 0; i < 200000; i++) {
+    std::int64_t key = pick(rng);
+    std::int64_t value;
+    switch (rng() % 8) {
+    case 0:
+    case 1:
+    case 2:
+      CHECK(tree.insert(tree_type::record_type(key, i)) ==
+            expected.emplace(key, i).second);
+      break;
+    case 3:
+    case 4:
+      CHECK(tree.remove(key) == (expected.erase(key) == 1));
+      break;
+    case 5: {
+      std::int64_t high = key + 100;
+      auto it = expected.lower_bound(key);
+      bool same = true;
+      tree.scan(key, high, [&](std::int64_t pKey, std::int64_t pValue) {
+        same = same && it != expected.end() && it->first == pKey &&
+               it->second == pValue;
+        ++it;
+      });
+      CHECK(same && (it == expected.end() || it->first >= high));
+      break;
+    }
+    case 6:
+      if (rng() % 1000 == 0) {
+        CHECK(tree.close());
+        CHECK(open_tree(tree));
+      }
+      break;
+    default: {
+      auto it = expected.find(key);
+      CHECK(tree.search(key, value) == (it != expected.end()));
+      CHECK(it == expected.end() || value == it->second);
+      break;
+    }
+    }
+  }
+  CHECK(tree.get_record_count() == expected.size());
+  CHECK(tree.get_store().get_stats().mEvictions > 0);
+  CHECK(tree.close());
+  CHECK(open_tree(tree));
+  for (const auto &r : expected) {
+    std::int64_t value;
+    CHECK(tree.search(r.first, value) && value == r.second);
+  }
+  CHECK(tree.close());
+}
+
+void check_all_pinned() {
+  ::unlink(PATH);
+  bpt::buffer_pool_page_store store;
+  store.set_frame_count(bpt::buffer_pool_page_store::MIN_FRAMES);
+  CHECK(store.open(PATH));
+  std::size_t frames = store.get_frame_count();
+  CHECK(store.resize(frames + 1));
+  for (bpt::page_id id = 0; id < frames; id++) {
+    CHECK(store.pin(id) != nullptr);
+  }
+  CHECK(store.pin(bpt::page_id(frames)) == nullptr);
+  CHECK(!store.flush());
+  store.unpin(0, false);
+  CHECK(store.pin(bpt::page_id(frames)) != nullptr);
+  CHECK(store.flush());
+  store.unpin(bpt::page_id(frames), false);
+  for (bpt::page_id id = 1; id < frames; id++) {
+    store.unpin(id, false);
+  }
+  CHECK(store.close());
+}
+
+void check_short_read() {
+  ::unlink(PATH);
+  bpt::buffer_pool_page_store store;
+  CHECK(store.open(PATH));
+  CHECK(store.resize(4));
+  CHECK(::truncate(PATH, 2 * bpt::buffer_pool_page_store::PAGE_SIZE +
+                             100) == 0);
+  CHECK(store.pin(1) != nullptr);
+  store.unpin(1, false);
+  // page 2 has only 100 bytes left and page 3 none
+  CHECK(store.pin(2) == nullptr);
+  CHECK(store.pin(3) == nullptr);
+  CHECK(!store.close());
+}
+
+void check_truncated_tree() {
+  ::unlink(PATH);
+  {
+    tree_type tree;
+    CHECK(open_tree(tree));
+    for (std::int64_t key = 0; key < 50000; key++) {
+      CHECK(tree.insert(tree_type::record_type(key, key)));
+    }
+    CHECK(tree.close());
+  }
+  tree_type tree;
+  CHECK(open_tree(tree));
+  CHECK(::truncate(PATH, bpt::buffer_pool_page_store::PAGE_SIZE) == 0);
+  bool thrown = false;
+  try {
+    std::int64_t value;
+    tree.search(25000, value);
+  } catch (const bpt::page_error &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(!tree.close());
+  ::unlink(PATH);
+}
+
+} // namespace
+
+int main() {
+  check_against_map();
+  check_all_pinned();
+  check_short_read();
+  check_truncated_tree();
+  std::printf("ok\n");
+  return 0;
+}
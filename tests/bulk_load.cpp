@@ -0,0 +1,156 @@
+// bulk_load against the sorted records it was given: empty, single and
+// large inputs at several fill factors, on two fanouts. Out of order and
+// duplicate keys must be turned down and leave the tree as it was, and a
+// loaded tree must take inserts and removes like any other. Then
+// parallel_bulk_load builds the same trees from shuffled records, and
+// insert_batch adds half of the records to a tree loaded with the other
+// half, on one thread and on several.
+
+#include "bplustree.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef std::map<std::int64_t, std::int64_t> model_type;
+
+template <typename Tree>
+void check_same(const Tree &pTree, const model_type &pExpected) {
+  auto it = pTree.begin();
+  for (const auto &entry : pExpected) {
+    CHECK(it != pTree.end() && it.get_key() == entry.first &&
+          it.get_value() == entry.second);
+    ++it;
+  }
+  CHECK(it == pTree.end());
+  CHECK(pTree.get_stats().mRecords == pExpected.size());
+  for (const auto &entry : pExpected) {
+    const std::int64_t *value = pTree.search(entry.first);
+    CHECK(value && *value == entry.second);
+  }
+}
+
+template <typename Tree> void check_bulk_load(std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  std::mt19937_64 rng(pSeed);
+  std::vector<record_type> records;
+  model_type expected;
+  for (std::int64_t i = 0; i < 50000; i++) {
+    std::int64_t key = 3 * i + std::int64_t(rng() % 3);
+    records.emplace_back(key, i);
+    expected.emplace(key, i);
+  }
+
+  for (std::size_t count : {0, 1, 2, 1000}) {
+    Tree tree;
+    CHECK(tree.bulk_load(records.begin(), records.begin() + count));
+    check_same(tree, model_type(expected.begin(),
+                                std::next(expected.begin(), count)));
+  }
+  for (double fill : {0.1, 0.7, 1.0}) {
+    Tree tree;
+    CHECK(tree.bulk_load(records.begin(), records.end(), fill));
+    check_same(tree, expected);
+    // filled up to the fill factor, but never below half, give or take
+    // the rounding of the records spread over the leaves
+    double leafFill = tree.get_stats().mLeafFill;
+    CHECK(leafFill > 0.49 && leafFill <= std::max(fill, 0.5) + 1e-9);
+  }
+
+  Tree tree;
+  CHECK(tree.bulk_load(records.begin(), records.end()));
+  // out of order and duplicate keys leave the tree as it was
+  std::vector<record_type> bad(records.begin(), records.begin() + 100);
+  std::swap(bad[40], bad[41]);
+  CHECK(!tree.bulk_load(bad.begin(), bad.end()));
+  bad[41] = bad[40];
+  CHECK(!tree.bulk_load(bad.begin(), bad.end()));
+  check_same(tree, expected);
+
+  // and then behaves like any other tree
+  for (int i = 0; i < 20000; i++) {
+    std::int64_t key = std::int64_t(rng() % 160000);
+    if (rng() % 2) {
+      CHECK(tree.remove(key) == (expected.erase(key) == 1));
+    } else if (!expected.count(key)) {
+      CHECK(tree.insert(record_type(key, -i)));
+      expected.emplace(key, -i);
+    }
+  }
+  check_same(tree, expected);
+}
+
+template <typename Tree> void check_parallel(std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  std::mt19937_64 rng(pSeed);
+  std::vector<record_type> records;
+  model_type expected;
+  for (std::int64_t i = 0; i < 50000; i++) {
+    std::int64_t key = 3 * i + std::int64_t(rng() % 3);
+    records.emplace_back(key, i);
+    expected.emplace(key, i);
+  }
+  std::shuffle(records.begin(), records.end(), rng);
+
+  for (unsigned threads : {1u, 3u, 8u}) {
+    std::vector<record_type> input(records);
+    Tree tree;
+    CHECK(tree.parallel_bulk_load(input.begin(), input.end(), threads, 0.8));
+    check_same(tree, expected);
+  }
+  // a key given twice leaves the tree as it was
+  Tree tree;
+  std::vector<record_type> input(records);
+  CHECK(tree.parallel_bulk_load(input.begin(), input.end(), 4));
+  std::vector<record_type> twice(records.begin(), records.begin() + 1000);
+  twice.push_back(twice.front());
+  CHECK(!tree.parallel_bulk_load(twice.begin(), twice.end(), 4));
+  check_same(tree, expected);
+
+  // half bulk-loaded, half inserted in batches
+  std::vector<record_type> low, high;
+  model_type lowExpected;
+  for (const record_type &r : records) {
+    if (r.get_key() % 2 == 0) {
+      low.push_back(r);
+      lowExpected.emplace(r.get_key(), r.get_value());
+    } else {
+      high.push_back(r);
+    }
+  }
+  std::sort(low.begin(), low.end(),
+            [](const record_type &pLeft, const record_type &pRight) {
+              return pLeft.get_key() < pRight.get_key();
+            });
+  for (unsigned threads : {1u, 4u}) {
+    Tree batched;
+    CHECK(batched.bulk_load(low.begin(), low.end(), 0.5));
+    check_same(batched, lowExpected);
+    batched.insert_batch(high.data(), high.size(), threads);
+    check_same(batched, expected);
+  }
+  // into an empty tree, which has no level to partition by
+  Tree empty;
+  empty.insert_batch(records.data(), records.size(), 4);
+  check_same(empty, expected);
+}
+
+} // namespace
+
+int main() {
+  check_bulk_load<bpt::bplustree<std::int64_t, std::int64_t,
+                                 std::less<std::int64_t>, 4>>(1);
+  check_bulk_load<bpt::bplustree<std::int64_t, std::int64_t>>(2);
+  check_parallel<bpt::bplustree<std::int64_t, std::int64_t,
+                                std::less<std::int64_t>, 4>>(3);
+  check_parallel<bpt::bplustree<std::int64_t, std::int64_t>>(4);
+  std::printf("ok\n");
+  return 0;
+}
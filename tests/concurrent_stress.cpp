@@ -0,0 +1,112 @@
+// Several threads insert, remove and search at once on one
+// concurrent_bplustree. Thread t owns the keys k with k % threads == t and
+// checks every result on them against its own std::set; it also searches
+// keys other threads own, which only has to come back without tearing a
+// value. Once the threads are done the tree must hold exactly the union of
+// their sets and pass verify(), and it must be empty and valid again after
+// all threads drain their keys concurrently. Small fanouts make splits,
+// merges and root changes frequent.
+
+#include "concurrent_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int THREAD_COUNTS[] = {2, 4, 8};
+const std::int64_t KEY_RANGE = 20000;
+const int OPERATIONS = 60000;
+
+std::int64_t value_of(std::int64_t pKey) { return pKey * 7 + 1; }
+
+template <int Fanout>
+void run(int pThreads) {
+  typedef bpt::concurrent_bplustree<std::int64_t, std::int64_t,
+                                    std::less<std::int64_t>, Fanout>
+      tree_type;
+  tree_type tree;
+  std::vector<std::set<std::int64_t>> owned(pThreads);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < pThreads; t++) {
+    workers.emplace_back([&tree, &owned, pThreads, t] {
+      std::set<std::int64_t> &mine = owned[t];
+      std::mt19937_64 rng(Fanout * 100 + t);
+      std::uniform_int_distribution<std::int64_t> pick(0, KEY_RANGE - 1);
+      for (int i = 0; i < OPERATIONS; i++) {
+        std::int64_t key = pick(rng);
+        std::int64_t value;
+        if (key % pThreads != t) {
+          if (tree.search(key, value)) {
+            CHECK(value == value_of(key));
+          }
+          continue;
+        }
+        switch (rng() % 3) {
+        case 0:
+          CHECK(tree.insert(typename tree_type::record_type(
+                    key, value_of(key))) == mine.insert(key).second);
+          break;
+        case 1:
+          CHECK(tree.remove(key) == (mine.erase(key) == 1));
+          break;
+        default:
+          CHECK(tree.search(key, value) == (mine.count(key) == 1));
+          CHECK(!mine.count(key) || value == value_of(key));
+          break;
+        }
+      }
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+
+  std::size_t records, expected = 0;
+  CHECK(tree.verify(records));
+  for (const std::set<std::int64_t> &mine : owned) {
+    expected += mine.size();
+    for (std::int64_t key : mine) {
+      std::int64_t value;
+      CHECK(tree.search(key, value) && value == value_of(key));
+    }
+  }
+  CHECK(records == expected);
+
+  workers.clear();
+  for (int t = 0; t < pThreads; t++) {
+    workers.emplace_back([&tree, &owned, t] {
+      for (std::int64_t key : owned[t]) {
+        CHECK(tree.remove(key));
+      }
+    });
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+  CHECK(tree.verify(records));
+  CHECK(records == 0);
+}
+
+template <int Fanout> void run_all() {
+  for (int threads : THREAD_COUNTS) {
+    run<Fanout>(threads);
+    std::printf("fanout %2d, %d threads: ok\n", Fanout, threads);
+  }
+}
+
+} // namespace
+
+int main() {
+  run_all<3>();
+  run_all<4>();
+  run_all<8>();
+  run_all<30>();
+  return 0;
+}
@@ -0,0 +1,214 @@
+// bplustree::save() and load(). Trees with integer and raw values make
+// the round trip, empty and across many blocks, and so do trees holding
+// keys many times over. Then dumps that are cut short, flipped, padded or
+// carry a record count or block size far beyond the file must be turned
+// down with false, with the tree left as it was and no file left open,
+// and a save that cannot be written must keep the dump it would have
+// replaced.
+
+#include "bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+typedef bpt::bplustree<std::int64_t, std::int64_t> tree_type;
+
+const char *const PATH = "dump_test.dump";
+
+template <typename Tree, typename Map>
+bool same(const Tree &pTree, const Map &pExpected) {
+  auto it = pTree.begin();
+  for (const auto &entry : pExpected) {
+    if (it == pTree.end() || it.get_key() != entry.first ||
+        it.get_value() != entry.second) {
+      return false;
+    }
+    ++it;
+  }
+  return it == pTree.end();
+}
+
+template <typename Value> void check_round_trip(std::size_t pRecords) {
+  typedef bpt::bplustree<std::int64_t, Value> tree;
+  std::map<std::int64_t, Value> expected;
+  std::mt19937_64 rng(pRecords);
+  std::uniform_int_distribution<std::int64_t> pick(-(1 << 30), 1 << 30);
+  tree saved;
+  while (expected.size() < pRecords) {
+    std::int64_t key = pick(rng);
+    Value value = Value(pick(rng)) / 3;
+    if (expected.emplace(key, value).second) {
+      saved.insert(typename tree::record_type(key, value));
+    }
+  }
+  CHECK(saved.save(PATH));
+  tree loaded;
+  loaded.insert(typename tree::record_type(7, Value(7)));
+  CHECK(loaded.load(PATH));
+  CHECK(same(loaded, expected));
+  CHECK(loaded.get_stats().mRecords == pRecords);
+}
+
+// equal keys, which bulk_load turns down, come back in the order saved
+void check_duplicates() {
+  std::multimap<std::int64_t, std::int64_t> expected;
+  tree_type saved;
+  for (std::int64_t i = 0; i < 100; i++) {
+    expected.emplace(i, i);
+    saved.insert(tree_type::record_type(i, i));
+  }
+  expected.emplace(5, -5);
+  saved.insert(tree_type::record_type(5, -5));
+  CHECK(saved.save(PATH));
+  tree_type loaded;
+  CHECK(loaded.load(PATH));
+  CHECK(same(loaded, expected));
+
+  // runs of equal keys longer than a leaf and than a block
+  std::mt19937_64 rng(1);
+  for (std::int64_t i = 0; i < 50000; i++) {
+    std::int64_t key = std::int64_t(rng() % 50);
+    expected.emplace(key, i);
+    saved.insert(tree_type::record_type(key, i));
+  }
+  CHECK(saved.save(PATH));
+  CHECK(loaded.load(PATH));
+  CHECK(same(loaded, expected));
+  CHECK(loaded.get_stats().mRecords == expected.size());
+  for (std::int64_t key = -1; key <= 100; key++) {
+    auto first = expected.lower_bound(key);
+    auto it = loaded.lower_bound(key);
+    CHECK(first == expected.end()
+              ? it == loaded.end()
+              : it != loaded.end() && it.get_value() == first->second);
+  }
+}
+
+std::vector<char> read_file(const char *pPath) {
+  std::vector<char> bytes;
+  std::FILE *file = std::fopen(pPath, "rb");
+  CHECK(file);
+  int c;
+  while ((c = std::fgetc(file)) != EOF) {
+    bytes.push_back(char(c));
+  }
+  std::fclose(file);
+  return bytes;
+}
+
+void write_file(const char *pPath, const std::vector<char> &pBytes) {
+  std::FILE *file = std::fopen(pPath, "wb");
+  CHECK(file);
+  CHECK(std::fwrite(pBytes.data(), 1, pBytes.size(), file) == pBytes.size());
+  CHECK(std::fclose(file) == 0);
+}
+
+// the lowest free descriptor, which moves if a load leaks its file
+int get_free_descriptor() {
+  int fd = ::open("/dev/null", O_RDONLY);
+  CHECK(fd >= 0);
+  ::close(fd);
+  return fd;
+}
+
+void check_rejected(const std::vector<char> &pBytes,
+                    const std::map<std::int64_t, std::int64_t> &pExpected,
+                    tree_type &pTree) {
+  write_file(PATH, pBytes);
+  int fd = get_free_descriptor();
+  CHECK(!pTree.load(PATH));
+  CHECK(get_free_descriptor() == fd);
+  CHECK(same(pTree, pExpected));
+}
+
+void check_damaged() {
+  std::map<std::int64_t, std::int64_t> expected;
+  tree_type tree;
+  for (std::int64_t i = 0; i < 20000; i++) {
+    expected.emplace(3 * i, i);
+    tree.insert(tree_type::record_type(3 * i, i));
+  }
+  CHECK(tree.save(PATH));
+  const std::vector<char> good = read_file(PATH);
+  CHECK(tree.load(PATH));
+  CHECK(same(tree, expected));
+
+  std::vector<char> bytes(good.begin(), good.begin() + good.size() / 2);
+  check_rejected(bytes, expected, tree);
+  bytes.assign(good.begin(), good.begin() + sizeof(bpt::dump_header) - 1);
+  check_rejected(bytes, expected, tree);
+  bytes = good;
+  bytes[good.size() / 3] ^= 0x10;
+  check_rejected(bytes, expected, tree);
+  bytes = good;
+  bytes.push_back(0);
+  check_rejected(bytes, expected, tree);
+
+  // counts that would have the build reserve or allocate for them
+  bpt::dump_header header;
+  std::memcpy(&header, good.data(), sizeof(header));
+  for (std::uint64_t count :
+       {header.mCount + 1, std::uint64_t(1) << 58, ~std::uint64_t(0)}) {
+    bpt::dump_header patched = header;
+    patched.mCount = count;
+    bytes = good;
+    std::memcpy(bytes.data(), &patched, sizeof(patched));
+    check_rejected(bytes, expected, tree);
+  }
+  // the size of the first block
+  std::uint32_t blockSize = 0xFFFFFFF0;
+  bytes = good;
+  std::memcpy(bytes.data() + sizeof(header), &blockSize, sizeof(blockSize));
+  check_rejected(bytes, expected, tree);
+
+  CHECK(!tree.load("dump_test.missing"));
+  CHECK(same(tree, expected));
+}
+
+void check_failed_save() {
+  tree_type tree;
+  std::map<std::int64_t, std::int64_t> expected;
+  for (std::int64_t i = 0; i < 1000; i++) {
+    expected.emplace(i, -i);
+    tree.insert(tree_type::record_type(i, -i));
+  }
+  CHECK(tree.save(PATH));
+  tree.insert(tree_type::record_type(5000, 5000));
+
+  // a directory in the way of the temporary file
+  std::string temporary = std::string(PATH) + ".tmp";
+  CHECK(::mkdir(temporary.c_str(), 0755) == 0);
+  CHECK(!tree.save(PATH));
+  CHECK(::rmdir(temporary.c_str()) == 0);
+  tree_type loaded;
+  CHECK(loaded.load(PATH));
+  CHECK(same(loaded, expected));
+  CHECK(!tree.save("dump_test.missing/tree.dump"));
+}
+
+} // namespace
+
+int main() {
+  check_round_trip<std::int64_t>(0);
+  check_round_trip<std::int64_t>(1);
+  check_round_trip<std::int64_t>(50000);
+  check_round_trip<double>(50000);
+  check_duplicates();
+  check_damaged();
+  check_failed_save();
+  std::remove(PATH);
+  std::printf("ok\n");
+  return 0;
+}
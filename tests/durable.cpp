@@ -0,0 +1,231 @@
+// Recovery of durable_bplustree. A crash is a child process that leaves
+// through _exit() without closing the tree, after every call it made has
+// returned; the parent then opens the files and compares the tree with a
+// std::map model of the same calls. Covered are replay of a log with no
+// snapshot, a log whose last record was torn or followed by garbage, a
+// snapshot that was damaged or cut short, and checkpoints that run while
+// other threads insert, remove and search.
+
+#include "durable_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+typedef bpt::durable_bplustree<std::int64_t, std::int64_t> tree_type;
+typedef std::map<std::int64_t, std::int64_t> model_type;
+
+const std::string PATH = "durable_test";
+const int WORKERS = 4;
+const int OPERATIONS = 3000;
+
+void remove_files() {
+  for (const char *suffix :
+       {".snapshot", ".snapshot.tmp", ".wal", ".wal.tmp"}) {
+    ::unlink((PATH + suffix).c_str());
+  }
+}
+
+// Runs pBody(tree) in a child that then "crashes": the tree is never
+// closed or destroyed.
+template <typename Body> void run_child(std::size_t pThreshold, Body pBody) {
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    tree_type *tree = new tree_type();
+    tree->set_checkpoint_threshold(pThreshold);
+    CHECK(tree->open(PATH));
+    pBody(*tree);
+    _exit(0);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+void check_tree(const model_type &pModel, std::int64_t pKeys) {
+  tree_type tree;
+  CHECK(tree.open(PATH));
+  for (std::int64_t key = 0; key < pKeys; key++) {
+    std::int64_t value;
+    auto it = pModel.find(key);
+    CHECK(tree.search(key, value) == (it != pModel.end()));
+    CHECK(it == pModel.end() || value == it->second);
+  }
+}
+
+std::size_t get_file_size(const std::string &pPath) {
+  struct stat st;
+  CHECK(stat(pPath.c_str(), &st) == 0);
+  return st.st_size;
+}
+
+void flip_byte(const std::string &pPath, std::size_t pOffset) {
+  FILE *file = std::fopen(pPath.c_str(), "r+b");
+  CHECK(file);
+  CHECK(std::fseek(file, long(pOffset), SEEK_SET) == 0);
+  int c = std::fgetc(file);
+  CHECK(c != EOF);
+  CHECK(std::fseek(file, long(pOffset), SEEK_SET) == 0);
+  std::fputc(c ^ 0x40, file);
+  std::fclose(file);
+}
+
+// inserts the keys below pCount, with no checkpoint, then crashes
+void crash_after_inserts(std::int64_t pCount) {
+  remove_files();
+  run_child(0, [pCount](tree_type &pTree) {
+    for (std::int64_t key = 0; key < pCount; key++) {
+      CHECK(pTree.insert(tree_type::record_type(key, key * 3)));
+    }
+  });
+}
+
+void check_replay() {
+  crash_after_inserts(1000);
+  model_type model;
+  for (std::int64_t key = 0; key < 1000; key++) {
+    model[key] = key * 3;
+  }
+  check_tree(model, 1100);
+}
+
+void check_torn_tail() {
+  crash_after_inserts(1000);
+  // tear the last record
+  std::string log = PATH + ".wal";
+  CHECK(::truncate(log.c_str(), get_file_size(log) - 3) == 0);
+  model_type model;
+  for (std::int64_t key = 0; key < 999; key++) {
+    model[key] = key * 3;
+  }
+  check_tree(model, 1100);
+
+  // the torn bytes are gone, so records written behind them are read back
+  run_child(0, [](tree_type &pTree) {
+    CHECK(pTree.insert(tree_type::record_type(5000, 1)));
+  });
+  model[5000] = 1;
+  check_tree(model, 5001);
+
+  // garbage behind the last record is dropped as well
+  crash_after_inserts(1000);
+  FILE *file = std::fopen(log.c_str(), "ab");
+  CHECK(file);
+  std::fputs("not a log record", file);
+  std::fclose(file);
+  model.erase(5000);
+  model[999] = 999 * 3;
+  check_tree(model, 1100);
+}
+
+void check_damaged_snapshot() {
+  remove_files();
+  {
+    tree_type tree;
+    CHECK(tree.open(PATH));
+    for (std::int64_t key = 0; key < 1000; key++) {
+      CHECK(tree.insert(tree_type::record_type(key, key)));
+    }
+    // close() takes a checkpoint
+  }
+  std::string snapshot = PATH + ".snapshot";
+  std::size_t size = get_file_size(snapshot);
+  CHECK(get_file_size(PATH + ".wal") == 0);
+  {
+    tree_type tree;
+    CHECK(tree.open(PATH));
+  }
+
+  flip_byte(snapshot, size - 5);
+  {
+    tree_type tree;
+    CHECK(!tree.open(PATH));
+  }
+  flip_byte(snapshot, size - 5);
+  CHECK(::truncate(snapshot.c_str(), size - 16) == 0);
+  {
+    tree_type tree;
+    CHECK(!tree.open(PATH));
+  }
+}
+
+model_type run_worker(tree_type *pTree, int pWorker) {
+  model_type model;
+  std::mt19937_64 rng(pWorker + 1);
+  for (int i = 0; i < OPERATIONS; i++) {
+    std::int64_t key = pWorker + WORKERS * std::int64_t(rng() % 500);
+    if (rng() % 3) {
+      bool inserted = model.emplace(key, i).second;
+      if (pTree) {
+        CHECK(pTree->insert(tree_type::record_type(key, i)) == inserted);
+      }
+    } else {
+      bool removed = model.erase(key) == 1;
+      if (pTree) {
+        CHECK(pTree->remove(key) == removed);
+      }
+    }
+  }
+  return model;
+}
+
+void check_concurrent_checkpoints() {
+  remove_files();
+  // a checkpoint every few hundred records, while the others write
+  run_child(4096, [](tree_type &pTree) {
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WORKERS; w++) {
+      threads.emplace_back([&pTree, w] { run_worker(&pTree, w); });
+    }
+    std::atomic<bool> done(false);
+    std::thread checkpointer([&pTree] {
+      for (int i = 0; i < 50; i++) {
+        CHECK(pTree.checkpoint());
+      }
+    });
+    std::thread reader([&pTree, &done] {
+      std::mt19937_64 rng(99);
+      while (!done.load()) {
+        std::int64_t value;
+        pTree.search(std::int64_t(rng() % (500 * WORKERS)), value);
+      }
+    });
+    for (std::thread &t : threads) {
+      t.join();
+    }
+    checkpointer.join();
+    done.store(true);
+    reader.join();
+  });
+  model_type model;
+  for (int w = 0; w < WORKERS; w++) {
+    model_type part = run_worker(nullptr, w);
+    model.insert(part.begin(), part.end());
+  }
+  check_tree(model, 500 * WORKERS);
+}
+
+} // namespace
+
+int main() {
+  check_replay();
+  check_torn_tail();
+  check_damaged_snapshot();
+  check_concurrent_checkpoints();
+  remove_files();
+  std::printf("ok\n");
+  return 0;
+}
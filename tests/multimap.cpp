@@ -0,0 +1,123 @@
+// multimap_bplustree against a std::map of std::sets: random inserts and
+// removes of pairs, removes of whole keys and lookups, for two value
+// types. A few hot keys collect thousands of values, so their posting
+// lists spill out of line into chunks, split and shrink back inline as
+// they empty again, while most keys keep a handful.
+
+#include "multimap_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+
+namespace {
+
+template <typename Key, typename Value>
+void check_key(const bpt::multimap_bplustree<Key, Value> &pMap,
+               const std::map<Key, std::set<Value>> &pExpected, Key pKey) {
+  auto found = pExpected.find(pKey);
+  std::size_t count = found == pExpected.end() ? 0 : found->second.size();
+  CHECK(pMap.count(pKey) == count);
+  std::size_t seen = 0;
+  auto it = found == pExpected.end() ? typename std::set<Value>::iterator()
+                                     : found->second.begin();
+  for (Value value : pMap.equal_range(pKey)) {
+    CHECK(seen < count && value == *it);
+    ++it;
+    seen++;
+  }
+  CHECK(seen == count);
+  CHECK(pMap.equal_range(pKey).empty() == (count == 0));
+}
+
+template <typename Key, typename Value>
+void check_against_map(int pOperations, std::uint64_t pSeed) {
+  typedef bpt::multimap_bplustree<Key, Value> map_type;
+  std::map<Key, std::set<Value>> expected;
+  std::size_t pairs = 0;
+  std::mt19937_64 rng(pSeed);
+  map_type map;
+  for (int i = 0; i < pOperations; i++) {
+    // a quarter of the operations hit one of four hot keys
+    Key key = rng() % 4 == 0 ? Key(rng() % 4) : Key(rng() % 5000);
+    // values in runs, as ids assigned in order come, and scattered
+    Value value = rng() % 2 ? Value(rng() % 20000) : Value(rng());
+    switch (rng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3: {
+      bool added = expected[key].insert(value).second;
+      CHECK(map.insert(typename map_type::record_type(key, value)) == added);
+      pairs += added;
+      break;
+    }
+    case 4:
+    case 5: {
+      auto found = expected.find(key);
+      bool present = found != expected.end() && found->second.erase(value);
+      CHECK(map.remove(key, value) == present);
+      pairs -= present;
+      if (present && found->second.empty()) {
+        expected.erase(found);
+      }
+      break;
+    }
+    case 6:
+      if (rng() % 16 == 0) {
+        auto found = expected.find(key);
+        std::size_t count = found == expected.end() ? 0 : found->second.size();
+        CHECK(map.remove(key) == count);
+        pairs -= count;
+        if (found != expected.end()) {
+          expected.erase(found);
+        }
+      }
+      break;
+    case 7: {
+      auto found = expected.find(key);
+      bool present = found != expected.end() && found->second.count(value);
+      CHECK(map.contains(key, value) == present);
+      break;
+    }
+    default:
+      check_key(map, expected, key);
+      break;
+    }
+    // inserts of new keys make empty sets in the model
+    if (expected.count(key) && expected[key].empty()) {
+      expected.erase(key);
+    }
+    CHECK(map.get_size() == pairs);
+    CHECK(map.get_key_count() == expected.size());
+  }
+  CHECK(map.get_memory_usage() > 0);
+  for (const auto &entry : expected) {
+    check_key(map, expected, entry.first);
+  }
+  // empty the hot keys one value at a time, the others a key at a time
+  for (auto it = expected.begin(); it != expected.end();
+       it = expected.erase(it)) {
+    if (it->first < Key(4)) {
+      for (Value value : it->second) {
+        CHECK(map.remove(it->first, value));
+      }
+      CHECK(map.count(it->first) == 0);
+    } else {
+      CHECK(map.remove(it->first) == it->second.size());
+    }
+  }
+  CHECK(map.get_size() == 0 && map.get_key_count() == 0);
+}
+
+} // namespace
+
+int main() {
+  check_against_map<std::int64_t, std::uint32_t>(300000, 1);
+  check_against_map<std::int32_t, std::int64_t>(300000, 2);
+  std::printf("ok\n");
+  return 0;
+}
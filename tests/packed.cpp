@@ -0,0 +1,148 @@
+// packed_bplustree against a std::map: random inserts, removes, searches
+// and scans for several key types, leaf sizes and key distributions, from
+// dense runs that pack into a few bits to keys spread over the whole range
+// of the type, which force leaves back to full width and split them. The
+// extremes of the key type are always in the mix. Each run ends by
+// removing every record, which merges the leaves down to one again.
+
+#include "packed_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <random>
+
+namespace {
+
+struct triple {
+  std::int32_t mA;
+  std::int16_t mB;
+  std::int8_t mC;
+
+  friend bool operator==(const triple &pLeft, const triple &pRight) {
+    return pLeft.mA == pRight.mA && pLeft.mB == pRight.mB &&
+           pLeft.mC == pRight.mC;
+  }
+};
+
+template <typename Value> Value make_value(std::int64_t pSeed) {
+  return Value(pSeed);
+}
+
+template <> triple make_value<triple>(std::int64_t pSeed) {
+  return triple{std::int32_t(pSeed), std::int16_t(pSeed * 3),
+                std::int8_t(pSeed * 7)};
+}
+
+// Keys from one of a few distributions: 0 dense around a moving point, 1
+// anywhere in the type, 2 the extremes and their neighbours.
+template <typename Key> struct key_source {
+  typedef std::numeric_limits<Key> limits;
+
+  explicit key_source(std::uint64_t pSeed) : mRng(pSeed), mCentre(0) {}
+
+  // pKey + pStep, held at the top of the type rather than wrapping
+  static Key above(Key pKey, Key pStep) {
+    return pKey > Key(limits::max() - pStep) ? limits::max()
+                                              : Key(pKey + pStep);
+  }
+
+  Key next() {
+    switch (mRng() % 8) {
+    case 0:
+      mCentre = Key(mRng());
+      return mCentre;
+    case 1:
+    case 2:
+      return Key(mRng());
+    case 3:
+      return mRng() % 2 ? Key(limits::min() + Key(mRng() % 4))
+                        : Key(limits::max() - Key(mRng() % 4));
+    default:
+      return above(mCentre, Key(mRng() % 512));
+    }
+  }
+
+  std::mt19937_64 mRng;
+  Key mCentre;
+};
+
+template <typename Tree>
+void check_scan(const Tree &pTree,
+                const std::map<typename Tree::traits::key_type,
+                               typename Tree::traits::value_type> &pExpected,
+                typename Tree::traits::key_type pLow,
+                typename Tree::traits::key_type pHigh) {
+  typedef typename Tree::traits::key_type key_type;
+  typedef typename Tree::traits::value_type value_type;
+  auto it = pExpected.lower_bound(pLow);
+  bool same = true;
+  pTree.scan(pLow, pHigh, [&](const key_type &pKey, const value_type &pValue) {
+    same = same && it != pExpected.end() && it->first == pKey &&
+           it->second == pValue;
+    ++it;
+  });
+  CHECK(same && (it == pExpected.end() || !(it->first < pHigh)));
+}
+
+template <typename Key, typename Value, int LeafBytes>
+void check_against_map(int pOperations, std::uint64_t pSeed) {
+  typedef bpt::packed_bplustree<Key, Value, LeafBytes> tree_type;
+  typedef typename tree_type::record_type record_type;
+  std::map<Key, Value> expected;
+  key_source<Key> keys(pSeed);
+  tree_type tree;
+  for (int i = 0; i < pOperations; i++) {
+    Key key = keys.next();
+    switch (keys.mRng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3: {
+      Value value = make_value<Value>(i);
+      CHECK(tree.insert(record_type(key, value)) ==
+            expected.emplace(key, value).second);
+      break;
+    }
+    case 4:
+    case 5:
+      CHECK(tree.remove(key) == (expected.erase(key) == 1));
+      break;
+    case 6:
+      check_scan(tree, expected, key,
+                 keys.above(key, Key(keys.mRng() % 2048)));
+      break;
+    default: {
+      auto it = expected.find(key);
+      const Value *value = tree.search(key);
+      CHECK(it == expected.end() ? !value : value && *value == it->second);
+      break;
+    }
+    }
+    CHECK(tree.get_size() == expected.size());
+  }
+  typedef std::numeric_limits<Key> limits;
+  check_scan(tree, expected, limits::min(), limits::max());
+  CHECK(tree.get_memory_usage() > 0);
+  for (auto it = expected.begin(); it != expected.end();
+       it = expected.erase(it)) {
+    CHECK(tree.remove(it->first));
+    CHECK(!tree.search(it->first));
+  }
+  CHECK(tree.get_size() == 0);
+  check_scan(tree, expected, limits::min(), limits::max());
+}
+
+} // namespace
+
+int main() {
+  check_against_map<std::int64_t, std::int64_t, 1024>(200000, 1);
+  check_against_map<std::int64_t, std::int64_t, 128>(100000, 2);
+  check_against_map<std::uint32_t, triple, 256>(100000, 3);
+  check_against_map<std::int16_t, double, 512>(100000, 4);
+  check_against_map<std::uint8_t, std::int32_t, 96>(20000, 5);
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,129 @@
+// paged_bplustree on mmap_page_store against a std::map: random inserts,
+// removes, searches and scans, with the file flushed, closed and opened
+// again along the way, for two key and value sizes. Then open() must turn
+// down files it did not write: one of another key size and one of
+// garbage.
+
+#include "paged_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+const char *const PATH = "paged_test.tree";
+
+template <typename Key, typename Value>
+void check_against_map(std::int64_t pRange, std::uint64_t pSeed) {
+  typedef bpt::paged_bplustree<Key, Value> tree_type;
+  ::unlink(PATH);
+  std::map<Key, Value> expected;
+  std::mt19937_64 rng(pSeed);
+  std::uniform_int_distribution<std::int64_t> pick(-pRange, pRange);
+  tree_type tree;
+  CHECK(tree.open(PATH));
+  for (int i = 0; i < 300000; i++) {
+    Key key = Key(pick(rng));
+    Value value;
+    switch (rng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      CHECK(tree.insert(typename tree_type::record_type(key, Value(i))) ==
+            expected.emplace(key, Value(i)).second);
+      break;
+    case 4:
+    case 5:
+      CHECK(tree.remove(key) == (expected.erase(key) == 1));
+      break;
+    case 6: {
+      Key high = Key(key + Key(rng() % 200));
+      auto it = expected.lower_bound(key);
+      bool same = true;
+      tree.scan(key, high, [&](const Key &pKey, const Value &pValue) {
+        same = same && it != expected.end() && it->first == pKey &&
+               it->second == pValue;
+        ++it;
+      });
+      CHECK(same && (it == expected.end() || !(it->first < high)));
+      break;
+    }
+    case 7:
+      if (rng() % 2000 == 0) {
+        CHECK(tree.flush());
+      } else if (rng() % 2000 == 0) {
+        CHECK(tree.close());
+        CHECK(!tree.is_open());
+        CHECK(tree.open(PATH));
+        CHECK(tree.get_record_count() == expected.size());
+      }
+      break;
+    default: {
+      auto it = expected.find(key);
+      CHECK(tree.search(key, value) == (it != expected.end()));
+      CHECK(it == expected.end() || value == it->second);
+      break;
+    }
+    }
+  }
+  CHECK(tree.get_record_count() == expected.size());
+  CHECK(tree.get_height() > 0);
+  CHECK(tree.close());
+  CHECK(tree.open(PATH));
+  auto it = expected.begin();
+  tree.scan(expected.begin()->first, Key(pRange),
+            [&it](const Key &pKey, const Value &pValue) {
+              CHECK(pKey == it->first && pValue == it->second);
+              ++it;
+            });
+  CHECK(it == expected.end() || !(it->first < Key(pRange)));
+  // emptied, the tree still opens and takes records again
+  for (const auto &r : expected) {
+    CHECK(tree.remove(r.first));
+  }
+  CHECK(tree.get_record_count() == 0);
+  CHECK(tree.close());
+  CHECK(tree.open(PATH));
+  CHECK(tree.insert(typename tree_type::record_type(Key(1), Value(2))));
+  CHECK(tree.close());
+}
+
+void check_foreign_files() {
+  ::unlink(PATH);
+  {
+    bpt::paged_bplustree<std::int64_t, std::int64_t> tree;
+    CHECK(tree.open(PATH));
+    CHECK(tree.insert(bpt::record<std::int64_t, std::int64_t>(1, 1)));
+    CHECK(tree.close());
+  }
+  bpt::paged_bplustree<std::int32_t, std::int64_t> narrow;
+  CHECK(!narrow.open(PATH));
+  CHECK(!narrow.is_open());
+
+  std::FILE *file = std::fopen(PATH, "wb");
+  CHECK(file);
+  for (int i = 0; i < 3 * 4096; i++) {
+    std::fputc(i * 7, file);
+  }
+  CHECK(std::fclose(file) == 0);
+  bpt::paged_bplustree<std::int64_t, std::int64_t> tree;
+  CHECK(!tree.open(PATH));
+  ::unlink(PATH);
+}
+
+} // namespace
+
+int main() {
+  check_against_map<std::int64_t, std::int64_t>(20000, 1);
+  check_against_map<std::int32_t, double>(5000, 2);
+  check_foreign_files();
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,47 @@
+// search_batch against search(): present and absent keys, repeats and
+// keys beyond both ends, in batches smaller and larger than one group of
+// lookups in flight, on an empty tree, a single leaf and trees several
+// levels high.
+
+#include "bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+template <typename Tree> void check_batches(std::uint64_t pSeed) {
+  typedef typename Tree::record_type record_type;
+  std::mt19937_64 rng(pSeed);
+  for (std::int64_t size : {0, 1, 20, 100000}) {
+    Tree tree;
+    for (std::int64_t i = 0; i < size; i++) {
+      CHECK(tree.insert(record_type(2 * i, i)));
+    }
+    for (std::size_t count : {0, 1, 5, 16, 17, 1000}) {
+      std::vector<std::int64_t> keys(count);
+      for (std::int64_t &key : keys) {
+        key = std::int64_t(rng() % (2 * size + 20)) - 10;
+      }
+      std::vector<const std::int64_t *> values(count);
+      tree.search_batch(keys.data(), count, values.data());
+      for (std::size_t i = 0; i < count; i++) {
+        CHECK(values[i] == tree.search(keys[i]));
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  check_batches<bpt::bplustree<std::int64_t, std::int64_t,
+                               std::less<std::int64_t>, 3>>(1);
+  check_batches<bpt::bplustree<std::int64_t, std::int64_t>>(2);
+  std::printf("ok\n");
+  return 0;
+}
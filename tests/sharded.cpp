@@ -0,0 +1,124 @@
+// Producer threads send inserts, removes and searches to a
+// sharded_bplustree while rebalance() keeps moving records between
+// shards, once called from a thread of its own and once through
+// set_auto_rebalance(). Most keys fall into the first shard, so it stays
+// hot and its records keep moving. Thread t owns the keys k with
+// k % threads == t and checks every result against its own std::map;
+// afterwards search_batch() must find exactly the union of the maps and
+// the bounds must still be strictly increasing.
+
+#include "sharded_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef bpt::sharded_bplustree<std::int64_t, std::int64_t> tree_type;
+
+const int THREADS = 4;
+const std::int64_t KEY_RANGE = 40000;
+const int OPERATIONS = 30000;
+
+void run(bool pAutomatic) {
+  tree_type tree({KEY_RANGE / 4, KEY_RANGE / 2, 3 * KEY_RANGE / 4});
+  if (pAutomatic) {
+    tree.set_auto_rebalance(2000);
+  }
+  std::vector<std::map<std::int64_t, std::int64_t>> owned(THREADS);
+  std::atomic<bool> done(false);
+  std::atomic<int> moves(0);
+  std::thread balancer;
+  if (!pAutomatic) {
+    balancer = std::thread([&tree, &done, &moves] {
+      while (!done.load()) {
+        moves += tree.rebalance();
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  std::vector<std::thread> producers;
+  for (int t = 0; t < THREADS; t++) {
+    producers.emplace_back([&tree, &owned, t] {
+      std::map<std::int64_t, std::int64_t> &mine = owned[t];
+      std::mt19937_64 rng(t + 1);
+      std::uniform_int_distribution<std::int64_t> hot(0, KEY_RANGE / 8 - 1);
+      std::uniform_int_distribution<std::int64_t> any(0, KEY_RANGE - 1);
+      for (int i = 0; i < OPERATIONS; i++) {
+        std::int64_t key = rng() % 5 ? hot(rng) : any(rng);
+        key += (t - key % THREADS + THREADS) % THREADS;
+        switch (rng() % 3) {
+        case 0:
+          // the trees keep duplicates, so only absent keys are inserted
+          if (mine.emplace(key, i).second) {
+            CHECK(tree.insert(tree_type::record_type(key, i)).get());
+            break;
+          }
+          [[fallthrough]];
+        case 1:
+          CHECK(tree.remove(key).get() == (mine.erase(key) == 1));
+          break;
+        default: {
+          std::optional<std::int64_t> value = tree.search(key).get();
+          auto it = mine.find(key);
+          CHECK(value.has_value() == (it != mine.end()));
+          CHECK(!value || *value == it->second);
+          break;
+        }
+        }
+      }
+    });
+  }
+  for (std::thread &p : producers) {
+    p.join();
+  }
+  done.store(true);
+  if (balancer.joinable()) {
+    balancer.join();
+  }
+
+  std::vector<std::int64_t> bounds = tree.get_bounds();
+  CHECK(bounds.size() == 3);
+  for (std::size_t i = 1; i < bounds.size(); i++) {
+    CHECK(bounds[i - 1] < bounds[i]);
+  }
+  CHECK(pAutomatic || moves > 0);
+  CHECK(!pAutomatic || bounds[0] != KEY_RANGE / 4);
+
+  std::vector<std::int64_t> keys(KEY_RANGE);
+  for (std::int64_t k = 0; k < KEY_RANGE; k++) {
+    keys[k] = k;
+  }
+  std::atomic<int> mismatches(0);
+  tree.search_batch(keys.data(), keys.size(),
+                    [&owned, &mismatches](std::size_t pIndex,
+                                          const std::int64_t *pValue) {
+                      const std::map<std::int64_t, std::int64_t> &mine =
+                          owned[pIndex % THREADS];
+                      auto it = mine.find(std::int64_t(pIndex));
+                      if ((pValue != nullptr) != (it != mine.end()) ||
+                          (pValue && *pValue != it->second)) {
+                        mismatches++;
+                      }
+                    })
+      .get();
+  CHECK(mismatches == 0);
+  std::printf("%s rebalancing: ok, bounds %lld %lld %lld\n",
+              pAutomatic ? "automatic" : "explicit", (long long)bounds[0],
+              (long long)bounds[1], (long long)bounds[2]);
+}
+
+} // namespace
+
+int main() {
+  run(false);
+  run(true);
+  return 0;
+}
@@ -0,0 +1,172 @@
+// string_bplustree against a std::map: random inserts, removes, searches
+// and scans over keys that share long prefixes, differ only in their last
+// byte, hold zero and 0xFF bytes, are empty or run up to MAX_KEY_SIZE and
+// one beyond it, for two leaf sizes and fanouts. Then a bplustree over
+// string_key, whose separators are shortened, runs the same way against a
+// std::map.
+
+#include "string_bplustree.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// keys of the shapes the leaves compress differently
+class key_source {
+public:
+  key_source(std::uint64_t pSeed, int pMaxSize)
+      : mRng(pSeed), mMaxSize(pMaxSize) {}
+
+  std::string next() {
+    switch (mRng() % 6) {
+    case 0:
+      return "tenant" + std::to_string(mRng() % 8) + ":object-" +
+             std::to_string(mRng() % 3000);
+    case 1: {
+      // shared prefix, one differing byte of any value at the end
+      std::string key(12 + mRng() % 8, 'p');
+      key.push_back(char(mRng() % 4 == 0 ? 0 : mRng()));
+      return key;
+    }
+    case 2: {
+      std::string key(mRng() % 3, '\0');
+      if (mRng() % 2) {
+        key.push_back(char(0xFF));
+      }
+      return key;
+    }
+    case 3: {
+      // up to one byte past the limit
+      std::string key(mMaxSize - 1 + int(mRng() % 3), 'L');
+      key[key.size() - 1 - mRng() % 4] = char('a' + mRng() % 26);
+      return key;
+    }
+    default: {
+      std::string key(1 + mRng() % 24, ' ');
+      for (char &c : key) {
+        c = char('a' + mRng() % 4);
+      }
+      return key;
+    }
+    }
+  }
+
+  std::mt19937_64 mRng;
+
+private:
+  int mMaxSize;
+};
+
+template <typename Tree>
+void check_scan(const Tree &pTree,
+                const std::map<std::string, std::int64_t> &pExpected,
+                const std::string &pLow, const std::string &pHigh) {
+  auto it = pExpected.lower_bound(pLow);
+  bool same = true;
+  pTree.scan(pLow, pHigh, [&](std::string_view pKey, std::int64_t pValue) {
+    same = same && it != pExpected.end() && it->first == pKey &&
+           it->second == pValue;
+    ++it;
+  });
+  CHECK(same && (it == pExpected.end() || it->first >= pHigh));
+}
+
+template <int LeafBytes, int Fanout>
+void check_string_tree(int pOperations, std::uint64_t pSeed) {
+  typedef bpt::string_bplustree<std::int64_t, LeafBytes, Fanout> tree_type;
+  const int maxSize = tree_type::MAX_KEY_SIZE;
+  std::map<std::string, std::int64_t> expected;
+  key_source keys(pSeed, maxSize);
+  tree_type tree;
+  for (int i = 0; i < pOperations; i++) {
+    std::string key = keys.next();
+    switch (keys.mRng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3: {
+      bool fits = int(key.size()) <= maxSize;
+      bool added = tree.insert(typename tree_type::record_type(key, i));
+      CHECK(added == (fits && expected.emplace(key, i).second));
+      break;
+    }
+    case 4:
+    case 5:
+      CHECK(tree.remove(key) == (expected.erase(key) == 1));
+      break;
+    case 6:
+      check_scan(tree, expected, key, keys.next());
+      break;
+    default: {
+      auto it = expected.find(key);
+      const std::int64_t *value = tree.search(key);
+      CHECK(it == expected.end() ? !value : value && *value == it->second);
+      break;
+    }
+    }
+    CHECK(tree.get_size() == expected.size());
+  }
+  check_scan(tree, expected, "", std::string(maxSize + 1, char(0xFF)));
+  CHECK(tree.get_memory_usage() > 0);
+  for (auto it = expected.begin(); it != expected.end();
+       it = expected.erase(it)) {
+    CHECK(tree.remove(it->first));
+  }
+  CHECK(tree.get_size() == 0);
+  check_scan(tree, expected, "", std::string(maxSize + 1, char(0xFF)));
+}
+
+void check_string_keys(int pOperations, std::uint64_t pSeed) {
+  typedef bpt::bplustree<bpt::string_key, std::int64_t,
+                         std::less<bpt::string_key>, 8>
+      tree_type;
+  std::map<std::string, std::int64_t> expected;
+  key_source keys(pSeed, 40);
+  tree_type tree;
+  for (int i = 0; i < pOperations; i++) {
+    std::string key = keys.next();
+    auto it = expected.find(key);
+    switch (keys.mRng() % 4) {
+    case 0:
+      if (it == expected.end()) {
+        CHECK(tree.insert(tree_type::record_type(key, i)));
+        expected.emplace(key, i);
+      }
+      break;
+    case 1:
+      CHECK(tree.remove(key) == (it != expected.end()));
+      if (it != expected.end()) {
+        expected.erase(it);
+      }
+      break;
+    default: {
+      const std::int64_t *value = tree.search(key);
+      CHECK(it == expected.end() ? !value : value && *value == it->second);
+      break;
+    }
+    }
+  }
+  auto it = expected.begin();
+  for (auto r = tree.begin(); r != tree.end(); ++r, ++it) {
+    CHECK(it != expected.end() && r.get_key().get_bytes() == it->first &&
+          r.get_value() == it->second);
+  }
+  CHECK(it == expected.end());
+}
+
+} // namespace
+
+int main() {
+  check_string_tree<2048, 30>(100000, 1);
+  check_string_tree<256, 4>(100000, 2);
+  check_string_keys(100000, 3);
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+// Helpers shared by the tests in this directory. A failed CHECK prints
+// where it failed and aborts, which CTest reports as a failure; it works
+// the same from any thread.
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(pCondition)                                                     \
+  do {                                                                        \
+    if (!(pCondition)) {                                                      \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,   \
+                   #pCondition);                                              \
+      std::abort();                                                           \
+    }                                                                         \
+  } while (0)
+
+#endif
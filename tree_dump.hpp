@@ -0,0 +1,403 @@
+#ifndef TREE_DUMP_HPP
+#define TREE_DUMP_HPP
+
+#include "checksum.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+namespace bpt {
+
+template <typename Key, typename Value> class record;
+
+// Layout of the files written by bplustree::save(): a dump_header, then
+// blocks of up to DUMP_BLOCK_RECORDS records in key order, each framed as
+//
+//   u32 encoded size | u32 record count | encoded records
+//
+// Inside a block every record is its key followed by its value. Integer
+// keys are stored as the zigzag varint difference to the key before them,
+// except for the first key of a block, so that a block decodes on its own.
+// Other integers are varints, zigzagged if signed, and everything else is
+// raw bytes.
+struct dump_header {
+  std::uint64_t mMagic;
+  std::uint32_t mVersion;
+  std::uint32_t mKeySize;
+  std::uint32_t mValueSize;
+  // DUMP_INTEGER_KEYS | DUMP_INTEGER_VALUES, as encoded
+  std::uint32_t mFlags;
+  std::uint64_t mCount;
+  // CRC-32 of everything behind the header
+  std::uint32_t mChecksum;
+  std::uint32_t mBlockRecords;
+};
+
+constexpr std::uint64_t DUMP_MAGIC = 0x31706d7564747062; // "bptdump1"
+constexpr std::uint32_t DUMP_VERSION = 1;
+constexpr std::uint32_t DUMP_INTEGER_KEYS = 1;
+constexpr std::uint32_t DUMP_INTEGER_VALUES = 2;
+constexpr std::uint32_t DUMP_BLOCK_RECORDS = 4096;
+// stdio buffer of save() and load()
+constexpr std::size_t DUMP_IO_BUFFER = std::size_t(4) << 20;
+
+namespace detail {
+
+inline void put_varint(std::vector<char> &pOut, std::uint64_t pValue) {
+  while (pValue >= 0x80) {
+    pOut.push_back(char(pValue | 0x80));
+    pValue >>= 7;
+  }
+  pOut.push_back(char(pValue));
+}
+
+inline bool get_varint(const char *&pIn, const char *pEnd,
+                       std::uint64_t &pValue) {
+  pValue = 0;
+  for (int shift = 0; pIn < pEnd && shift < 64; shift += 7) {
+    unsigned char byte = *pIn++;
+    pValue |= std::uint64_t(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// How one key or value is encoded: T's raw bytes in general, varints for
+// integers (see dump_header).
+template <typename T, bool = std::is_integral<T>::value &&
+                             !std::is_same<T, bool>::value>
+struct dump_codec {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "dumps hold keys and values as raw bytes");
+  static constexpr bool INTEGER = false;
+  // bounds of the encoded size in bytes
+  static constexpr std::size_t MIN_SIZE = sizeof(T);
+  static constexpr std::size_t MAX_SIZE = sizeof(T);
+
+  static void put(std::vector<char> &pOut, const T &pField, const T *) {
+    const char *bytes = reinterpret_cast<const char *>(&pField);
+    pOut.insert(pOut.end(), bytes, bytes + sizeof(T));
+  }
+
+  static bool get(const char *&pIn, const char *pEnd, T &pField, const T *) {
+    if (std::size_t(pEnd - pIn) < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&pField, pIn, sizeof(T));
+    pIn += sizeof(T);
+    return true;
+  }
+};
+
+template <typename T> struct dump_codec<T, true> {
+  typedef typename std::make_unsigned<T>::type unsigned_type;
+  typedef typename std::make_signed<T>::type signed_type;
+  static constexpr bool INTEGER = true;
+  // a varint of up to 8 * sizeof(T) + 1 bits, for the zigzag sign bit
+  static constexpr std::size_t MIN_SIZE = 1;
+  static constexpr std::size_t MAX_SIZE = (8 * sizeof(T) + 7) / 7;
+
+  // pPrevious: the field before this one in the block, if this one is
+  // encoded as the difference to it. The difference is zigzagged, so keys
+  // ordered either way take few bytes.
+  static void put(std::vector<char> &pOut, const T &pField,
+                  const T *pPrevious) {
+    if (pPrevious) {
+      unsigned_type delta = unsigned_type(pField) - unsigned_type(*pPrevious);
+      put_varint(pOut, zigzag(signed_type(delta)));
+    } else if (std::is_signed<T>::value) {
+      put_varint(pOut, zigzag(std::int64_t(pField)));
+    } else {
+      put_varint(pOut, std::uint64_t(pField));
+    }
+  }
+
+  static bool get(const char *&pIn, const char *pEnd, T &pField,
+                  const T *pPrevious) {
+    std::uint64_t raw;
+    if (!get_varint(pIn, pEnd, raw)) {
+      return false;
+    }
+    if (pPrevious) {
+      pField = T(unsigned_type(unsigned_type(*pPrevious) +
+                               unsigned_type(unzigzag(raw))));
+    } else if (std::is_signed<T>::value) {
+      pField = T(unzigzag(raw));
+    } else {
+      pField = T(raw);
+    }
+    return true;
+  }
+
+  static std::uint64_t zigzag(std::int64_t pValue) {
+    return (std::uint64_t(pValue) << 1) ^ std::uint64_t(pValue >> 63);
+  }
+
+  static std::int64_t unzigzag(std::uint64_t pRaw) {
+    return std::int64_t(pRaw >> 1) ^ -std::int64_t(pRaw & 1);
+  }
+};
+
+template <typename Key, typename Value> std::uint32_t get_dump_flags() {
+  return (dump_codec<Key>::INTEGER ? DUMP_INTEGER_KEYS : 0) |
+         (dump_codec<Value>::INTEGER ? DUMP_INTEGER_VALUES : 0);
+}
+
+// A file with the DUMP_IO_BUFFER stdio buffer of save() and load(), closed
+// on every way out of them.
+class dump_file {
+public:
+  dump_file(const std::string &pPath, const char *pMode);
+  ~dump_file();
+  dump_file(const dump_file &) = delete;
+  dump_file &operator=(const dump_file &) = delete;
+
+  // nullptr if the file could not be opened
+  std::FILE *get() const;
+  // bytes between the current position and the end of the file
+  bool get_remaining(std::uint64_t &pBytes) const;
+  // flushes the file to disk and closes it; false if either fails
+  bool sync_and_close();
+
+private:
+  // declared first, so that it outlives the file
+  std::vector<char> mBuffer;
+  std::FILE *mFile;
+};
+
+// Encodes records given in key order into blocks and writes them out.
+template <typename Key, typename Value> class dump_writer {
+public:
+  explicit dump_writer(std::FILE *pFile);
+  void add(const Key &pKey, const Value &pValue);
+  // writes the last block; false if any write failed
+  bool finish();
+  std::uint32_t get_checksum() const;
+  std::uint64_t get_count() const;
+
+private:
+  void write_block();
+
+  std::FILE *mFile;
+  std::vector<char> mBlock;
+  std::uint32_t mBlockCount;
+  Key mPrevious;
+  std::uint32_t mChecksum;
+  std::uint64_t mCount;
+  bool mFailed;
+};
+
+// Input iterator over the records of a dump, so that the file can feed
+// bplustree::build() directly; it decodes one block at a time. A damaged
+// block ends the stream: from then on the last record repeats, which the
+// build rejects as out of order, and is_complete() turns false.
+template <typename Key, typename Value> class dump_reader {
+public:
+  typedef std::input_iterator_tag iterator_category;
+  typedef record<Key, Value> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const value_type *pointer;
+  typedef value_type reference;
+
+  dump_reader(std::FILE *pFile, std::uint64_t pCount);
+  value_type operator*() const;
+  dump_reader &operator++();
+  // every record was read intact, and the last block ended with the last
+  // record
+  bool is_complete() const;
+  // of the blocks read so far
+  std::uint32_t get_checksum() const;
+
+private:
+  void read_next();
+  bool read_block();
+
+  std::FILE *mFile;
+  std::uint64_t mRemaining;
+  std::vector<char> mBlock;
+  const char *mIn;
+  std::uint32_t mBlockLeft;
+  Key mKey;
+  Value mValue;
+  std::uint32_t mChecksum;
+  bool mValid;
+};
+
+// dump_file class ////////////////////////////////////////////////////////////
+inline dump_file::dump_file(const std::string &pPath, const char *pMode)
+    : mBuffer(DUMP_IO_BUFFER), mFile(std::fopen(pPath.c_str(), pMode)) {
+  if (mFile) {
+    std::setvbuf(mFile, mBuffer.data(), _IOFBF, mBuffer.size());
+  }
+}
+
+inline dump_file::~dump_file() {
+  if (mFile) {
+    std::fclose(mFile);
+  }
+}
+
+inline std::FILE *dump_file::get() const { return mFile; }
+
+inline bool dump_file::get_remaining(std::uint64_t &pBytes) const {
+  long position = std::ftell(mFile);
+  if (position < 0 || std::fseek(mFile, 0, SEEK_END) != 0) {
+    return false;
+  }
+  long end = std::ftell(mFile);
+  if (end < position || std::fseek(mFile, position, SEEK_SET) != 0) {
+    return false;
+  }
+  pBytes = std::uint64_t(end - position);
+  return true;
+}
+
+inline bool dump_file::sync_and_close() {
+  bool ok = std::fflush(mFile) == 0 && fsync(fileno(mFile)) == 0;
+  ok = std::fclose(mFile) == 0 && ok;
+  mFile = nullptr;
+  return ok;
+}
+
+// dump_writer class //////////////////////////////////////////////////////////
+template <typename Key, typename Value>
+dump_writer<Key, Value>::dump_writer(std::FILE *pFile)
+    : mFile(pFile), mBlockCount(0), mPrevious(), mChecksum(0), mCount(0),
+      mFailed(false) {
+  mBlock.reserve(DUMP_BLOCK_RECORDS * (sizeof(Key) + sizeof(Value)));
+}
+
+template <typename Key, typename Value>
+void dump_writer<Key, Value>::add(const Key &pKey, const Value &pValue) {
+  dump_codec<Key>::put(mBlock, pKey, mBlockCount > 0 ? &mPrevious : nullptr);
+  dump_codec<Value>::put(mBlock, pValue, nullptr);
+  mPrevious = pKey;
+  mCount++;
+  if (++mBlockCount == DUMP_BLOCK_RECORDS) {
+    write_block();
+  }
+}
+
+template <typename Key, typename Value> bool dump_writer<Key, Value>::finish() {
+  if (mBlockCount > 0) {
+    write_block();
+  }
+  return !mFailed;
+}
+
+template <typename Key, typename Value>
+std::uint32_t dump_writer<Key, Value>::get_checksum() const {
+  return mChecksum;
+}
+
+template <typename Key, typename Value>
+std::uint64_t dump_writer<Key, Value>::get_count() const {
+  return mCount;
+}
+
+template <typename Key, typename Value>
+void dump_writer<Key, Value>::write_block() {
+  std::uint32_t frame[2] = {std::uint32_t(mBlock.size()), mBlockCount};
+  mChecksum = crc32(frame, sizeof(frame), mChecksum);
+  mChecksum = crc32(mBlock.data(), mBlock.size(), mChecksum);
+  if (std::fwrite(frame, sizeof(frame), 1, mFile) != 1 ||
+      std::fwrite(mBlock.data(), 1, mBlock.size(), mFile) != mBlock.size()) {
+    mFailed = true;
+  }
+  mBlock.clear();
+  mBlockCount = 0;
+}
+
+// dump_reader class //////////////////////////////////////////////////////////
+template <typename Key, typename Value>
+dump_reader<Key, Value>::dump_reader(std::FILE *pFile, std::uint64_t pCount)
+    : mFile(pFile), mRemaining(pCount), mIn(nullptr), mBlockLeft(0), mKey(),
+      mValue(), mChecksum(0), mValid(true) {
+  read_next();
+}
+
+template <typename Key, typename Value>
+typename dump_reader<Key, Value>::value_type
+dump_reader<Key, Value>::operator*() const {
+  return value_type(mKey, mValue);
+}
+
+template <typename Key, typename Value>
+dump_reader<Key, Value> &dump_reader<Key, Value>::operator++() {
+  read_next();
+  return *this;
+}
+
+template <typename Key, typename Value>
+bool dump_reader<Key, Value>::is_complete() const {
+  return mValid && mRemaining == 0 && mBlockLeft == 0;
+}
+
+template <typename Key, typename Value>
+std::uint32_t dump_reader<Key, Value>::get_checksum() const {
+  return mChecksum;
+}
+
+template <typename Key, typename Value>
+void dump_reader<Key, Value>::read_next() {
+  if (mRemaining == 0 || !mValid) {
+    return;
+  }
+  mRemaining--;
+  bool first = false;
+  if (mBlockLeft == 0) {
+    if (!read_block()) {
+      mValid = false;
+      return;
+    }
+    first = true;
+  }
+  const char *end = mBlock.data() + mBlock.size();
+  Key key;
+  if (!dump_codec<Key>::get(mIn, end, key, first ? nullptr : &mKey) ||
+      !dump_codec<Value>::get(mIn, end, mValue, nullptr)) {
+    mValid = false;
+    return;
+  }
+  mKey = key;
+  if (--mBlockLeft == 0 && mIn != end) {
+    mValid = false;
+  }
+}
+
+template <typename Key, typename Value>
+bool dump_reader<Key, Value>::read_block() {
+  std::uint32_t frame[2];
+  // bounded before anything is allocated for the block
+  if (std::fread(frame, sizeof(frame), 1, mFile) != 1 || frame[1] == 0 ||
+      frame[1] > DUMP_BLOCK_RECORDS ||
+      frame[0] > frame[1] * (dump_codec<Key>::MAX_SIZE +
+                             dump_codec<Value>::MAX_SIZE)) {
+    return false;
+  }
+  mBlock.resize(frame[0]);
+  if (std::fread(mBlock.data(), 1, frame[0], mFile) != frame[0]) {
+    return false;
+  }
+  mChecksum = crc32(frame, sizeof(frame), mChecksum);
+  mChecksum = crc32(mBlock.data(), mBlock.size(), mChecksum);
+  mIn = mBlock.data();
+  mBlockLeft = frame[1];
+  return true;
+}
+
+} // namespace detail
+
+} // namespace bpt
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef TREE_STATS_HPP
+#define TREE_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bpt {
+
+// Counts of the structural changes a tree has gone through. They are only
+// kept if BPLUSTREE_STATS is defined; otherwise add() compiles to nothing
+// and every count reads zero.
+class tree_events {
+public:
+  enum event {
+    LEAF_SPLIT,
+    INNER_SPLIT,
+    LEAF_MERGE,
+    INNER_MERGE,
+    // entries moved between siblings that did not fit into one node
+    REDISTRIBUTION,
+    // a node below MIN_THRESHOLD that could neither be merged nor evened
+    // out and was left as it is
+    FAILED_REBALANCE,
+    ROOT_GROWTH,
+    ROOT_SHRINK,
+    EVENT_COUNT
+  };
+
+  static constexpr bool ENABLED =
+#ifdef BPLUSTREE_STATS
+      true;
+#else
+      false;
+#endif
+
+  tree_events() : mCounts() {}
+
+  void add(event pEvent) {
+#ifdef BPLUSTREE_STATS
+    mCounts[pEvent]++;
+#else
+    (void)pEvent;
+#endif
+  }
+
+  // adds the counts of pOther, e.g. those a worker thread kept for itself
+  void absorb(const tree_events &pOther) {
+    for (int i = 0; i < EVENT_COUNT; i++) {
+      mCounts[i] += pOther.mCounts[i];
+    }
+  }
+
+  std::uint64_t get(event pEvent) const { return mCounts[pEvent]; }
+
+private:
+  std::uint64_t mCounts[EVENT_COUNT];
+};
+
+// Snapshot of the shape of a tree, taken by a walk over every node.
+struct tree_stats {
+  // inner levels above the leaves
+  int mHeight;
+  std::size_t mRecords;
+  // nodes on each level, the root's first
+  std::vector<std::size_t> mLevelNodes;
+  // mLeafOccupancy[i] leaves hold i records and mInnerOccupancy[i] inner
+  // nodes hold i keys, for i up to the node capacity
+  std::vector<std::size_t> mLeafOccupancy;
+  std::vector<std::size_t> mInnerOccupancy;
+  // records per leaf over the leaf fanout, from 0 to 1
+  double mLeafFill;
+  // bytes of the nodes in use
+  std::size_t mNodeBytes;
+  // bytes of the slabs the node pools hold, free slots included, and of
+  // their slab tables
+  std::size_t mReservedBytes;
+  tree_events mEvents;
+};
+
+} // namespace bpt
+
+#endif
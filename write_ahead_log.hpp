@@ -0,0 +1,332 @@
+#ifndef WRITE_AHEAD_LOG_HPP
+#define WRITE_AHEAD_LOG_HPP
+
+#include "checksum.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bpt {
+
+// fsyncs the directory holding pPath, which makes a rename into it durable
+inline bool sync_directory(const std::string &pPath) {
+  std::size_t slash = pPath.find_last_of('/');
+  std::string directory =
+      slash == std::string::npos ? "." : pPath.substr(0, slash + 1);
+  int fd = ::open(directory.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
+// Append-only log of opaque records, each numbered by a log sequence
+// number (LSN) and framed as
+//
+//   u32 payload size | u32 CRC-32 of LSN and payload | u64 LSN | payload
+//
+// append() only buffers a record. commit() returns once the record is on
+// disk, and the writers that commit at about the same time share one
+// fdatasync: the first of them becomes the leader, waits for the commit
+// window so that others can add their records, then writes the whole
+// buffer and syncs it while the rest wait for the result. A record that
+// fails its checksum ends the log, so a write torn by a crash is dropped
+// on the next open. All calls are thread-safe.
+class write_ahead_log {
+public:
+  write_ahead_log();
+  write_ahead_log(const write_ahead_log &) = delete;
+  write_ahead_log &operator=(const write_ahead_log &) = delete;
+  ~write_ahead_log();
+
+  // Opens or creates the log in pPath and calls pVisit(lsn, payload, size)
+  // for every intact record numbered above pBaseLsn, in log order. Anything
+  // behind the last intact record is cut off, and new records are numbered
+  // after both pBaseLsn and the last record read.
+  template <typename Visitor>
+  bool open(const std::string &pPath, std::uint64_t pBaseLsn,
+            Visitor pVisit);
+  // commits whatever is buffered, then closes the file
+  void close();
+  bool is_open() const;
+  // buffers a record and returns its LSN
+  std::uint64_t append(const void *pData, std::size_t pSize);
+  // Waits until the record pLsn and all before it are on disk. False if
+  // the log could not be written.
+  bool commit(std::uint64_t pLsn);
+  // Drops the first pSize bytes of the log, which hold every record up to
+  // pLsn and which a checkpoint has made redundant; get_size() returned
+  // pSize when pLsn was the last LSN. Records behind them are kept: they
+  // are moved to the front of a fresh file that replaces the log by
+  // rename, so a crash leaves either log whole.
+  bool truncate(std::uint64_t pLsn, std::size_t pSize);
+  // how long a commit leader waits for other writers before it syncs
+  void set_commit_window(std::chrono::microseconds pWindow);
+
+  std::uint64_t get_last_lsn() const;
+  // bytes in the log, buffered records included
+  std::size_t get_size() const;
+
+private:
+  struct record_header {
+    std::uint32_t mSize;
+    std::uint32_t mChecksum;
+    std::uint64_t mLsn;
+  };
+
+  static std::uint32_t get_checksum(std::uint64_t pLsn, const void *pData,
+                                    std::size_t pSize);
+  bool write_all(const std::vector<char> &pBytes);
+  // Renames a file holding only pTail over the log and appends to it from
+  // then on; mMutex is held. The caller syncs the directory.
+  bool rewrite(const std::vector<char> &pTail);
+
+  std::string mPath;
+  int mFd;
+  mutable std::mutex mMutex;
+  std::condition_variable mSynced;
+  std::vector<char> mBuffer;
+  std::uint64_t mLastLsn;
+  std::uint64_t mDurableLsn;
+  std::size_t mSize;
+  // a leader is writing the buffer it took
+  bool mSyncing;
+  bool mFailed;
+  std::chrono::microseconds mWindow;
+};
+
+inline write_ahead_log::write_ahead_log()
+    : mFd(-1), mLastLsn(0), mDurableLsn(0), mSize(0), mSyncing(false),
+      mFailed(false), mWindow(0) {}
+
+inline write_ahead_log::~write_ahead_log() { close(); }
+
+template <typename Visitor>
+bool write_ahead_log::open(const std::string &pPath, std::uint64_t pBaseLsn,
+                           Visitor pVisit) {
+  close();
+  int fd = ::open(pPath.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  std::vector<char> bytes(st.st_size);
+  std::size_t read = 0;
+  while (read < bytes.size()) {
+    ssize_t n = pread(fd, bytes.data() + read, bytes.size() - read, read);
+    if (n <= 0) {
+      break;
+    }
+    read += n;
+  }
+
+  std::uint64_t lastLsn = pBaseLsn;
+  std::size_t offset = 0;
+  while (offset + sizeof(record_header) <= read) {
+    record_header header;
+    std::memcpy(&header, bytes.data() + offset, sizeof(record_header));
+    const char *payload = bytes.data() + offset + sizeof(record_header);
+    if (header.mSize > read - offset - sizeof(record_header) ||
+        header.mChecksum != get_checksum(header.mLsn, payload, header.mSize)) {
+      break;
+    }
+    if (header.mLsn > pBaseLsn) {
+      pVisit(header.mLsn, payload, std::size_t(header.mSize));
+    }
+    lastLsn = std::max(lastLsn, header.mLsn);
+    offset += sizeof(record_header) + header.mSize;
+  }
+
+  if ((offset < std::size_t(st.st_size) && ftruncate(fd, offset) != 0) ||
+      lseek(fd, offset, SEEK_SET) < 0) {
+    ::close(fd);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  mPath = pPath;
+  mFd = fd;
+  mLastLsn = mDurableLsn = lastLsn;
+  mSize = offset;
+  mFailed = false;
+  return true;
+}
+
+inline void write_ahead_log::close() {
+  if (mFd < 0) {
+    return;
+  }
+  commit(get_last_lsn());
+  ::close(mFd);
+  mFd = -1;
+  mBuffer.clear();
+}
+
+inline bool write_ahead_log::is_open() const { return mFd >= 0; }
+
+inline std::uint64_t write_ahead_log::append(const void *pData,
+                                             std::size_t pSize) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  record_header header;
+  header.mSize = std::uint32_t(pSize);
+  header.mLsn = ++mLastLsn;
+  header.mChecksum = get_checksum(header.mLsn, pData, pSize);
+  const char *headerBytes = reinterpret_cast<const char *>(&header);
+  const char *bytes = static_cast<const char *>(pData);
+  mBuffer.insert(mBuffer.end(), headerBytes,
+                 headerBytes + sizeof(record_header));
+  mBuffer.insert(mBuffer.end(), bytes, bytes + pSize);
+  mSize += sizeof(record_header) + pSize;
+  return header.mLsn;
+}
+
+inline bool write_ahead_log::commit(std::uint64_t pLsn) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (mDurableLsn < pLsn && !mFailed) {
+    if (mSyncing) {
+      mSynced.wait(lock);
+      continue;
+    }
+    mSyncing = true;
+    if (mWindow.count() > 0) {
+      lock.unlock();
+      std::this_thread::sleep_for(mWindow);
+      lock.lock();
+    }
+    std::vector<char> batch;
+    batch.swap(mBuffer);
+    std::uint64_t batchLsn = mLastLsn;
+    lock.unlock();
+    bool written = write_all(batch) && fdatasync(mFd) == 0;
+    lock.lock();
+    mSyncing = false;
+    if (written) {
+      mDurableLsn = batchLsn;
+    } else {
+      mFailed = true;
+    }
+    mSynced.notify_all();
+  }
+  return mDurableLsn >= pLsn;
+}
+
+// The dropped bytes are the front of the file, then possibly the front of
+// the buffer. Records that went to the file since pLsn are read back and
+// rewritten; usually there are none and the file is simply emptied.
+inline bool write_ahead_log::truncate(std::uint64_t pLsn, std::size_t pSize) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  // a leader still writes to the old end of the file
+  mSynced.wait(lock, [this] { return !mSyncing; });
+  std::size_t fileSize = mSize - mBuffer.size();
+  bool ok;
+  if (pSize >= fileSize) {
+    ok = ftruncate(mFd, 0) == 0 && lseek(mFd, 0, SEEK_SET) == 0;
+    if (ok) {
+      mBuffer.erase(mBuffer.begin(), mBuffer.begin() + (pSize - fileSize));
+    }
+  } else {
+    std::vector<char> tail(fileSize - pSize);
+    std::size_t read = 0;
+    while (read < tail.size()) {
+      ssize_t n = pread(mFd, tail.data() + read, tail.size() - read,
+                        pSize + read);
+      if (n <= 0) {
+        break;
+      }
+      read += n;
+    }
+    ok = read == tail.size() && rewrite(tail);
+  }
+  if (ok) {
+    mSize -= pSize;
+    // the checkpoint holds every record up to pLsn
+    mDurableLsn = std::max(mDurableLsn, pLsn);
+    mFailed = false;
+    if (pSize < fileSize && !sync_directory(mPath)) {
+      // a crash could bring back the old file, without the records
+      // committed from now on
+      mFailed = true;
+      ok = false;
+    }
+  }
+  mSynced.notify_all();
+  return ok;
+}
+
+inline void
+write_ahead_log::set_commit_window(std::chrono::microseconds pWindow) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mWindow = pWindow;
+}
+
+inline std::uint64_t write_ahead_log::get_last_lsn() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mLastLsn;
+}
+
+inline std::size_t write_ahead_log::get_size() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mSize;
+}
+
+inline std::uint32_t write_ahead_log::get_checksum(std::uint64_t pLsn,
+                                                   const void *pData,
+                                                   std::size_t pSize) {
+  return crc32(pData, pSize, crc32(&pLsn, sizeof(pLsn)));
+}
+
+inline bool write_ahead_log::rewrite(const std::vector<char> &pTail) {
+  std::string temporary = mPath + ".tmp";
+  int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  std::size_t written = 0;
+  while (written < pTail.size()) {
+    ssize_t n = write(fd, pTail.data() + written, pTail.size() - written);
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  if (written != pTail.size() || fdatasync(fd) != 0 ||
+      std::rename(temporary.c_str(), mPath.c_str()) != 0) {
+    ::close(fd);
+    return false;
+  }
+  ::close(mFd);
+  mFd = fd;
+  return true;
+}
+
+inline bool write_ahead_log::write_all(const std::vector<char> &pBytes) {
+  std::size_t written = 0;
+  while (written < pBytes.size()) {
+    ssize_t n = write(mFd, pBytes.data() + written, pBytes.size() - written);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+} // namespace bpt
+
+#endif